@@ -5,6 +5,7 @@
 #include <string.h>
 #include "devices/input.h"
 #include "devices/shutdown.h"
+#include "threads/defer.h"
 #include "threads/interrupt.h"
 #include "threads/io.h"
 
@@ -24,12 +25,23 @@ static bool caps_lock;
 /* Number of keys pressed. */
 static int64_t key_cnt;
 
+/* Scancodes read by keyboard_interrupt() but not yet interpreted
+   by interpret_scancodes(), which runs as deferred work.  HEAD
+   and TAIL only increase; the buffer holds HEAD - TAIL codes. */
+#define SCANCODE_BUF_SIZE 64
+static unsigned scancodes[SCANCODE_BUF_SIZE];
+static unsigned scancode_head, scancode_tail;
+static struct deferred_work kbd_work;
+
 static intr_handler_func keyboard_interrupt;
+static void interpret_scancodes (void *aux);
+static void interpret_scancode (unsigned code);
 
 /* Initializes the keyboard. */
 void
 kbd_init (void) 
 {
+  deferred_work_init (&kbd_work, interpret_scancodes, NULL);
   intr_register_ext (0x21, keyboard_interrupt, "8042 Keyboard");
 }
 
@@ -92,28 +104,64 @@ static const struct keymap shifted_keymap[] =
 
 static bool map_key (const struct keymap[], unsigned scancode, uint8_t *);
 
+/* Keyboard interrupt handler.  Reads the scancode and leaves
+   interpreting it to deferred work. */
 static void
 keyboard_interrupt (struct intr_frame *args UNUSED) 
+{
+  unsigned code;
+
+  /* Read scancode, including second byte if prefix code. */
+  code = inb (DATA_REG);
+  if (code == 0xe0)
+    code = (code << 8) | inb (DATA_REG);
+
+  /* Drop the key if the buffer is full, as we would if the input
+     buffer were full. */
+  if (scancode_head - scancode_tail < SCANCODE_BUF_SIZE)
+    {
+      scancodes[scancode_head++ % SCANCODE_BUF_SIZE] = code;
+      defer_schedule (&kbd_work);
+    }
+}
+
+/* Interprets every buffered scancode. */
+static void
+interpret_scancodes (void *aux UNUSED) 
+{
+  for (;;)
+    {
+      enum intr_level old_level = intr_disable ();
+      bool empty = scancode_head == scancode_tail;
+      unsigned code = 0;
+
+      if (!empty)
+        code = scancodes[scancode_tail++ % SCANCODE_BUF_SIZE];
+      intr_set_level (old_level);
+
+      if (empty)
+        break;
+      interpret_scancode (code);
+    }
+}
+
+/* Updates the shift state for scancode CODE, or, if it is an
+   ordinary key press, appends the corresponding character to
+   the input buffer. */
+static void
+interpret_scancode (unsigned code) 
 {
   /* Status of shift keys. */
   bool shift = left_shift || right_shift;
   bool alt = left_alt || right_alt;
   bool ctrl = left_ctrl || right_ctrl;
 
-  /* Keyboard scancode. */
-  unsigned code;
-
   /* False if key pressed, true if key released. */
   bool release;
 
   /* Character that corresponds to `code'. */
   uint8_t c;
 
-  /* Read scancode, including second byte if prefix code. */
-  code = inb (DATA_REG);
-  if (code == 0xe0)
-    code = (code << 8) | inb (DATA_REG);
-
   /* Bit 0x80 distinguishes key press from key release
      (even if there's a prefix). */
   release = (code & 0x80) != 0;
@@ -133,6 +181,8 @@ keyboard_interrupt (struct intr_frame *args UNUSED)
       /* Ordinary character. */
       if (!release) 
         {
+          enum intr_level old_level;
+
           /* Reboot if Ctrl+Alt+Del pressed. */
           if (c == 0177 && ctrl && alt)
             shutdown_reboot ();
@@ -154,11 +204,13 @@ keyboard_interrupt (struct intr_frame *args UNUSED)
             c += 0x80;
 
           /* Append to keyboard buffer. */
+          old_level = intr_disable ();
           if (!input_full ())
             {
               key_cnt++;
               input_putc (c);
             }
+          intr_set_level (old_level);
         }
     }
   else
@@ -0,0 +1,162 @@
+#include "devices/lapic.h"
+#include <debug.h>
+#include "devices/timer.h"
+#include "threads/init.h"
+#include "threads/interrupt.h"
+#include "threads/loader.h"
+#include "threads/palloc.h"
+#include "threads/pte.h"
+#include "threads/vaddr.h"
+
+/* Local APIC.  Each CPU has its own, at the same physical
+   address, through which it accepts interrupts and sends
+   inter-processor interrupts (IPIs) to other CPUs.  External
+   interrupts keep going through the 8259A PICs to the boot CPU,
+   so the local APIC is only used for IPIs.  Refer to [IA32-v3a]
+   chapter 8 "Advanced Programmable Interrupt Controller (APIC)"
+   for details. */
+
+/* Local APIC registers, as byte offsets from its base. */
+#define LAPIC_ID      0x020     /* Local APIC ID. */
+#define LAPIC_TPR     0x080     /* Task priority. */
+#define LAPIC_EOI     0x0b0     /* End of interrupt. */
+#define LAPIC_SVR     0x0f0     /* Spurious interrupt vector. */
+#define LAPIC_ICR_LO  0x300     /* Interrupt command, bits 0...31. */
+#define LAPIC_ICR_HI  0x310     /* Interrupt command, bits 32...63. */
+
+/* Spurious interrupt vector register bits. */
+#define SVR_ENABLE    0x00000100        /* APIC software enable. */
+
+/* Interrupt command register bits. */
+#define ICR_FIXED     0x00000000        /* Deliver vector as is. */
+#define ICR_INIT      0x00000500        /* INIT. */
+#define ICR_STARTUP   0x00000600        /* Start-up IPI (SIPI). */
+#define ICR_PENDING   0x00001000        /* Delivery still pending. */
+#define ICR_ASSERT    0x00004000        /* Assert, not deassert. */
+#define ICR_LEVEL     0x00008000        /* Level-triggered. */
+
+/* Local APIC registers, mapped at their physical address by
+   lapic_map(), or a null pointer if not mapped. */
+static volatile uint32_t *lapic;
+
+static uint32_t lapic_read (int reg);
+static void lapic_write (int reg, uint32_t value);
+static void lapic_send (unsigned apic_id, uint32_t command);
+
+/* Maps the local APIC registers, at physical address PADDR,
+   into the kernel page directory at the same virtual address,
+   with caching disabled.  The local APIC lies far above the RAM
+   that the kernel maps at PHYS_BASE, so the two cannot clash.
+   Must be called before any page directory other than
+   init_page_dir is created, since those copy its kernel
+   mappings. */
+void
+lapic_map (uintptr_t paddr)
+{
+  void *vaddr = (void *) paddr;
+  uint32_t *pde, *pt;
+
+  ASSERT (pg_ofs (vaddr) == 0);
+  ASSERT (paddr >= LOADER_PHYS_BASE + init_ram_pages * PGSIZE);
+
+  pde = &init_page_dir[pd_no (vaddr)];
+  if (*pde == 0)
+    *pde = pde_create (palloc_get_page (PAL_ASSERT | PAL_ZERO));
+  pt = pde_get_pt (*pde);
+  pt[pt_no (vaddr)] = paddr | PTE_P | PTE_W | PTE_PCD | PTE_PWT;
+  lapic = vaddr;
+}
+
+/* Enables the local APIC of the CPU we are running on, so that
+   it accepts IPIs of any priority. */
+void
+lapic_init (void)
+{
+  ASSERT (lapic != NULL);
+
+  lapic_write (LAPIC_SVR, SVR_ENABLE | LAPIC_SPURIOUS);
+  lapic_write (LAPIC_TPR, 0);
+}
+
+/* Returns the local APIC ID of the CPU we are running on. */
+unsigned
+lapic_id (void)
+{
+  return lapic_read (LAPIC_ID) >> 24;
+}
+
+/* Signals the end of an IPI to the local APIC, which holds off
+   further IPIs of the same or lower priority until then. */
+void
+lapic_eoi (void)
+{
+  lapic_write (LAPIC_EOI, 0);
+}
+
+/* Sends IPI VEC_NO to the CPU whose local APIC ID is APIC_ID. */
+void
+lapic_send_ipi (unsigned apic_id, uint8_t vec_no)
+{
+  ASSERT (vec_no >= IPI_FIRST && vec_no <= IPI_LAST);
+
+  lapic_send (apic_id, ICR_FIXED | ICR_ASSERT | vec_no);
+}
+
+/* Starts the application processor whose local APIC ID is
+   APIC_ID running in real mode at physical address START, which
+   must be page-aligned and below 1 MB, with the INIT, SIPI, SIPI
+   sequence of [IA32-v3a] 7.5.4 "MP Initialization Example".  A
+   processor that is already running ignores the second SIPI.
+   Sleeps, so interrupts must be on, and the timer must be
+   calibrated. */
+void
+lapic_start_ap (unsigned apic_id, uintptr_t start)
+{
+  int i;
+
+  ASSERT (start % PGSIZE == 0 && start < 0x100000);
+
+  lapic_send (apic_id, ICR_INIT | ICR_LEVEL | ICR_ASSERT);
+  timer_udelay (200);
+  lapic_send (apic_id, ICR_INIT | ICR_LEVEL);
+  timer_msleep (10);
+
+  for (i = 0; i < 2; i++)
+    {
+      lapic_send (apic_id, ICR_STARTUP | (start >> 12));
+      timer_udelay (200);
+    }
+}
+
+/* Returns the value of local APIC register REG. */
+static uint32_t
+lapic_read (int reg)
+{
+  ASSERT (lapic != NULL);
+  return lapic[reg / sizeof *lapic];
+}
+
+/* Sets local APIC register REG to VALUE. */
+static void
+lapic_write (int reg, uint32_t value)
+{
+  ASSERT (lapic != NULL);
+  lapic[reg / sizeof *lapic] = value;
+}
+
+/* Sends interrupt COMMAND to the CPU whose local APIC ID is
+   APIC_ID, once the previous command has been delivered.
+   Interrupts are turned off meanwhile, so that an interrupt
+   handler's IPI cannot come between writing the destination and
+   the command. */
+static void
+lapic_send (unsigned apic_id, uint32_t command)
+{
+  enum intr_level old_level = intr_disable ();
+
+  while (lapic_read (LAPIC_ICR_LO) & ICR_PENDING)
+    asm volatile ("pause");
+  lapic_write (LAPIC_ICR_HI, apic_id << 24);
+  lapic_write (LAPIC_ICR_LO, command);
+  intr_set_level (old_level);
+}
@@ -0,0 +1,22 @@
+#ifndef DEVICES_LAPIC_H
+#define DEVICES_LAPIC_H
+
+#include <stdint.h>
+
+/* Interrupt vectors used with the local APIC.  Vectors
+   IPI_FIRST through IPI_LAST are inter-processor interrupts,
+   which are handled like external interrupts. */
+#define IPI_FIRST 0xf0
+#define IPI_TICK 0xf0           /* Timer tick, from the boot CPU. */
+#define IPI_RESCHEDULE 0xf1     /* A thread was readied for this CPU. */
+#define IPI_LAST 0xfe
+#define LAPIC_SPURIOUS 0xff     /* Spurious interrupt. */
+
+void lapic_map (uintptr_t paddr);
+void lapic_init (void);
+unsigned lapic_id (void);
+void lapic_eoi (void);
+void lapic_send_ipi (unsigned apic_id, uint8_t vec_no);
+void lapic_start_ap (unsigned apic_id, uintptr_t start);
+
+#endif /* devices/lapic.h */
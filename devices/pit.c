@@ -11,9 +11,6 @@
 #define PIT_PORT_CONTROL          0x43                /* Control port. */
 #define PIT_PORT_COUNTER(CHANNEL) (0x40 + (CHANNEL))  /* Counter port. */
 
-/* PIT cycles per second. */
-#define PIT_HZ 1193180
-
 /* Configure the given CHANNEL in the PIT.  In a PC, the PIT's
    three output channels are hooked up like this:
 
@@ -81,3 +78,65 @@ pit_configure_channel (int channel, int mode, int frequency)
   outb (PIT_PORT_COUNTER (channel), count >> 8);
   intr_set_level (old_level);
 }
+
+/* Starts the given CHANNEL in the PIT counting down COUNT PIT
+   cycles in mode 0 ("interrupt on terminal count").  The
+   channel's output rises once, when the count reaches 0, and
+   then stays high, so channel 0 delivers a single interrupt.
+   COUNT must be between 1 and 65536. */
+void
+pit_start_oneshot (int channel, unsigned count)
+{
+  enum intr_level old_level;
+
+  ASSERT (channel == 0 || channel == 2);
+  ASSERT (count >= 1 && count <= 65536);
+
+  /* A count of 65536 is loaded as 0. */
+  old_level = intr_disable ();
+  outb (PIT_PORT_CONTROL, (channel << 6) | 0x30 | (0 << 1));
+  outb (PIT_PORT_COUNTER (channel), count);
+  outb (PIT_PORT_COUNTER (channel), count >> 8);
+  intr_set_level (old_level);
+}
+
+/* Returns true if the given CHANNEL's output is high, using a
+   read-back command to latch the channel's status.  In mode 0,
+   this tells whether a one-shot count has reached 0. */
+bool
+pit_read_output (int channel)
+{
+  enum intr_level old_level;
+  uint8_t status;
+
+  ASSERT (channel == 0 || channel == 2);
+
+  /* Read-back command: latch status only, for CHANNEL. */
+  old_level = intr_disable ();
+  outb (PIT_PORT_CONTROL, 0xe0 | (2 << channel));
+  status = inb (PIT_PORT_COUNTER (channel));
+  intr_set_level (old_level);
+
+  return (status & 0x80) != 0;
+}
+
+/* Returns the current value of the given CHANNEL's counter, in
+   PIT cycles, using a counter latch command so that the two
+   bytes read belong to the same value.  A counter loaded with 0
+   reads back as 0 until it wraps to 65535. */
+unsigned
+pit_read_count (int channel)
+{
+  enum intr_level old_level;
+  uint8_t lo, hi;
+
+  ASSERT (channel == 0 || channel == 2);
+
+  old_level = intr_disable ();
+  outb (PIT_PORT_CONTROL, channel << 6);
+  lo = inb (PIT_PORT_COUNTER (channel));
+  hi = inb (PIT_PORT_COUNTER (channel));
+  intr_set_level (old_level);
+
+  return lo | (hi << 8);
+}
@@ -4,7 +4,11 @@
 #include "devices/kbd.h"
 #include "devices/serial.h"
 #include "devices/timer.h"
+#include "threads/interrupt.h"
 #include "threads/io.h"
+#include "threads/palloc.h"
+#include "threads/slab.h"
+#include "threads/synch.h"
 #include "threads/thread.h"
 #ifdef USERPROG
 #include "userprog/exception.h"
@@ -119,7 +123,12 @@ static void
 print_stats (void)
 {
   timer_print_stats ();
+  intr_print_stats ();
   thread_print_stats ();
+  thread_print_cpu_stats ();
+  lock_print_stats ();
+  palloc_print_stats ();
+  kmem_cache_print_stats ();
 #ifdef FILESYS
   block_print_stats ();
 #endif
@@ -1,12 +1,17 @@
 #include "devices/timer.h"
 #include <debug.h>
 #include <inttypes.h>
+#include <list.h>
 #include <round.h>
 #include <stdio.h>
+#include "devices/lapic.h"
 #include "devices/pit.h"
+#include "threads/cpu.h"
+#include "threads/defer.h"
 #include "threads/interrupt.h"
 #include "threads/synch.h"
 #include "threads/thread.h"
+#include "threads/trace.h"
   
 /* See [8254] for hardware details of the 8254 timer chip. */
 
@@ -20,13 +25,79 @@
 /* Number of timer ticks since OS booted. */
 static int64_t ticks;
 
-/* Number of loops per timer tick.
-   Initialized by timer_calibrate(). */
-static unsigned loops_per_tick;
+/* Time-stamp counter clock source.  TSC_HZ is the number of TSC
+   cycles per second and TSC_BASE the TSC value at tick
+   TICKS_BASE, both measured against the PIT by
+   timer_calibrate().  TSC_HZ is 0 until then. */
+#define NS_PER_SEC 1000000000
+#define NS_PER_TICK (NS_PER_SEC / TIMER_FREQ)
+#define CALIBRATE_TICKS 5
+static uint64_t tsc_hz;
+static uint64_t tsc_base;
+static int64_t ticks_base;
+
+/* Threads blocked in timer_sleep(), hashed by wake-up tick into
+   a timing wheel.  A thread that wakes at tick T lives in bucket
+   T % SLEEP_WHEEL_SIZE, and each bucket is kept sorted by
+   wake-up tick, so the timer interrupt only has to look at the
+   front of the current tick's bucket and touches no thread that
+   is not yet due.
+
+   The timer interrupt only notices that some thread is due.  The
+   wake-ups themselves happen in wake_sleepers(), as deferred
+   work, which catches up on every tick up to the current one. */
+#define SLEEP_WHEEL_SIZE 64
+#define WAKE_BATCH 8            /* Threads woken per interrupts-off span. */
+static struct list sleep_wheel[SLEEP_WHEEL_SIZE];
+static struct deferred_work wake_work;
+static int64_t woken_ticks;     /* Last tick whose sleepers were woken. */
+
+/* Returns the sleep wheel bucket for threads waking at TICK. */
+static inline struct list *
+sleep_bucket (int64_t tick)
+{
+  return &sleep_wheel[(uint64_t) tick % SLEEP_WHEEL_SIZE];
+}
+
+/* Number of PIT cycles in one timer tick, rounded the same way
+   as pit_configure_channel() rounds it. */
+#define TICK_CYCLES ((PIT_HZ + TIMER_FREQ / 2) / TIMER_FREQ)
+
+/* Longest span, in ticks, that one PIT one-shot can cover. */
+#define TICKLESS_MAX_TICKS (65536 / TICK_CYCLES)
+
+/* If false (default), the PIT interrupts at TIMER_FREQ at all
+   times.  If true, the idle thread stops the periodic tick until
+   the next wake-up is due.  Controlled by kernel command-line
+   option "-tickless". */
+bool timer_tickless;
+
+/* Dynamic tick state.  While TICKLESS is true, the PIT is
+   counting down a single ONESHOT_CYCLES-cycle interval that ends
+   on the tick boundary ONESHOT_TICKS ticks after the last
+   accounted tick.  The first of those boundaries is
+   FIRST_BOUNDARY cycles into the interval. */
+static bool tickless;
+static unsigned oneshot_cycles;
+static unsigned oneshot_first_boundary;
+static int64_t oneshot_ticks;
+
+/* Number of timer interrupts actually taken, and the TSC value
+   at the start of the last one. */
+static int64_t timer_interrupt_cnt;
+static uint64_t timer_interrupt_tsc;
 
 static intr_handler_func timer_interrupt;
-static bool too_many_loops (unsigned loops);
-static void busy_wait (int64_t loops);
+static intr_handler_func timer_ipi;
+static void start_oneshot (unsigned first_boundary, int64_t n);
+static void advance_tick (void);
+static int64_t ticks_until_wakeup (int64_t limit);
+static bool sleepers_due (int64_t tick);
+static void wake_sleepers (void *aux);
+static bool wakeup_less (const struct list_elem *, const struct list_elem *,
+                         void *aux);
+static uint64_t ns_to_cycles (uint64_t ns);
+static uint64_t cycles_to_ns (uint64_t cycles);
 static void real_time_sleep (int64_t num, int32_t denom);
 static void real_time_delay (int64_t num, int32_t denom);
 
@@ -35,35 +106,51 @@ static void real_time_delay (int64_t num, int32_t denom);
 void
 timer_init (void) 
 {
+  size_t i;
+
+  for (i = 0; i < SLEEP_WHEEL_SIZE; i++)
+    list_init (&sleep_wheel[i]);
+  deferred_work_init (&wake_work, wake_sleepers, NULL);
+
   pit_configure_channel (0, 2, TIMER_FREQ);
   intr_register_ext (0x20, timer_interrupt, "8254 Timer");
+  intr_register_ipi (IPI_TICK, timer_ipi, "Timer tick IPI");
 }
 
-/* Calibrates loops_per_tick, used to implement brief delays. */
+/* Measures the TSC frequency against the PIT, for timer_now_ns()
+   and brief delays.
+
+   The TSC is read on two timer interrupts CALIBRATE_TICKS ticks
+   apart.  Both readings are late by about the same interrupt
+   latency, so the error is well under 0.1%. */
 void
 timer_calibrate (void) 
 {
-  unsigned high_bit, test_bit;
+  enum intr_level old_level;
+  uint64_t start_tsc, end_tsc;
+  int64_t start;
 
   ASSERT (intr_get_level () == INTR_ON);
   printf ("Calibrating timer...  ");
 
-  /* Approximate loops_per_tick as the largest power-of-two
-     still less than one timer tick. */
-  loops_per_tick = 1u << 10;
-  while (!too_many_loops (loops_per_tick << 1)) 
-    {
-      loops_per_tick <<= 1;
-      ASSERT (loops_per_tick != 0);
-    }
+  /* Wait for a timer tick. */
+  start = ticks;
+  while (ticks == start)
+    barrier ();
 
-  /* Refine the next 8 bits of loops_per_tick. */
-  high_bit = loops_per_tick;
-  for (test_bit = high_bit >> 1; test_bit != high_bit >> 10; test_bit >>= 1)
-    if (!too_many_loops (high_bit | test_bit))
-      loops_per_tick |= test_bit;
+  start = ticks;
+  start_tsc = rdtsc ();
+  while (ticks - start < CALIBRATE_TICKS)
+    barrier ();
+  end_tsc = rdtsc ();
 
-  printf ("%'"PRIu64" loops/s.\n", (uint64_t) loops_per_tick * TIMER_FREQ);
+  old_level = intr_disable ();
+  tsc_hz = (end_tsc - start_tsc) * TIMER_FREQ / CALIBRATE_TICKS;
+  tsc_base = end_tsc;
+  ticks_base = start + CALIBRATE_TICKS;
+  intr_set_level (old_level);
+
+  printf ("%'"PRIu64" TSC cycles/s.\n", tsc_hz);
 }
 
 /* Returns the number of timer ticks since the OS booted. */
@@ -84,16 +171,44 @@ timer_elapsed (int64_t then)
   return timer_ticks () - then;
 }
 
+/* Returns the number of nanoseconds since the OS booted.  Before
+   timer_calibrate() has run, this has only tick resolution. */
+int64_t
+timer_now_ns (void) 
+{
+  enum intr_level old_level = intr_disable ();
+  int64_t ns;
+
+  if (tsc_hz == 0)
+    ns = ticks * NS_PER_TICK;
+  else
+    ns = ticks_base * NS_PER_TICK + cycles_to_ns (rdtsc () - tsc_base);
+  intr_set_level (old_level);
+  return ns;
+}
+
 /* Sleeps for approximately TICKS timer ticks.  Interrupts must
-   be turned on. */
+   be turned on.
+
+   The calling thread is blocked until the timer interrupt for
+   its wake-up tick, so it consumes no CPU time while asleep. */
 void
 timer_sleep (int64_t ticks) 
 {
-  int64_t start = timer_ticks ();
+  struct thread *cur = thread_current ();
+  enum intr_level old_level;
 
   ASSERT (intr_get_level () == INTR_ON);
-  while (timer_elapsed (start) < ticks) 
-    thread_yield ();
+  if (ticks <= 0)
+    return;
+
+  old_level = intr_disable ();
+  cur->wakeup_tick = timer_ticks () + ticks;
+  trace_event (TRACE_SLEEP, cur, ticks);
+  list_insert_ordered (sleep_bucket (cur->wakeup_tick), &cur->elem,
+                       wakeup_less, NULL);
+  thread_block ();
+  intr_set_level (old_level);
 }
 
 /* Sleeps for approximately MS milliseconds.  Interrupts must be
@@ -159,89 +274,334 @@ timer_ndelay (int64_t ns)
   real_time_delay (ns, 1000 * 1000 * 1000);
 }
 
+/* Returns the number of timer interrupts taken since the OS
+   booted.  With dynamic ticks this may be far less than the
+   number of ticks. */
+int64_t
+timer_interrupts (void)
+{
+  enum intr_level old_level = intr_disable ();
+  int64_t n = timer_interrupt_cnt;
+  intr_set_level (old_level);
+  return n;
+}
+
+/* Returns the time, as by timer_now_ns(), at which the most
+   recent timer interrupt was taken.  Meaningful only after
+   timer_calibrate(). */
+int64_t
+timer_last_interrupt_ns (void)
+{
+  enum intr_level old_level = intr_disable ();
+  int64_t ns = 0;
+
+  if (tsc_hz != 0 && timer_interrupt_tsc >= tsc_base)
+    ns = (ticks_base * NS_PER_TICK
+          + cycles_to_ns (timer_interrupt_tsc - tsc_base));
+  intr_set_level (old_level);
+  return ns;
+}
+
 /* Prints timer statistics. */
 void
 timer_print_stats (void) 
 {
-  printf ("Timer: %"PRId64" ticks\n", timer_ticks ());
+  printf ("Timer: %"PRId64" ticks, %"PRId64" interrupts\n",
+          timer_ticks (), timer_interrupts ());
 }
-
+
+/* Called by the idle thread, with interrupts off, just before it
+   halts the CPU.  If dynamic ticks are enabled and no sleeping
+   thread is due on the next tick, switches the PIT to a single
+   interrupt on the tick boundary of the earliest wake-up, or as
+   far ahead as the PIT can count.  Not done with more than one
+   CPU online, since the other CPUs still need every tick. */
+void
+timer_enter_tickless (void)
+{
+  int64_t n;
+  unsigned left;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+  if (!timer_tickless || tickless || cpu_cnt > 1)
+    return;
+
+  n = ticks_until_wakeup (TICKLESS_MAX_TICKS);
+  if (n < 2)
+    return;
+
+  /* A tick already latched at the PIC would be delivered as soon
+     as the CPU halts and could not be told apart from the
+     one-shot's own interrupt, so take it first. */
+  if (intr_ext_pending (0x20))
+    return;
+
+  /* In mode 2 the counter runs from TICK_CYCLES down to 1, so
+     LEFT is the distance to the next tick boundary. */
+  left = pit_read_count (0);
+  if (left == 0 || left > TICK_CYCLES)
+    left = TICK_CYCLES;
+  start_oneshot (left, n);
+
+  /* If a tick boundary passed while the one-shot was being set
+     up, its interrupt is now latched too and LEFT may already be
+     out of date, so go back to the periodic tick. */
+  if (intr_ext_pending (0x20))
+    {
+      tickless = false;
+      pit_configure_channel (0, 2, TIMER_FREQ);
+    }
+}
+
+/* Called at the start of every external interrupt.  If the PIT
+   is in one-shot mode, accounts for the ticks that passed
+   without an interrupt.
+
+   The PIT's output pin tells whether the one-shot has fired.  If
+   it has, the timer interrupt it raised, whether this one or one
+   still pending, accounts for the final tick, and the periodic
+   tick restarts on that boundary.
+
+   Otherwise the CPU was woken early, by another device or by a
+   tick latched just before the one-shot started, whose handler
+   accounts for that tick.  Only the boundaries passed so far are
+   accounted here, and a one-shot runs out the rest of the current
+   tick, so that the periodic tick restarts in phase. */
+void
+timer_leave_tickless (void)
+{
+  int64_t elapsed;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+  if (!tickless)
+    return;
+
+  if (pit_read_output (0))
+    {
+      elapsed = oneshot_ticks - 1;
+      tickless = false;
+      pit_configure_channel (0, 2, TIMER_FREQ);
+    }
+  else
+    {
+      unsigned left = pit_read_count (0);
+      unsigned done = (left != 0 && left <= oneshot_cycles
+                       ? oneshot_cycles - left : 0);
+
+      if (done < oneshot_first_boundary)
+        {
+          elapsed = 0;
+          start_oneshot (oneshot_first_boundary - done, 1);
+        }
+      else
+        {
+          unsigned since = done - oneshot_first_boundary;
+          elapsed = 1 + since / TICK_CYCLES;
+          start_oneshot (TICK_CYCLES - since % TICK_CYCLES, 1);
+        }
+    }
+
+  while (elapsed-- > 0)
+    advance_tick ();
+}
+
+/* Starts a PIT one-shot that ends on the tick boundary N ticks
+   from now, the first of which is FIRST_BOUNDARY PIT cycles
+   away. */
+static void
+start_oneshot (unsigned first_boundary, int64_t n)
+{
+  ASSERT (first_boundary >= 1 && first_boundary <= TICK_CYCLES);
+  ASSERT (n >= 1 && n <= TICKLESS_MAX_TICKS);
+
+  oneshot_first_boundary = first_boundary;
+  oneshot_cycles = first_boundary + (n - 1) * TICK_CYCLES;
+  oneshot_ticks = n;
+  tickless = true;
+  pit_start_oneshot (0, oneshot_cycles);
+}
+
 /* Timer interrupt handler. */
 static void
 timer_interrupt (struct intr_frame *args UNUSED)
 {
+  timer_interrupt_tsc = rdtsc ();
+  timer_interrupt_cnt++;
+  advance_tick ();
+}
+
+/* Timer tick IPI handler.  Only the boot processor takes timer
+   interrupts, and it passes each tick on to the other CPUs. */
+static void
+timer_ipi (struct intr_frame *args UNUSED)
+{
+  thread_tick ();
+}
+
+/* Accounts for one timer tick, and passes it on to the other
+   CPUs. */
+static void
+advance_tick (void)
+{
+  unsigned i;
+
   ticks++;
+  if (sleepers_due (ticks))
+    defer_schedule (&wake_work);
   thread_tick ();
-  //printf("Time is %d\n", ticks);
+
+  for (i = 1; i < cpu_cnt; i++)
+    lapic_send_ipi (cpus[i].apic_id, IPI_TICK);
 }
 
-/* Returns true if LOOPS iterations waits for more than one timer
-   tick, otherwise false. */
+/* Returns the number of ticks from now until the first tick on
+   which some sleeping thread is due, or LIMIT if none is due
+   within LIMIT ticks. */
+static int64_t
+ticks_until_wakeup (int64_t limit)
+{
+  int64_t n;
+
+  for (n = 1; n < limit; n++)
+    if (sleepers_due (ticks + n))
+      return n;
+  return limit;
+}
+
+/* Returns true if some sleeping thread is due to wake up on
+   TICK.  Interrupts must be off. */
 static bool
-too_many_loops (unsigned loops) 
+sleepers_due (int64_t tick)
 {
-  /* Wait for a timer tick. */
-  int64_t start = ticks;
-  while (ticks == start)
-    barrier ();
+  struct list *bucket = sleep_bucket (tick);
 
-  /* Run LOOPS loops. */
-  start = ticks;
-  busy_wait (loops);
+  return (!list_empty (bucket)
+          && list_entry (list_front (bucket), struct thread,
+                         elem)->wakeup_tick <= tick);
+}
+
+/* Unblocks every sleeping thread whose wake-up tick has
+   arrived.  Because each wheel bucket is sorted, this costs
+   time proportional to the number of threads woken, plus one
+   look at each bucket for the ticks since the last call.  Runs
+   as deferred work; interrupts are turned off for at most
+   WAKE_BATCH threads at a time. */
+static void
+wake_sleepers (void *aux UNUSED)
+{
+  enum intr_level old_level = intr_disable ();
+  int64_t now = ticks;
+  int64_t tick = woken_ticks + 1;
+  int batch = 0;
+
+  /* Every bucket holds the sleepers for many ticks, so one trip
+     around the wheel finds everyone who is due. */
+  if (now - tick >= SLEEP_WHEEL_SIZE)
+    tick = now - SLEEP_WHEEL_SIZE + 1;
+
+  for (; tick <= now; tick++)
+    {
+      struct list *bucket = sleep_bucket (tick);
+
+      while (!list_empty (bucket))
+        {
+          struct thread *t = list_entry (list_front (bucket),
+                                         struct thread, elem);
+          if (t->wakeup_tick > now)
+            break;
+          list_pop_front (bucket);
+          trace_event (TRACE_WAKE, t, now - t->wakeup_tick);
+          thread_unblock (t);
+
+          /* Let interrupts in after every batch.  The bucket may
+             change meanwhile, so its front is looked up again. */
+          if (++batch == WAKE_BATCH)
+            {
+              intr_set_level (old_level);
+              old_level = intr_disable ();
+              batch = 0;
+            }
+        }
+
+      /* Let interrupts in between buckets. */
+      intr_set_level (old_level);
+      old_level = intr_disable ();
+      batch = 0;
+    }
+  woken_ticks = now;
+  intr_set_level (old_level);
+}
+
+/* Returns true if sleeping thread A wakes up before sleeping
+   thread B, false otherwise. */
+static bool
+wakeup_less (const struct list_elem *a_, const struct list_elem *b_,
+             void *aux UNUSED)
+{
+  const struct thread *a = list_entry (a_, struct thread, elem);
+  const struct thread *b = list_entry (b_, struct thread, elem);
 
-  /* If the tick count changed, we iterated too long. */
-  barrier ();
-  return start != ticks;
+  return a->wakeup_tick < b->wakeup_tick;
 }
 
-/* Iterates through a simple loop LOOPS times, for implementing
-   brief delays.
+/* Converts NS nanoseconds to TSC cycles.  The division is split
+   so that the intermediate products cannot overflow. */
+static uint64_t
+ns_to_cycles (uint64_t ns) 
+{
+  return (ns / NS_PER_SEC * tsc_hz
+          + ns % NS_PER_SEC * tsc_hz / NS_PER_SEC);
+}
 
-   Marked NO_INLINE because code alignment can significantly
-   affect timings, so that if this function was inlined
-   differently in different places the results would be difficult
-   to predict. */
-static void NO_INLINE
-busy_wait (int64_t loops) 
+/* Converts CYCLES TSC cycles to nanoseconds. */
+static uint64_t
+cycles_to_ns (uint64_t cycles) 
 {
-  while (loops-- > 0)
-    barrier ();
+  return (cycles / tsc_hz * NS_PER_SEC
+          + cycles % tsc_hz * NS_PER_SEC / tsc_hz);
 }
 
-/* Sleep for approximately NUM/DENOM seconds. */
+/* Sleep until NUM/DENOM seconds from now.
+
+   Whole ticks are slept with timer_sleep(), which yields the CPU
+   to other threads.  A thread woken by the timer may still be up
+   to a tick short of the deadline, so the time left is checked
+   against the clock again, and the final fraction of a tick is
+   spent spinning on the TSC. */
 static void
 real_time_sleep (int64_t num, int32_t denom) 
 {
-  /* Convert NUM/DENOM seconds into timer ticks, rounding down.
-          
-        (NUM / DENOM) s          
-     ---------------------- = NUM * TIMER_FREQ / DENOM ticks. 
-     1 s / TIMER_FREQ ticks
-  */
-  int64_t ticks = num * TIMER_FREQ / denom;
+  int64_t deadline;
 
   ASSERT (intr_get_level () == INTR_ON);
-  if (ticks > 0)
-    {
-      /* We're waiting for at least one full timer tick.  Use
-         timer_sleep() because it will yield the CPU to other
-         processes. */                
-      timer_sleep (ticks); 
-    }
-  else 
+  ASSERT (NS_PER_SEC % denom == 0);
+  if (num <= 0)
+    return;
+
+  deadline = timer_now_ns () + num * (NS_PER_SEC / denom);
+  for (;;)
     {
-      /* Otherwise, use a busy-wait loop for more accurate
-         sub-tick timing. */
-      real_time_delay (num, denom); 
+      int64_t left = deadline - timer_now_ns ();
+      if (left < NS_PER_TICK)
+        break;
+      timer_sleep (left / NS_PER_TICK);
     }
+  while (timer_now_ns () < deadline)
+    barrier ();
 }
 
 /* Busy-wait for approximately NUM/DENOM seconds. */
 static void
 real_time_delay (int64_t num, int32_t denom)
 {
-  /* Scale the numerator and denominator down by 1000 to avoid
-     the possibility of overflow. */
-  ASSERT (denom % 1000 == 0);
-  busy_wait (loops_per_tick * num / 1000 * TIMER_FREQ / (denom / 1000)); 
+  uint64_t start = rdtsc ();
+  uint64_t cycles;
+
+  ASSERT (NS_PER_SEC % denom == 0);
+  if (num <= 0)
+    return;
+
+  cycles = ns_to_cycles (num * (NS_PER_SEC / denom));
+  while (rdtsc () - start < cycles)
+    barrier ();
 }
@@ -2,16 +2,22 @@
 #define DEVICES_TIMER_H
 
 #include <round.h>
+#include <stdbool.h>
 #include <stdint.h>
 
 /* Number of timer interrupts per second. */
 #define TIMER_FREQ 100
 
+/* If true, stop the periodic tick while idle.
+   Controlled by kernel command-line option "-tickless". */
+extern bool timer_tickless;
+
 void timer_init (void);
 void timer_calibrate (void);
 
 int64_t timer_ticks (void);
 int64_t timer_elapsed (int64_t);
+int64_t timer_now_ns (void);
 
 /* Sleep and yield the CPU to other threads. */
 void timer_sleep (int64_t ticks);
@@ -24,6 +30,12 @@ void timer_mdelay (int64_t milliseconds);
 void timer_udelay (int64_t microseconds);
 void timer_ndelay (int64_t nanoseconds);
 
+/* Dynamic ticks. */
+void timer_enter_tickless (void);
+void timer_leave_tickless (void);
+
+int64_t timer_interrupts (void);
+int64_t timer_last_interrupt_ns (void);
 void timer_print_stats (void);
 
 #endif /* devices/timer.h */
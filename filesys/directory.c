@@ -4,7 +4,8 @@
 #include <list.h>
 #include "filesys/filesys.h"
 #include "filesys/inode.h"
-#include "threads/malloc.h"
+#include "threads/slab.h"
+#include "threads/synch.h"
 
 /* A directory. */
 struct dir 
@@ -21,6 +22,36 @@ struct dir_entry
     bool in_use;                        /* In use or free? */
   };
 
+/* Guards the contents of all directories.  Lookups vastly
+   outnumber changes, so this is a reader-writer lock: lookups in
+   the same directory proceed in parallel, even while one of them
+   waits for the disk. */
+static struct rwlock dir_lock;
+
+/* Cache of directories.  A free directory has no inode and is at
+   position 0. */
+static struct kmem_cache *dir_cache;
+
+static kmem_ctor_func dir_ctor;
+
+/* Initializes the directory module. */
+void
+dir_init (void) 
+{
+  rwlock_init (&dir_lock);
+  dir_cache = kmem_cache_create ("dir", sizeof (struct dir), dir_ctor);
+}
+
+/* Constructs the free directory DIR_ for dir_cache. */
+static void
+dir_ctor (void *dir_) 
+{
+  struct dir *dir = dir_;
+
+  dir->inode = NULL;
+  dir->pos = 0;
+}
+
 /* Creates a directory with space for ENTRY_CNT entries in the
    given SECTOR.  Returns true if successful, false on failure. */
 bool
@@ -34,17 +65,16 @@ dir_create (block_sector_t sector, size_t entry_cnt)
 struct dir *
 dir_open (struct inode *inode) 
 {
-  struct dir *dir = calloc (1, sizeof *dir);
+  struct dir *dir = kmem_cache_alloc (dir_cache);
   if (inode != NULL && dir != NULL)
     {
       dir->inode = inode;
-      dir->pos = 0;
       return dir;
     }
   else
     {
       inode_close (inode);
-      free (dir);
+      kmem_cache_free (dir_cache, dir);
       return NULL; 
     }
 }
@@ -72,7 +102,9 @@ dir_close (struct dir *dir)
   if (dir != NULL)
     {
       inode_close (dir->inode);
-      free (dir);
+      dir->inode = NULL;
+      dir->pos = 0;
+      kmem_cache_free (dir_cache, dir);
     }
 }
 
@@ -124,10 +156,12 @@ dir_lookup (const struct dir *dir, const char *name,
   ASSERT (dir != NULL);
   ASSERT (name != NULL);
 
+  rwlock_read_acquire (&dir_lock);
   if (lookup (dir, name, &e, NULL))
     *inode = inode_open (e.inode_sector);
   else
     *inode = NULL;
+  rwlock_read_release (&dir_lock);
 
   return *inode != NULL;
 }
@@ -153,6 +187,7 @@ dir_add (struct dir *dir, const char *name, block_sector_t inode_sector)
     return false;
 
   /* Check that NAME is not in use. */
+  rwlock_write_acquire (&dir_lock);
   if (lookup (dir, name, NULL, NULL))
     goto done;
 
@@ -175,6 +210,7 @@ dir_add (struct dir *dir, const char *name, block_sector_t inode_sector)
   success = inode_write_at (dir->inode, &e, sizeof e, ofs) == sizeof e;
 
  done:
+  rwlock_write_release (&dir_lock);
   return success;
 }
 
@@ -193,6 +229,7 @@ dir_remove (struct dir *dir, const char *name)
   ASSERT (name != NULL);
 
   /* Find directory entry. */
+  rwlock_write_acquire (&dir_lock);
   if (!lookup (dir, name, &e, &ofs))
     goto done;
 
@@ -211,6 +248,7 @@ dir_remove (struct dir *dir, const char *name)
   success = true;
 
  done:
+  rwlock_write_release (&dir_lock);
   inode_close (inode);
   return success;
 }
@@ -222,15 +260,19 @@ bool
 dir_readdir (struct dir *dir, char name[NAME_MAX + 1])
 {
   struct dir_entry e;
+  bool found = false;
 
+  rwlock_read_acquire (&dir_lock);
   while (inode_read_at (dir->inode, &e, sizeof e, dir->pos) == sizeof e) 
     {
       dir->pos += sizeof e;
       if (e.in_use)
         {
           strlcpy (name, e.name, NAME_MAX + 1);
-          return true;
+          found = true;
+          break;
         } 
     }
-  return false;
+  rwlock_read_release (&dir_lock);
+  return found;
 }
@@ -6,6 +6,9 @@
 #include "filesys/filesys.h"
 #include "filesys/free-map.h"
 #include "threads/malloc.h"
+#include "threads/interrupt.h"
+#include "threads/slab.h"
+#include "threads/synch.h"
 
 /* Identifies an inode. */
 #define INODE_MAGIC 0x494e4f44
@@ -54,14 +57,39 @@ byte_to_sector (const struct inode *inode, off_t pos)
 }
 
 /* List of open inodes, so that opening a single inode twice
-   returns the same `struct inode'. */
+   returns the same `struct inode'.  Most opens find the inode
+   already on the list, so the list is guarded by a
+   reader-writer lock: lookups only read it, and only adding or
+   removing an inode writes it. */
 static struct list open_inodes;
+static struct rwlock open_inodes_lock;
+
+/* Cache of in-memory inodes.  A free inode is kept closed: no
+   openers, writable, and not removed. */
+static struct kmem_cache *inode_cache;
+
+static struct inode *find_open_inode (block_sector_t);
+static kmem_ctor_func inode_ctor;
 
 /* Initializes the inode module. */
 void
 inode_init (void) 
 {
   list_init (&open_inodes);
+  rwlock_init (&open_inodes_lock);
+  inode_cache = kmem_cache_create ("inode", sizeof (struct inode),
+                                   inode_ctor);
+}
+
+/* Constructs the closed inode INODE_ for inode_cache. */
+static void
+inode_ctor (void *inode_) 
+{
+  struct inode *inode = inode_;
+
+  inode->open_cnt = 0;
+  inode->deny_write_cnt = 0;
+  inode->removed = false;
 }
 
 /* Initializes an inode with LENGTH bytes of data and
@@ -111,42 +139,73 @@ inode_create (block_sector_t sector, off_t length)
 struct inode *
 inode_open (block_sector_t sector)
 {
-  struct list_elem *e;
-  struct inode *inode;
+  struct inode *inode, *other;
 
   /* Check whether this inode is already open. */
-  for (e = list_begin (&open_inodes); e != list_end (&open_inodes);
-       e = list_next (e)) 
-    {
-      inode = list_entry (e, struct inode, elem);
-      if (inode->sector == sector) 
-        {
-          inode_reopen (inode);
-          return inode; 
-        }
-    }
+  rwlock_read_acquire (&open_inodes_lock);
+  inode = find_open_inode (sector);
+  rwlock_read_release (&open_inodes_lock);
+  if (inode != NULL)
+    return inode;
 
-  /* Allocate memory. */
-  inode = malloc (sizeof *inode);
+  /* Allocate memory and read the inode without holding
+     open_inodes_lock, so that other opens and lookups do not
+     wait for the disk. */
+  inode = kmem_cache_alloc (inode_cache);
   if (inode == NULL)
     return NULL;
-
-  /* Initialize. */
-  list_push_front (&open_inodes, &inode->elem);
   inode->sector = sector;
-  inode->open_cnt = 1;
-  inode->deny_write_cnt = 0;
-  inode->removed = false;
   block_read (fs_device, inode->sector, &inode->data);
+
+  /* Check again, now with exclusive access, since another
+     thread may have opened it in the meantime.  If so, use
+     that copy and discard ours. */
+  rwlock_write_acquire (&open_inodes_lock);
+  other = find_open_inode (sector);
+  if (other == NULL)
+    {
+      list_push_front (&open_inodes, &inode->elem);
+      inode->open_cnt = 1;
+    }
+  rwlock_write_release (&open_inodes_lock);
+
+  if (other != NULL)
+    {
+      kmem_cache_free (inode_cache, inode);
+      inode = other;
+    }
   return inode;
 }
 
+/* Returns the open inode for SECTOR, reopened, or a null pointer
+   if it is not open.  The caller must hold open_inodes_lock. */
+static struct inode *
+find_open_inode (block_sector_t sector)
+{
+  struct list_elem *e;
+
+  for (e = list_begin (&open_inodes); e != list_end (&open_inodes);
+       e = list_next (e)) 
+    {
+      struct inode *inode = list_entry (e, struct inode, elem);
+      if (inode->sector == sector) 
+        return inode_reopen (inode);
+    }
+  return NULL;
+}
+
 /* Reopens and returns INODE. */
 struct inode *
 inode_reopen (struct inode *inode)
 {
   if (inode != NULL)
-    inode->open_cnt++;
+    {
+      /* Several readers of open_inodes may reopen the same inode
+         at once. */
+      enum intr_level old_level = intr_disable ();
+      inode->open_cnt++;
+      intr_set_level (old_level);
+    }
   return inode;
 }
 
@@ -167,11 +226,15 @@ inode_close (struct inode *inode)
   if (inode == NULL)
     return;
 
-  /* Release resources if this was the last opener. */
+  /* Release resources if this was the last opener.  The count
+     is dropped with open_inodes_lock held for writing, so that
+     no reader can reopen the inode while it is being freed. */
+  rwlock_write_acquire (&open_inodes_lock);
   if (--inode->open_cnt == 0)
     {
       /* Remove from inode list and release lock. */
       list_remove (&inode->elem);
+      rwlock_write_release (&open_inodes_lock);
  
       /* Deallocate blocks if removed. */
       if (inode->removed) 
@@ -179,10 +242,16 @@ inode_close (struct inode *inode)
           free_map_release (inode->sector, 1);
           free_map_release (inode->data.start,
                             bytes_to_sectors (inode->data.length)); 
+          inode->removed = false;
         }
 
-      free (inode); 
+      /* Every opener that denied writes has allowed them again,
+         so INODE is back in its constructed state. */
+      ASSERT (inode->deny_write_cnt == 0);
+      kmem_cache_free (inode_cache, inode); 
     }
+  else
+    rwlock_write_release (&open_inodes_lock);
 }
 
 /* Marks INODE to be deleted when it is closed by the last caller who
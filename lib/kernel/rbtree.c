@@ -0,0 +1,373 @@
+#include "rbtree.h"
+#include "../debug.h"
+
+/* Our red-black tree follows the algorithms in [CLRS] chapter 13,
+   except that leaves are represented by null pointers rather than
+   by a shared sentinel, so the removal fix-up tracks the parent
+   of the (possibly null) element it is fixing separately.
+
+   Invariants: every element is red or black; the root is black;
+   a red element has no red child; and every path from an element
+   down to a null leaf passes through the same number of black
+   elements.  Together these keep the tree's height below
+   2 lg (n + 1). */
+
+static bool is_red (const struct rb_elem *);
+static void replace_child (struct rb_tree *, struct rb_elem *old,
+                           struct rb_elem *new);
+static void rotate_left (struct rb_tree *, struct rb_elem *);
+static void rotate_right (struct rb_tree *, struct rb_elem *);
+static void insert_fixup (struct rb_tree *, struct rb_elem *);
+static void remove_fixup (struct rb_tree *, struct rb_elem *,
+                          struct rb_elem *parent);
+
+/* Initializes TREE as an empty tree ordered by LESS, given
+   auxiliary data AUX. */
+void
+rb_init (struct rb_tree *tree, rb_less_func *less, void *aux)
+{
+  ASSERT (tree != NULL);
+  ASSERT (less != NULL);
+
+  tree->root = NULL;
+  tree->first = NULL;
+  tree->less = less;
+  tree->aux = aux;
+}
+
+/* Inserts E into TREE.  E is placed after any elements that
+   compare equal to it. */
+void
+rb_insert (struct rb_tree *tree, struct rb_elem *e)
+{
+  struct rb_elem **link = &tree->root;
+  struct rb_elem *parent = NULL;
+  bool leftmost = true;
+
+  ASSERT (e != NULL);
+
+  while (*link != NULL)
+    {
+      parent = *link;
+      if (tree->less (e, parent, tree->aux))
+        link = &parent->left;
+      else
+        {
+          link = &parent->right;
+          leftmost = false;
+        }
+    }
+
+  e->parent = parent;
+  e->left = e->right = NULL;
+  e->red = true;
+  *link = e;
+  if (leftmost)
+    tree->first = e;
+
+  insert_fixup (tree, e);
+}
+
+/* Removes E, which must be in TREE, from TREE. */
+void
+rb_remove (struct rb_tree *tree, struct rb_elem *e)
+{
+  struct rb_elem *child, *parent;
+  bool removed_red;
+
+  ASSERT (e != NULL);
+
+  if (tree->first == e)
+    tree->first = rb_next (e);
+
+  if (e->left == NULL || e->right == NULL)
+    {
+      /* E has at most one child, which takes its place. */
+      child = e->left != NULL ? e->left : e->right;
+      parent = e->parent;
+      removed_red = e->red;
+      replace_child (tree, e, child);
+    }
+  else
+    {
+      /* E has two children.  Its successor S, the leftmost
+         element of its right subtree, has no left child.  S
+         takes E's place and color, and S's right child takes
+         S's old place. */
+      struct rb_elem *s = e->right;
+
+      while (s->left != NULL)
+        s = s->left;
+      removed_red = s->red;
+      child = s->right;
+      if (s->parent == e)
+        parent = s;
+      else
+        {
+          parent = s->parent;
+          replace_child (tree, s, child);
+          s->right = e->right;
+          s->right->parent = s;
+        }
+      replace_child (tree, e, s);
+      s->left = e->left;
+      s->left->parent = s;
+      s->red = e->red;
+    }
+
+  /* Removing a black element leaves its old path one black
+     element short. */
+  if (!removed_red)
+    remove_fixup (tree, child, parent);
+}
+
+/* Returns the least element in TREE, or a null pointer if TREE
+   is empty. */
+struct rb_elem *
+rb_first (const struct rb_tree *tree)
+{
+  return tree->first;
+}
+
+/* Returns the greatest element in TREE, or a null pointer if
+   TREE is empty. */
+struct rb_elem *
+rb_last (const struct rb_tree *tree)
+{
+  struct rb_elem *e = tree->root;
+
+  if (e != NULL)
+    while (e->right != NULL)
+      e = e->right;
+  return e;
+}
+
+/* Returns the element that follows E in its tree, or a null
+   pointer if E is the greatest element. */
+struct rb_elem *
+rb_next (struct rb_elem *e)
+{
+  if (e->right != NULL)
+    {
+      e = e->right;
+      while (e->left != NULL)
+        e = e->left;
+      return e;
+    }
+  while (e->parent != NULL && e == e->parent->right)
+    e = e->parent;
+  return e->parent;
+}
+
+/* Returns the element that precedes E in its tree, or a null
+   pointer if E is the least element. */
+struct rb_elem *
+rb_prev (struct rb_elem *e)
+{
+  if (e->left != NULL)
+    {
+      e = e->left;
+      while (e->right != NULL)
+        e = e->right;
+      return e;
+    }
+  while (e->parent != NULL && e == e->parent->left)
+    e = e->parent;
+  return e->parent;
+}
+
+/* Returns true if TREE is empty, false otherwise. */
+bool
+rb_empty (const struct rb_tree *tree)
+{
+  return tree->root == NULL;
+}
+
+/* Returns true if E is a red element.  Null leaves are black. */
+static bool
+is_red (const struct rb_elem *e)
+{
+  return e != NULL && e->red;
+}
+
+/* Makes NEW, which may be null, take OLD's place as a child of
+   OLD's parent in TREE. */
+static void
+replace_child (struct rb_tree *tree, struct rb_elem *old,
+               struct rb_elem *new)
+{
+  if (old->parent == NULL)
+    tree->root = new;
+  else if (old == old->parent->left)
+    old->parent->left = new;
+  else
+    old->parent->right = new;
+  if (new != NULL)
+    new->parent = old->parent;
+}
+
+/* Rotates E's right child up into E's place. */
+static void
+rotate_left (struct rb_tree *tree, struct rb_elem *e)
+{
+  struct rb_elem *r = e->right;
+
+  e->right = r->left;
+  if (r->left != NULL)
+    r->left->parent = e;
+  replace_child (tree, e, r);
+  r->left = e;
+  e->parent = r;
+}
+
+/* Rotates E's left child up into E's place. */
+static void
+rotate_right (struct rb_tree *tree, struct rb_elem *e)
+{
+  struct rb_elem *l = e->left;
+
+  e->left = l->right;
+  if (l->right != NULL)
+    l->right->parent = e;
+  replace_child (tree, e, l);
+  l->right = e;
+  e->parent = l;
+}
+
+/* Restores the red-black invariants after inserting red element
+   E, which may now have a red parent. */
+static void
+insert_fixup (struct rb_tree *tree, struct rb_elem *e)
+{
+  struct rb_elem *parent;
+
+  while (is_red (parent = e->parent))
+    {
+      /* PARENT is red, so it is not the root and has a parent. */
+      struct rb_elem *grandparent = parent->parent;
+
+      if (parent == grandparent->left)
+        {
+          struct rb_elem *uncle = grandparent->right;
+          if (is_red (uncle))
+            {
+              parent->red = uncle->red = false;
+              grandparent->red = true;
+              e = grandparent;
+              continue;
+            }
+          if (e == parent->right)
+            {
+              rotate_left (tree, parent);
+              e = parent;
+              parent = e->parent;
+            }
+          parent->red = false;
+          grandparent->red = true;
+          rotate_right (tree, grandparent);
+        }
+      else
+        {
+          struct rb_elem *uncle = grandparent->left;
+          if (is_red (uncle))
+            {
+              parent->red = uncle->red = false;
+              grandparent->red = true;
+              e = grandparent;
+              continue;
+            }
+          if (e == parent->left)
+            {
+              rotate_right (tree, parent);
+              e = parent;
+              parent = e->parent;
+            }
+          parent->red = false;
+          grandparent->red = true;
+          rotate_left (tree, grandparent);
+        }
+    }
+  tree->root->red = false;
+}
+
+/* Restores the red-black invariants after removing a black
+   element.  E, which may be null, is the child of PARENT that
+   took the removed element's place, and the paths through E are
+   one black element short. */
+static void
+remove_fixup (struct rb_tree *tree, struct rb_elem *e,
+              struct rb_elem *parent)
+{
+  while (e != tree->root && !is_red (e))
+    {
+      /* E's sibling is not null, because the paths through it
+         have at least one more black element than those through
+         E. */
+      if (e == parent->left)
+        {
+          struct rb_elem *sibling = parent->right;
+          if (sibling->red)
+            {
+              sibling->red = false;
+              parent->red = true;
+              rotate_left (tree, parent);
+              sibling = parent->right;
+            }
+          if (!is_red (sibling->left) && !is_red (sibling->right))
+            {
+              sibling->red = true;
+              e = parent;
+              parent = e->parent;
+            }
+          else
+            {
+              if (!is_red (sibling->right))
+                {
+                  sibling->left->red = false;
+                  sibling->red = true;
+                  rotate_right (tree, sibling);
+                  sibling = parent->right;
+                }
+              sibling->red = parent->red;
+              parent->red = false;
+              sibling->right->red = false;
+              rotate_left (tree, parent);
+              e = tree->root;
+            }
+        }
+      else
+        {
+          struct rb_elem *sibling = parent->left;
+          if (sibling->red)
+            {
+              sibling->red = false;
+              parent->red = true;
+              rotate_right (tree, parent);
+              sibling = parent->left;
+            }
+          if (!is_red (sibling->left) && !is_red (sibling->right))
+            {
+              sibling->red = true;
+              e = parent;
+              parent = e->parent;
+            }
+          else
+            {
+              if (!is_red (sibling->left))
+                {
+                  sibling->right->red = false;
+                  sibling->red = true;
+                  rotate_left (tree, sibling);
+                  sibling = parent->left;
+                }
+              sibling->red = parent->red;
+              parent->red = false;
+              sibling->left->red = false;
+              rotate_right (tree, parent);
+              e = tree->root;
+            }
+        }
+    }
+  if (e != NULL)
+    e->red = false;
+}
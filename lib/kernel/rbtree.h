@@ -0,0 +1,74 @@
+#ifndef __LIB_KERNEL_RBTREE_H
+#define __LIB_KERNEL_RBTREE_H
+
+/* Red-black tree.
+
+   A red-black tree is a binary search tree that keeps itself
+   balanced, so that insertion, removal, and lookup each take
+   O(lg n) time.  This tree also caches its leftmost element, so
+   that finding the minimum takes constant time.
+
+   Like the linked list in list.h, this tree does not use dynamic
+   allocation.  Each structure that can be in a tree must embed a
+   struct rb_elem member, and the rb_entry macro converts a
+   struct rb_elem back to a pointer to its enclosing structure.
+   Refer to lib/kernel/list.h for a detailed explanation.
+
+   Elements are ordered by a caller-supplied comparison function.
+   Elements that compare equal are kept in insertion order, so
+   the tree may also be used as a priority queue in which equal
+   keys are served first-come, first-served. */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* Red-black tree element. */
+struct rb_elem
+  {
+    struct rb_elem *parent;     /* Parent, or null for the root. */
+    struct rb_elem *left;       /* Left child, or null. */
+    struct rb_elem *right;      /* Right child, or null. */
+    bool red;                   /* Red or black? */
+  };
+
+/* Converts pointer to tree element RB_ELEM into a pointer to the
+   structure that RB_ELEM is embedded inside.  Supply the name of
+   the outer structure STRUCT and the member name MEMBER of the
+   tree element. */
+#define rb_entry(RB_ELEM, STRUCT, MEMBER)               \
+        ((STRUCT *) ((uint8_t *) &(RB_ELEM)->parent     \
+                     - offsetof (STRUCT, MEMBER.parent)))
+
+/* Compares the value of two tree elements A and B, given
+   auxiliary data AUX.  Returns true if A is less than B, or
+   false if A is greater than or equal to B. */
+typedef bool rb_less_func (const struct rb_elem *a,
+                           const struct rb_elem *b,
+                           void *aux);
+
+/* Red-black tree. */
+struct rb_tree
+  {
+    struct rb_elem *root;       /* Root element, or null if empty. */
+    struct rb_elem *first;      /* Leftmost element, or null if empty. */
+    rb_less_func *less;         /* Comparison function. */
+    void *aux;                  /* Auxiliary data for `less'. */
+  };
+
+void rb_init (struct rb_tree *, rb_less_func *, void *aux);
+
+/* Insertion and removal. */
+void rb_insert (struct rb_tree *, struct rb_elem *);
+void rb_remove (struct rb_tree *, struct rb_elem *);
+
+/* Traversal. */
+struct rb_elem *rb_first (const struct rb_tree *);
+struct rb_elem *rb_last (const struct rb_tree *);
+struct rb_elem *rb_next (struct rb_elem *);
+struct rb_elem *rb_prev (struct rb_elem *);
+
+/* Properties. */
+bool rb_empty (const struct rb_tree *);
+
+#endif /* lib/kernel/rbtree.h */
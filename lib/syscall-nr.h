@@ -28,7 +28,14 @@ enum
     SYS_MKDIR,                  /* Create a directory. */
     SYS_READDIR,                /* Reads a directory entry. */
     SYS_ISDIR,                  /* Tests if a fd represents a directory. */
-    SYS_INUMBER                 /* Returns the inode number for a fd. */
+    SYS_INUMBER,                /* Returns the inode number for a fd. */
+
+    /* User-level synchronization. */
+    SYS_FUTEX_WAIT,             /* Wait on a futex. */
+    SYS_FUTEX_WAKE,             /* Wake threads waiting on a futex. */
+
+    /* Accounting. */
+    SYS_CPU_USAGE               /* Obtains the CPU cycles used so far. */
   };
 
 #endif /* lib/syscall-nr.h */
@@ -0,0 +1,72 @@
+#include <mutex.h>
+#include <syscall.h>
+
+/* Mutex states. */
+#define UNLOCKED 0              /* Not held. */
+#define LOCKED 1                /* Held, no thread waiting. */
+#define CONTENDED 2             /* Held, threads may be waiting. */
+
+/* Atomically sets *P to NEW if it equals OLD.  Returns the value
+   *P had before. */
+static inline int
+compare_and_swap (int *p, int old, int new) 
+{
+  int prev;
+  asm volatile ("lock cmpxchgl %2, %1"
+                : "=a" (prev), "+m" (*p)
+                : "r" (new), "0" (old)
+                : "memory");
+  return prev;
+}
+
+/* Atomically sets *P to NEW.  Returns the value *P had before. */
+static inline int
+exchange (int *p, int new) 
+{
+  asm volatile ("xchgl %0, %1"
+                : "+r" (new), "+m" (*p)
+                :
+                : "memory");
+  return new;
+}
+
+/* Initializes MUTEX as unlocked. */
+void
+mutex_init (struct mutex *mutex) 
+{
+  mutex->state = UNLOCKED;
+}
+
+/* Acquires MUTEX, sleeping until it is available if necessary.
+
+   A thread that finds the mutex held marks it CONTENDED before
+   it sleeps, so that the holder knows to call futex_wake() when
+   it unlocks.  A thread woken this way cannot tell whether
+   others are still waiting, so it also takes the mutex as
+   CONTENDED, at worst costing one needless futex_wake(). */
+void
+mutex_lock (struct mutex *mutex) 
+{
+  if (compare_and_swap (&mutex->state, UNLOCKED, LOCKED) == UNLOCKED)
+    return;
+
+  while (exchange (&mutex->state, CONTENDED) != UNLOCKED)
+    futex_wait (&mutex->state, CONTENDED);
+}
+
+/* Tries to acquire MUTEX without sleeping.  Returns true if
+   successful, false if MUTEX is already held. */
+bool
+mutex_trylock (struct mutex *mutex) 
+{
+  return compare_and_swap (&mutex->state, UNLOCKED, LOCKED) == UNLOCKED;
+}
+
+/* Releases MUTEX, which the calling thread must hold, and wakes
+   one thread waiting for it, if any. */
+void
+mutex_unlock (struct mutex *mutex) 
+{
+  if (exchange (&mutex->state, UNLOCKED) == CONTENDED)
+    futex_wake (&mutex->state, 1);
+}
@@ -0,0 +1,23 @@
+#ifndef __LIB_USER_MUTEX_H
+#define __LIB_USER_MUTEX_H
+
+#include <stdbool.h>
+
+/* A mutex for the threads of one process, or for processes that
+   share its memory, built on futexes.  Locking and unlocking a
+   mutex that no other thread wants never enters the kernel. */
+struct mutex
+  {
+    int state;          /* 0: unlocked, 1: locked,
+                           2: locked, maybe with waiters. */
+  };
+
+/* Initializer for a statically allocated, unlocked mutex. */
+#define MUTEX_INITIALIZER { 0 }
+
+void mutex_init (struct mutex *);
+void mutex_lock (struct mutex *);
+bool mutex_trylock (struct mutex *);
+void mutex_unlock (struct mutex *);
+
+#endif /* lib/user/mutex.h */
@@ -182,3 +182,21 @@ inumber (int fd)
 {
   return syscall1 (SYS_INUMBER, fd);
 }
+
+int
+futex_wait (int *addr, int expected)
+{
+  return syscall2 (SYS_FUTEX_WAIT, addr, expected);
+}
+
+int
+futex_wake (int *addr, int cnt)
+{
+  return syscall2 (SYS_FUTEX_WAKE, addr, cnt);
+}
+
+bool
+cpu_usage (struct cpu_usage *usage)
+{
+  return syscall1 (SYS_CPU_USAGE, usage);
+}
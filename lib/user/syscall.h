@@ -2,6 +2,7 @@
 #define __LIB_USER_SYSCALL_H
 
 #include <stdbool.h>
+#include <stdint.h>
 #include <debug.h>
 
 /* Process identifier. */
@@ -45,4 +46,19 @@ bool readdir (int fd, char name[READDIR_MAX_LEN + 1]);
 bool isdir (int fd);
 int inumber (int fd);
 
+/* User-level synchronization. */
+int futex_wait (int *addr, int expected);
+int futex_wake (int *addr, int cnt);
+
+/* CPU time used by the calling process, in CPU cycles. */
+struct cpu_usage
+  {
+    uint64_t kernel_cycles;     /* In the kernel, on the process's behalf. */
+    uint64_t user_cycles;       /* In user code. */
+    uint64_t intr_cycles;       /* In interrupt handlers. */
+  };
+
+/* Accounting. */
+bool cpu_usage (struct cpu_usage *);
+
 #endif /* lib/user/syscall.h */
@@ -33,6 +33,45 @@ sub check_expected {
     compare_output ("run", @options, \@output, $expected);
 }
 
+# check_expected_pattern ([IGNORE_EXIT_CODES => 1], $EXPECTED)
+#
+# Like check_expected, for tests whose output includes figures
+# that vary from run to run.  $EXPECTED is the one acceptable
+# output.  Its text must match exactly, except that "{N}" matches
+# a decimal integer and a line that is just "{LINES}" matches any
+# number of lines.  Returns the integers matched by "{N}", in
+# order, so that the caller can check that they are in bounds.
+sub check_expected_pattern {
+    my ($expected) = pop @_;
+    my (%options) = @_;
+    my (@output) = read_text_file ("$test.output");
+    common_checks ("run", @output);
+    @output = get_core_output ("run", @output);
+    fail "Run didn't produce any output" if !@output;
+
+    if (exists $options{IGNORE_EXIT_CODES}) {
+	delete $options{IGNORE_EXIT_CODES};
+	@output = grep (!/^[a-zA-Z0-9-_]+: exit\(\-?\d+\)$/, @output);
+    }
+    die "unknown option " . (keys (%options))[0] . "\n" if %options;
+
+    my ($re) = join ('', map ($_ eq '{LINES}'
+			      ? '(?:.*\n)*?'
+			      : quotemeta ($_) . '\n',
+			      split ("\n", $expected)));
+    $re =~ s/\\\{N\\\}/(-?\\d+)/g;
+
+    my ($output) = join ('', map ("$_\n", @output));
+    return map (substr ($output, $-[$_], $+[$_] - $-[$_]), 1...$#-)
+      if $output =~ /^$re\z/;
+
+    fail "Test output failed to match the acceptable form.\n\n"
+      . "Acceptable output:\n"
+      . join ('', map ("  $_\n", split ("\n", $expected)))
+      . "Actual output:\n"
+      . join ('', map ("  $_\n", @output));
+}
+
 sub common_checks {
     my ($run, @output) = @_;
 
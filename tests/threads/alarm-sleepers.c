@@ -0,0 +1,105 @@
+/* Creates 1,000 threads that all sleep at the same time, each
+   waking on one of 100 consecutive ticks, and verifies that none
+   of them wakes early.
+
+   Thread statistics are printed just before the threads go to
+   sleep and again after the last one wakes.  Sleepers should
+   not consume CPU time, so nearly every tick in between should
+   be counted as idle. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/interrupt.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+#define SLEEPER_CNT 1000        /* Number of sleeping threads. */
+#define WAKE_SPREAD 100         /* Wake-ups spread over this many ticks. */
+
+/* Information about the test. */
+struct sleepers_test 
+  {
+    int64_t start;              /* Tick at which wake-ups begin. */
+    struct semaphore done;      /* Upped once by each sleeper. */
+    int early_cnt;              /* Sleepers that woke too early. */
+    int64_t max_lateness;       /* Largest wake-up delay, in ticks. */
+  };
+
+/* Information about an individual sleeper. */
+struct sleeper_info
+  {
+    struct sleepers_test *test; /* Info shared between all threads. */
+    int64_t wakeup;             /* Tick to wake up at. */
+  };
+
+static struct sleeper_info sleepers[SLEEPER_CNT];
+
+static void sleeper (void *);
+
+void
+test_alarm_sleepers (void) 
+{
+  struct sleepers_test test;
+  int i;
+
+  /* This test does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+
+  msg ("Creating %d threads that wake up over %d ticks.",
+       SLEEPER_CNT, WAKE_SPREAD);
+
+  test.start = timer_ticks () + 500;
+  sema_init (&test.done, 0);
+  test.early_cnt = 0;
+  test.max_lateness = 0;
+
+  for (i = 0; i < SLEEPER_CNT; i++) 
+    {
+      struct sleeper_info *s = &sleepers[i];
+      char name[16];
+
+      s->test = &test;
+      s->wakeup = test.start + i % WAKE_SPREAD;
+      snprintf (name, sizeof name, "sleeper %d", i);
+      if (thread_create (name, PRI_DEFAULT, sleeper, s) == TID_ERROR)
+        fail ("could not create thread %d", i);
+    }
+
+  /* Sleep ourselves until shortly before the first wake-up, so
+     that the measured window covers only the sleepers. */
+  timer_sleep (test.start - timer_ticks () - 1);
+  thread_print_stats ();
+
+  for (i = 0; i < SLEEPER_CNT; i++)
+    sema_down (&test.done);
+
+  thread_print_stats ();
+  msg ("Maximum wake-up lateness: %lld ticks.", test.max_lateness);
+  if (test.early_cnt != 0)
+    fail ("%d threads woke up early", test.early_cnt);
+  pass ();
+}
+
+/* Sleeper thread. */
+static void
+sleeper (void *s_) 
+{
+  struct sleeper_info *s = s_;
+  struct sleepers_test *test = s->test;
+  enum intr_level old_level;
+  int64_t now;
+
+  timer_sleep (s->wakeup - timer_ticks ());
+  now = timer_ticks ();
+
+  old_level = intr_disable ();
+  if (now < s->wakeup)
+    test->early_cnt++;
+  else if (now - s->wakeup > test->max_lateness)
+    test->max_lateness = now - s->wakeup;
+  intr_set_level (old_level);
+
+  sema_up (&test->done);
+}
@@ -0,0 +1,29 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+my (@v) = check_expected_pattern (IGNORE_EXIT_CODES => 1, <<'EOF');
+(alarm-sleepers) begin
+(alarm-sleepers) Creating 1000 threads that wake up over 100 ticks.
+Thread: {N} idle ticks, {N} kernel ticks, {N} user ticks
+Thread page cache: {N} hits, {N} misses
+Thread: {N} idle cycles, {N} kernel cycles, {N} user cycles, {N} interrupt cycles
+{LINES}
+Thread: {N} idle ticks, {N} kernel ticks, {N} user ticks
+Thread page cache: {N} hits, {N} misses
+Thread: {N} idle cycles, {N} kernel cycles, {N} user cycles, {N} interrupt cycles
+{LINES}
+(alarm-sleepers) Maximum wake-up lateness: {N} ticks.
+(alarm-sleepers) PASS
+(alarm-sleepers) end
+EOF
+my ($idle) = $v[9] - $v[0];
+my ($busy) = $v[10] - $v[1];
+my ($lateness) = $v[18];
+
+# Sleepers use no CPU, so most of the ticks spent waking them
+# should be idle.
+fail "Only $idle of " . ($idle + $busy) . " ticks while sleeping were idle.\n"
+  if $idle < $busy;
+fail "Sleepers woke up as much as $lateness ticks late.\n" if $lateness > 10;
+pass;
@@ -0,0 +1,135 @@
+/* Starts a number of CPU-bound threads, all on the same CPU, and
+   verifies that the load balancer spreads them out so that no
+   CPU runs more than one thread more than any other.
+
+   Each thread keeps recording which CPU it is running on.  The
+   main thread samples those records every few ticks until the
+   load is balanced, and fails if that takes too long.  Per-CPU
+   scheduling statistics are printed at the end, so that steals
+   and migrations can be inspected.
+
+   On a uniprocessor the load is trivially balanced, so the test
+   fails there rather than pass without testing anything. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/cpu.h"
+#include "threads/init.h"
+#include "threads/interrupt.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+#define SPINNER_CNT 16          /* Number of CPU-bound threads. */
+#define SAMPLE_TICKS 10         /* Ticks between samples. */
+#define DEADLINE_TICKS 1000     /* Time allowed to converge. */
+
+/* Information about the test. */
+struct converge_test 
+  {
+    volatile bool stop;                 /* Tells spinners to exit. */
+    volatile unsigned cpu[SPINNER_CNT]; /* CPU each spinner last ran on. */
+    struct semaphore done;              /* Upped once by each spinner. */
+  };
+
+/* Information about an individual spinner. */
+struct spinner_info
+  {
+    struct converge_test *test; /* Info shared between all threads. */
+    int id;                     /* Index into test->cpu[]. */
+  };
+
+static struct spinner_info spinners[SPINNER_CNT];
+
+static void spinner (void *);
+static bool balanced (struct converge_test *);
+
+void
+test_balance_converge (void) 
+{
+  struct converge_test test;
+  int64_t start;
+  int i;
+
+  /* This test does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+
+  if (cpu_cnt < 2)
+    fail ("needs at least 2 CPUs, but only %u are running", cpu_cnt);
+
+  /* Run at a higher priority than the spinners, so that sampling
+     happens on time. */
+  thread_set_priority (PRI_DEFAULT + 1);
+
+  msg ("Starting %d CPU-bound threads on one CPU.", SPINNER_CNT);
+  test.stop = false;
+  sema_init (&test.done, 0);
+  for (i = 0; i < SPINNER_CNT; i++) 
+    {
+      struct spinner_info *s = &spinners[i];
+      char name[16];
+
+      s->test = &test;
+      s->id = i;
+      test.cpu[i] = cpu_current ()->id;
+      snprintf (name, sizeof name, "spinner %d", i);
+      if (thread_create (name, PRI_DEFAULT, spinner, s) == TID_ERROR)
+        fail ("could not create thread %d", i);
+    }
+
+  start = timer_ticks ();
+  while (!balanced (&test))
+    {
+      if (timer_elapsed (start) > DEADLINE_TICKS)
+        fail ("load did not balance within %d ticks", DEADLINE_TICKS);
+      timer_sleep (SAMPLE_TICKS);
+    }
+  msg ("Load is balanced across %u CPUs.", cpu_cnt);
+
+  test.stop = true;
+  for (i = 0; i < SPINNER_CNT; i++)
+    sema_down (&test.done);
+
+  thread_print_cpu_stats ();
+  pass ();
+}
+
+/* Returns true if the number of spinners last seen on each CPU
+   differs by at most one between any two CPUs. */
+static bool
+balanced (struct converge_test *test) 
+{
+  int load[CPU_MAX] = { 0 };
+  int min, max;
+  unsigned c;
+  int i;
+
+  for (i = 0; i < SPINNER_CNT; i++)
+    load[test->cpu[i]]++;
+
+  min = max = load[0];
+  for (c = 1; c < cpu_cnt; c++)
+    {
+      if (load[c] < min)
+        min = load[c];
+      if (load[c] > max)
+        max = load[c];
+    }
+  return max - min <= 1;
+}
+
+/* Spinner thread. */
+static void
+spinner (void *s_) 
+{
+  struct spinner_info *s = s_;
+  struct converge_test *test = s->test;
+
+  while (!test->stop)
+    {
+      enum intr_level old_level = intr_disable ();
+      test->cpu[s->id] = cpu_current ()->id;
+      intr_set_level (old_level);
+    }
+  sema_up (&test->done);
+}
@@ -0,0 +1,29 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+our ($test);
+my ($cpu_cnt) = check_expected_pattern (<<'EOF');
+(balance-converge) begin
+(balance-converge) Starting 16 CPU-bound threads on one CPU.
+(balance-converge) Load is balanced across {N} CPUs.
+{LINES}
+(balance-converge) PASS
+(balance-converge) end
+EOF
+my (@stats) = grep (/^CPU \d+: /,
+		    get_core_output ("run", read_text_file ("$test.output")));
+fail "Expected statistics for $cpu_cnt CPUs, got " . scalar (@stats) . ".\n"
+  if @stats != $cpu_cnt;
+
+# Every spinner started on one CPU, so balancing them must have
+# moved some.
+my ($moved) = 0;
+foreach (@stats) {
+    my ($steals, $migrations)
+      = /^CPU \d+: \d+ idle ticks, (\d+) steals, (\d+) migrations$/
+	or fail "Malformed statistics line: $_\n";
+    $moved += $steals + $migrations;
+}
+fail "Load balanced without moving any thread.\n" if !$moved;
+pass;
@@ -0,0 +1,119 @@
+/* Exercises the load balancer's thread migration directly.  On
+   a uniprocessor the balancer never runs, so the test gives the
+   next CPU slot a run queue of its own that no CPU serves, and
+   moves threads between it and this CPU with thread_pull().
+
+   WORKER_CNT threads block on a semaphore and are then woken
+   onto the idle run queue.  Having just run, they are
+   cache-hot, so a pull must not take any of them.  Once they
+   have cooled down, a pull must take the one at the tail of the
+   queue, which was woken last, and a pull in the other
+   direction must not take it straight back.  The rest are then
+   pulled over, so that every worker runs here and exits. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/cpu.h"
+#include "threads/init.h"
+#include "threads/interrupt.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+#define WORKER_CNT 4            /* Number of worker threads. */
+#define COOL_TICKS 10           /* Ticks after which a thread is cold. */
+
+/* A worker thread. */
+struct worker
+  {
+    struct thread *thread;      /* The worker. */
+    unsigned cpu;               /* CPU it finally ran on. */
+  };
+
+static struct worker workers[WORKER_CNT];
+static struct semaphore go, done;
+
+static thread_func worker_func;
+
+void
+test_balance_pull (void)
+{
+  struct cpu *here = cpu_current ();
+  struct cpu *there;
+  enum intr_level old_level;
+  struct thread *t;
+  int i;
+
+  /* This test does not work with the MLFQS or CFS. */
+  ASSERT (!thread_mlfqs && !thread_cfs);
+  ASSERT (cpu_cnt < CPU_MAX);
+
+  there = &cpus[cpu_cnt];
+  cpu_init_data (there, cpu_cnt);
+  sema_init (&go, 0);
+  sema_init (&done, 0);
+
+  /* Each worker outranks us, so it runs and blocks at once. */
+  for (i = 0; i < WORKER_CNT; i++)
+    {
+      char name[16];
+      snprintf (name, sizeof name, "worker %d", i);
+      thread_create (name, PRI_DEFAULT + 1, worker_func, &workers[i]);
+    }
+
+  old_level = intr_disable ();
+  for (i = 0; i < WORKER_CNT; i++)
+    workers[i].thread->cpu = there;
+  for (i = 0; i < WORKER_CNT; i++)
+    sema_up (&go);
+  if (there->rq.cnt != WORKER_CNT)
+    fail ("%d threads queued on the other CPU, not %d",
+          there->rq.cnt, WORKER_CNT);
+  if (thread_pull (here, there) != NULL)
+    fail ("pulled a cache-hot thread");
+  intr_set_level (old_level);
+  msg ("Cache-hot threads stayed put.");
+
+  timer_sleep (COOL_TICKS);
+  old_level = intr_disable ();
+  t = thread_pull (here, there);
+  if (t == NULL)
+    fail ("pulled no thread");
+  if (t != workers[WORKER_CNT - 1].thread)
+    fail ("pulled %s, not the thread at the tail of the queue", t->name);
+  if (t->cpu != here || there->rq.cnt != WORKER_CNT - 1)
+    fail ("%s was not moved", t->name);
+  if (thread_pull (there, here) != NULL)
+    fail ("pulled a thread straight back");
+  intr_set_level (old_level);
+  msg ("Pulled the thread at the tail, and it was not pulled back.");
+
+  /* Bring the rest over so that they can finish. */
+  timer_sleep (COOL_TICKS);
+  old_level = intr_disable ();
+  while (thread_pull (here, there) != NULL)
+    continue;
+  if (there->rq.cnt != 0)
+    fail ("%d threads could not be pulled back", there->rq.cnt);
+  intr_set_level (old_level);
+
+  for (i = 0; i < WORKER_CNT; i++)
+    sema_down (&done);
+  for (i = 0; i < WORKER_CNT; i++)
+    if (workers[i].cpu != here->id)
+      fail ("worker %d ran on CPU %u", i, workers[i].cpu);
+  pass ();
+}
+
+/* Worker thread.  Blocks until woken, then records the CPU it
+   runs on. */
+static void
+worker_func (void *w_)
+{
+  struct worker *w = w_;
+
+  w->thread = thread_current ();
+  sema_down (&go);
+  w->cpu = cpu_current ()->id;
+  sema_up (&done);
+}
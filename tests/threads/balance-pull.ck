@@ -0,0 +1,12 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(balance-pull) begin
+(balance-pull) Cache-hot threads stayed put.
+(balance-pull) Pulled the thread at the tail, and it was not pulled back.
+(balance-pull) PASS
+(balance-pull) end
+EOF
+pass;
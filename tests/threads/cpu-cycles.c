@@ -0,0 +1,72 @@
+/* Runs one thread that spins for 20 ticks and another that
+   sleeps for 20 ticks, and verifies that per-thread cycle
+   accounting charges the spinner far more kernel cycles than
+   the sleeper, even though both exist for the same wall-clock
+   time. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+#define RUN_TICKS 20            /* How long each thread runs. */
+
+/* Cycles used by one thread. */
+struct cycles_info
+  {
+    uint64_t cycles[CPU_MODE_CNT];      /* As reported at its end. */
+    struct semaphore done;              /* Upped when it finishes. */
+  };
+
+static void spinner (void *);
+static void sleeper (void *);
+
+void
+test_cpu_cycles (void) 
+{
+  struct cycles_info spin, sleep;
+
+  sema_init (&spin.done, 0);
+  sema_init (&sleep.done, 0);
+  thread_create ("spinner", PRI_DEFAULT, spinner, &spin);
+  thread_create ("sleeper", PRI_DEFAULT, sleeper, &sleep);
+  sema_down (&spin.done);
+  sema_down (&sleep.done);
+
+  msg ("spinner: %llu kernel cycles, %llu interrupt cycles.",
+       spin.cycles[CPU_MODE_KERNEL], spin.cycles[CPU_MODE_INTR]);
+  msg ("sleeper: %llu kernel cycles, %llu interrupt cycles.",
+       sleep.cycles[CPU_MODE_KERNEL], sleep.cycles[CPU_MODE_INTR]);
+
+  if (spin.cycles[CPU_MODE_USER] != 0 || sleep.cycles[CPU_MODE_USER] != 0)
+    fail ("kernel threads were charged user cycles");
+  if (spin.cycles[CPU_MODE_KERNEL] < 10 * sleep.cycles[CPU_MODE_KERNEL])
+    fail ("spinner should use at least 10 times the sleeper's cycles");
+  pass ();
+}
+
+/* Busy-waits for RUN_TICKS timer ticks. */
+static void
+spinner (void *info_) 
+{
+  struct cycles_info *info = info_;
+  int64_t start = timer_ticks ();
+
+  while (timer_elapsed (start) < RUN_TICKS)
+    continue;
+  thread_get_cycles (info->cycles);
+  sema_up (&info->done);
+}
+
+/* Sleeps for RUN_TICKS timer ticks. */
+static void
+sleeper (void *info_) 
+{
+  struct cycles_info *info = info_;
+
+  timer_sleep (RUN_TICKS);
+  thread_get_cycles (info->cycles);
+  sema_up (&info->done);
+}
@@ -0,0 +1,20 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+my ($spin_kernel, $spin_intr, $sleep_kernel, $sleep_intr)
+  = check_expected_pattern (<<'EOF');
+(cpu-cycles) begin
+(cpu-cycles) spinner: {N} kernel cycles, {N} interrupt cycles.
+(cpu-cycles) sleeper: {N} kernel cycles, {N} interrupt cycles.
+(cpu-cycles) PASS
+(cpu-cycles) end
+EOF
+fail "Spinner used only $spin_kernel kernel cycles, "
+  . "sleeper $sleep_kernel.\n"
+  if $spin_kernel <= 0 || $spin_kernel < 10 * $sleep_kernel;
+
+# The spinner was running for most of the 20 timer interrupts
+# taken while it existed.
+fail "Spinner was charged no interrupt cycles.\n" if $spin_intr <= 0;
+pass;
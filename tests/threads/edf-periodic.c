@@ -0,0 +1,116 @@
+/* Runs three periodic EDF threads alongside two CPU-bound
+   threads of the highest priority and checks that no EDF thread
+   misses a deadline.
+
+   The EDF threads' utilizations add up to 65%, so admission
+   control should then refuse a 40% reservation for the main
+   thread and accept a 30% one.  Each EDF thread busy-waits for
+   two ticks less than its budget in every period, which leaves
+   room for the tick granularity of budget accounting, and then
+   waits for its next period.  EDF threads outrank every
+   priority, so the background load should not delay them. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+#define TASK_CNT 3              /* Number of EDF threads. */
+#define HOG_CNT 2               /* Number of background threads. */
+#define RUN_TICKS 400           /* Ticks that each EDF thread runs. */
+
+struct edf_task
+  {
+    int64_t period;             /* Period, in ticks. */
+    int64_t budget;             /* Budget per period, in ticks. */
+    unsigned misses;            /* Deadlines missed. */
+  };
+
+static struct edf_task tasks[TASK_CNT] = {{10, 3, 0}, {20, 4, 0}, {40, 6, 0}};
+static struct semaphore started, done;
+static volatile bool hog_stop;
+
+static thread_func edf_thread;
+static thread_func hog;
+
+void
+test_edf_periodic (void)
+{
+  int i;
+
+  /* This test does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+
+  sema_init (&started, 0);
+  sema_init (&done, 0);
+  hog_stop = false;
+
+  /* The main thread keeps the CPU while it sets up, then shares
+     it with the hogs. */
+  thread_set_priority (PRI_MAX);
+  for (i = 0; i < TASK_CNT; i++)
+    {
+      char name[16];
+      snprintf (name, sizeof name, "edf %d", i);
+      thread_create (name, PRI_DEFAULT, edf_thread, &tasks[i]);
+    }
+  for (i = 0; i < TASK_CNT; i++)
+    sema_down (&started);
+
+  if (thread_set_deadline (10, 4))
+    fail ("admitted 40%% more utilization on top of 65%%");
+  if (!thread_set_deadline (10, 3))
+    fail ("refused 30%% more utilization on top of 65%%");
+  thread_set_deadline (0, 0);
+  msg ("Admission control accepted 95%% and refused 105%%.");
+
+  for (i = 0; i < HOG_CNT; i++)
+    thread_create ("hog", PRI_MAX, hog, NULL);
+  for (i = 0; i < TASK_CNT; i++)
+    sema_down (&done);
+  hog_stop = true;
+
+  for (i = 0; i < TASK_CNT; i++)
+    {
+      msg ("EDF thread %d (period %lld, budget %lld): %u missed.",
+           i, tasks[i].period, tasks[i].budget, tasks[i].misses);
+      if (tasks[i].misses != 0)
+        fail ("EDF thread %d missed a deadline", i);
+    }
+  pass ();
+}
+
+/* Runs the periodic task described by TASK_ for RUN_TICKS
+   ticks. */
+static void
+edf_thread (void *task_)
+{
+  struct edf_task *task = task_;
+  int64_t work_ms = (task->budget - 2) * 1000 / TIMER_FREQ;
+  int i;
+
+  if (!thread_set_deadline (task->period, task->budget))
+    fail ("EDF thread with period %lld, budget %lld refused",
+          task->period, task->budget);
+  sema_up (&started);
+
+  for (i = 0; i < RUN_TICKS / task->period; i++)
+    {
+      timer_mdelay (work_ms);
+      thread_wait_period ();
+    }
+
+  task->misses = thread_deadline_misses ();
+  thread_set_deadline (0, 0);
+  sema_up (&done);
+}
+
+/* Spins until told to stop. */
+static void
+hog (void *aux UNUSED)
+{
+  while (!hog_stop)
+    continue;
+}
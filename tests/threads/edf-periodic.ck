@@ -0,0 +1,14 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(edf-periodic) begin
+(edf-periodic) Admission control accepted 95% and refused 105%.
+(edf-periodic) EDF thread 0 (period 10, budget 3): 0 missed.
+(edf-periodic) EDF thread 1 (period 20, budget 4): 0 missed.
+(edf-periodic) EDF thread 2 (period 40, budget 6): 0 missed.
+(edf-periodic) PASS
+(edf-periodic) end
+EOF
+pass;
@@ -0,0 +1,91 @@
+/* Reports the longest span with interrupts off while a burst of
+   sleeping threads wakes up, once with the wake-ups run as
+   deferred work and once with them run in the timer interrupt,
+   as the "-nodefer" kernel option does.
+
+   SLEEPER_CNT threads sleep until the same tick, so that the
+   timer interrupt finds them all due at once.  Run in the
+   interrupt handler, waking them keeps interrupts off for the
+   whole burst.  The deferred-work thread lets interrupts in
+   between small batches, so its longest span must be shorter.
+
+   Requires the "-introff" kernel option. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/defer.h"
+#include "threads/init.h"
+#include "threads/interrupt.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+#define SLEEPER_CNT 100         /* Number of threads woken at once. */
+
+static struct semaphore done;
+static int64_t wakeup;
+
+static uint64_t run (bool deferred);
+static thread_func sleeper;
+
+void
+test_intr_off_window (void) 
+{
+  uint64_t deferred, immediate;
+  bool saved = defer_enabled;
+
+  /* This test does not work with the MLFQS, whose once-a-second
+     work would also be timed. */
+  ASSERT (!thread_mlfqs);
+  ASSERT (intr_off_timing);
+
+  msg ("Waking %d sleepers at once, twice.", SLEEPER_CNT);
+  deferred = run (true);
+  immediate = run (false);
+  defer_enabled = saved;
+
+  msg ("Longest interrupts-off span: %llu cycles with deferred work, "
+       "%llu cycles with -nodefer.", deferred, immediate);
+  if (deferred >= immediate)
+    fail ("deferred wake-ups did not shorten the longest span");
+  pass ();
+}
+
+/* Puts SLEEPER_CNT threads to sleep until one tick, with
+   deferred work on if DEFERRED is true, waits for them all to
+   wake, and returns the longest span with interrupts off in the
+   meantime. */
+static uint64_t
+run (bool deferred) 
+{
+  int i;
+
+  /* Let anything already queued finish under the old setting. */
+  timer_sleep (1);
+  defer_enabled = deferred;
+
+  sema_init (&done, 0);
+  wakeup = timer_ticks () + 10;
+  for (i = 0; i < SLEEPER_CNT; i++) 
+    {
+      char name[16];
+      snprintf (name, sizeof name, "sleeper %d", i);
+      if (thread_create (name, PRI_DEFAULT, sleeper, NULL) == TID_ERROR)
+        fail ("could not create thread %d", i);
+    }
+
+  /* Time only the wake-ups, not the thread creation. */
+  timer_sleep (wakeup - timer_ticks () - 1);
+  intr_off_max_reset ();
+  for (i = 0; i < SLEEPER_CNT; i++)
+    sema_down (&done);
+  return intr_off_max_reset ();
+}
+
+/* Sleeper thread. */
+static void
+sleeper (void *aux UNUSED) 
+{
+  timer_sleep (wakeup - timer_ticks ());
+  sema_up (&done);
+}
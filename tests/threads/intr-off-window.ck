@@ -0,0 +1,15 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+my ($deferred, $immediate) = check_expected_pattern (IGNORE_EXIT_CODES => 1,
+						     <<'EOF');
+(intr-off-window) begin
+(intr-off-window) Waking 100 sleepers at once, twice.
+(intr-off-window) Longest interrupts-off span: {N} cycles with deferred work, {N} cycles with -nodefer.
+(intr-off-window) PASS
+(intr-off-window) end
+EOF
+fail "Interrupts-off spans were not measured.\n"
+  if $deferred <= 0 || $immediate <= 0;
+pass;
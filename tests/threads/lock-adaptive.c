@@ -0,0 +1,105 @@
+/* Checks that an adaptive lock lets its waiter avoid blocking
+   when the holder is ready to run and can finish its critical
+   section if given the CPU.
+
+   In each case a holder thread acquires the lock and is then
+   preempted or yields while still holding it, so that the main
+   thread finds the lock held by a ready thread.  A plain lock
+   must block the main thread.  An adaptive lock must instead
+   yield to the holder, which releases the lock, so the main
+   thread gets it without blocking.
+
+   The low-priority case only works because the main thread
+   donates its priority before yielding; otherwise the yield
+   would come straight back to the main thread. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+
+static struct semaphore held, done;
+static bool holder_yields;
+
+static long long acquire_blocks (bool adaptive, int priority);
+static thread_func holder_func;
+
+void
+test_lock_adaptive (void) 
+{
+  long long blocks;
+
+  /* This test does not work with the MLFQS or CFS, which do not
+     schedule strictly by priority. */
+  ASSERT (!thread_mlfqs && !thread_cfs);
+
+  blocks = acquire_blocks (false, PRI_DEFAULT);
+  msg ("Plain lock, equal-priority holder: %lld of 1 acquisitions blocked.",
+       blocks);
+  if (blocks != 1)
+    fail ("plain lock should have blocked once");
+
+  blocks = acquire_blocks (true, PRI_DEFAULT);
+  msg ("Adaptive lock, equal-priority holder: %lld of 1 acquisitions blocked.",
+       blocks);
+  if (blocks != 0)
+    fail ("adaptive lock should not have blocked");
+
+  blocks = acquire_blocks (true, PRI_DEFAULT - 10);
+  msg ("Adaptive lock, lower-priority holder: %lld of 1 acquisitions blocked.",
+       blocks);
+  if (blocks != 0)
+    fail ("adaptive lock should not have blocked");
+  pass ();
+}
+
+/* Has a thread with the given PRIORITY take a lock, adaptive if
+   ADAPTIVE is true, and then acquires the lock while that thread
+   is ready but not running.  Returns the number of times the
+   acquisition blocked. */
+static long long
+acquire_blocks (bool adaptive, int priority) 
+{
+  static struct lock lock;
+  long long blocks;
+
+  if (adaptive)
+    lock_init_adaptive (&lock);
+  else
+    lock_init (&lock);
+  sema_init (&held, 0);
+  sema_init (&done, 0);
+
+  /* A lower-priority holder is preempted as soon as it lets us
+     run.  An equal-priority holder has to yield. */
+  holder_yields = priority >= thread_get_priority ();
+  thread_create ("holder", priority, holder_func, &lock);
+  sema_down (&held);
+
+  lock_acquire (&lock);
+  if (lock.contentions != 1)
+    fail ("lock was not held when acquired");
+  blocks = lock.blocks;
+  lock_release (&lock);
+
+  sema_down (&done);
+  return blocks;
+}
+
+/* Takes the lock in LOCK_, lets the main thread run while still
+   holding it, and releases it once given the CPU again.  Yields
+   to do so if HOLDER_YIELDS is true. */
+static void
+holder_func (void *lock_) 
+{
+  struct lock *lock = lock_;
+
+  lock_acquire (lock);
+  sema_up (&held);
+  if (holder_yields)
+    thread_yield ();
+
+  lock_release (lock);
+  sema_up (&done);
+}
@@ -0,0 +1,13 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(lock-adaptive) begin
+(lock-adaptive) Plain lock, equal-priority holder: 1 of 1 acquisitions blocked.
+(lock-adaptive) Adaptive lock, equal-priority holder: 0 of 1 acquisitions blocked.
+(lock-adaptive) Adaptive lock, lower-priority holder: 0 of 1 acquisitions blocked.
+(lock-adaptive) PASS
+(lock-adaptive) end
+EOF
+pass;
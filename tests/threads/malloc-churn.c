@@ -0,0 +1,134 @@
+/* Measures malloc() and free() on allocation-heavy paths, with
+   and without the per-CPU magazines.
+
+   The first benchmark calls thread_status(), which mallocs the
+   string it returns, and frees the result, as thread listings
+   do.  The second keeps a working set of SLOT_CNT objects of the
+   sizes that the file system allocates for open inodes, files,
+   and directories, and repeatedly replaces a random one, as
+   inode_open() and inode_close() churn does.  It runs in
+   THREAD_CNT threads at once, so that they also compete for the
+   descriptors' locks.  The file system is not available in this
+   kernel, so the sizes stand in for it.
+
+   Each object is filled with a pattern when allocated and
+   checked before it is freed. */
+
+#include <random.h>
+#include <stdio.h>
+#include <string.h>
+#include "tests/threads/tests.h"
+#include "threads/cpu.h"
+#include "threads/init.h"
+#include "threads/malloc.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+
+#define STATUS_CNT 2000         /* thread_status() calls. */
+#define CHURN_CNT 2000          /* Replacements per churn thread. */
+#define SLOT_CNT 32             /* Objects per churn thread. */
+#define THREAD_CNT 4            /* Churn threads. */
+
+/* Object sizes for the churn benchmark. */
+static const size_t sizes[] = {24, 40, 64, 112, 200};
+
+static struct semaphore done;
+static uint64_t churn_cycles[THREAD_CNT];
+
+static uint64_t status_benchmark (void);
+static uint64_t churn_benchmark (void);
+static thread_func churn_thread;
+
+void
+test_malloc_churn (void)
+{
+  bool saved = malloc_magazines;
+  int round;
+
+  sema_init (&done, 0);
+  for (round = 0; round < 2; round++)
+    {
+      malloc_magazines = round == 0;
+      msg ("Magazines %s: thread_status() %llu cycles per call, "
+           "churn %llu cycles per replacement.",
+           malloc_magazines ? "on" : "off",
+           status_benchmark (), churn_benchmark ());
+    }
+  malloc_magazines = saved;
+  pass ();
+}
+
+/* Returns the average cycles to call thread_status() and free
+   its result. */
+static uint64_t
+status_benchmark (void)
+{
+  uint64_t start = rdtsc ();
+  int i;
+
+  for (i = 0; i < STATUS_CNT; i++)
+    {
+      char *s = thread_status (THREAD_READY);
+      if (s == NULL || strcmp (s, "THREAD_READY"))
+        fail ("thread_status() returned the wrong string");
+      free (s);
+    }
+  return (rdtsc () - start) / STATUS_CNT;
+}
+
+/* Runs the churn benchmark in THREAD_CNT threads and returns the
+   average cycles per replacement. */
+static uint64_t
+churn_benchmark (void)
+{
+  uint64_t total = 0;
+  int i;
+
+  for (i = 0; i < THREAD_CNT; i++)
+    thread_create ("churn", PRI_DEFAULT, churn_thread, &churn_cycles[i]);
+  for (i = 0; i < THREAD_CNT; i++)
+    sema_down (&done);
+  for (i = 0; i < THREAD_CNT; i++)
+    total += churn_cycles[i];
+  return total / (THREAD_CNT * CHURN_CNT);
+}
+
+/* Replaces random objects in a working set CHURN_CNT times and
+   stores the cycles spent in malloc() and free() in *CYCLES_. */
+static void
+churn_thread (void *cycles_)
+{
+  uint64_t *cycles = cycles_;
+  unsigned char *objs[SLOT_CNT];
+  size_t obj_sizes[SLOT_CNT];
+  int i;
+
+  memset (objs, 0, sizeof objs);
+  *cycles = 0;
+  for (i = 0; i < CHURN_CNT + SLOT_CNT; i++)
+    {
+      int slot = i < SLOT_CNT ? i : (int) (random_ulong () % SLOT_CNT);
+      size_t size = sizes[random_ulong () % (sizeof sizes / sizeof *sizes)];
+      uint64_t start;
+      size_t j;
+
+      if (objs[slot] != NULL)
+        for (j = 0; j < obj_sizes[slot]; j++)
+          if (objs[slot][j] != (unsigned char) slot)
+            fail ("object %d overwritten", slot);
+
+      start = rdtsc ();
+      free (objs[slot]);
+      objs[slot] = malloc (size);
+      if (i >= SLOT_CNT)
+        *cycles += rdtsc () - start;
+
+      if (objs[slot] == NULL)
+        fail ("out of memory");
+      obj_sizes[slot] = size;
+      memset (objs[slot], slot, size);
+    }
+  for (i = 0; i < SLOT_CNT; i++)
+    free (objs[i]);
+  sema_up (&done);
+}
@@ -0,0 +1,21 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+my ($on_status, $on_churn, $off_status, $off_churn)
+  = check_expected_pattern (<<'EOF');
+(malloc-churn) begin
+(malloc-churn) Magazines on: thread_status() {N} cycles per call, churn {N} cycles per replacement.
+(malloc-churn) Magazines off: thread_status() {N} cycles per call, churn {N} cycles per replacement.
+(malloc-churn) PASS
+(malloc-churn) end
+EOF
+fail "Costs must be positive.\n"
+  if grep ($_ <= 0, $on_status, $on_churn, $off_status, $off_churn);
+
+# Magazines should never make churn much slower, allowing for
+# timing noise.
+fail "Churn took $on_churn cycles with magazines, "
+  . "$off_churn without.\n"
+  if $on_churn > $off_churn * 3 / 2;
+pass;
@@ -0,0 +1,132 @@
+/* Reports malloc()'s internal fragmentation for a typical file
+   system workload, with the old power-of-2 size classes and with
+   the current ones, and checks that realloc() resizes blocks in
+   place where it can.
+
+   The workload allocates, in typical proportions, the objects
+   that the file system and its callers allocate: in-memory
+   inodes with their on-disk copy, sector-sized bounce buffers,
+   open files and directories, directory entries, and file names
+   and paths.  The file system is not available in this kernel,
+   so the sizes stand in for it.  The old figure rounds each size
+   up to a power of 2 of at least 16 bytes, as malloc() used to;
+   the new one is measured with malloc_usable_size(). */
+
+#include <stdio.h>
+#include <string.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/malloc.h"
+#include "threads/vaddr.h"
+
+/* One kind of object in the workload. */
+struct workload
+  {
+    const char *name;           /* What the object is. */
+    size_t size;                /* Size in bytes. */
+    int cnt;                    /* How many are allocated. */
+  };
+
+static const struct workload workload[] =
+  {
+    {"inode", 536, 16},
+    {"bounce buffer", 512, 4},
+    {"file", 12, 24},
+    {"dir", 8, 8},
+    {"dir entry", 20, 32},
+    {"file name", 15, 32},
+    {"path", 40, 16},
+    {"command line", 100, 4},
+  };
+#define WORKLOAD_CNT (sizeof workload / sizeof *workload)
+
+static void check_fragmentation (void);
+static void check_realloc (void);
+
+void
+test_malloc_classes (void)
+{
+  check_fragmentation ();
+  check_realloc ();
+  pass ();
+}
+
+/* Allocates the workload and reports its fragmentation. */
+static void
+check_fragmentation (void)
+{
+  static void *blocks[256];
+  size_t requested = 0, old_allocated = 0, new_allocated = 0;
+  size_t i, cnt = 0;
+  int j;
+
+  for (i = 0; i < WORKLOAD_CNT; i++)
+    for (j = 0; j < workload[i].cnt; j++)
+      {
+        size_t size = workload[i].size;
+        size_t old_size = 16;
+
+        ASSERT (cnt < sizeof blocks / sizeof *blocks);
+        blocks[cnt] = malloc (size);
+        if (blocks[cnt] == NULL)
+          fail ("out of memory");
+        while (old_size < size)
+          old_size *= 2;
+
+        requested += size;
+        old_allocated += old_size;
+        new_allocated += malloc_usable_size (blocks[cnt]);
+        cnt++;
+      }
+  for (i = 0; i < cnt; i++)
+    free (blocks[i]);
+
+  msg ("%zu bytes requested in %zu blocks.", requested, cnt);
+  msg ("Power-of-2 classes: %zu bytes allocated, %zu%% wasted.",
+       old_allocated, (old_allocated - requested) * 100 / old_allocated);
+  msg ("Current classes: %zu bytes allocated, %zu%% wasted.",
+       new_allocated, (new_allocated - requested) * 100 / new_allocated);
+  if (new_allocated > old_allocated)
+    fail ("current classes waste more than power-of-2 classes");
+}
+
+/* Checks that realloc() keeps blocks in place when the new size
+   is in the same class, or when a big block's neighbouring pages
+   are free, and that it preserves their contents. */
+static void
+check_realloc (void)
+{
+  char *p, *q;
+
+  /* Within a size class. */
+  p = malloc (500);
+  if (p == NULL)
+    fail ("out of memory");
+  memset (p, 'a', 500);
+  q = realloc (p, 400);
+  if (q != p)
+    fail ("realloc moved a block within its size class");
+  if (q[0] != 'a' || q[399] != 'a')
+    fail ("realloc lost the contents of a block");
+  free (q);
+
+  /* A big block of 3 pages is carved from a free 4-page block,
+     so it can grow into the fourth page and shrink again. */
+  p = malloc (2 * PGSIZE);
+  if (p == NULL)
+    fail ("out of memory");
+  memset (p, 'b', 2 * PGSIZE);
+  q = realloc (p, 3 * PGSIZE);
+  if (q != p)
+    fail ("realloc moved a big block with free pages after it");
+  if (malloc_usable_size (q) < 3 * PGSIZE)
+    fail ("realloc did not grow the big block");
+  memset (q + 2 * PGSIZE, 'c', PGSIZE);
+  p = realloc (q, 2 * PGSIZE);
+  if (p != q)
+    fail ("realloc moved a shrinking big block");
+  if (p[0] != 'b' || p[2 * PGSIZE - 1] != 'b')
+    fail ("realloc lost the contents of a big block");
+  free (p);
+  msg ("realloc resized blocks in place.");
+}
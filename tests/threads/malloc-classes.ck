@@ -0,0 +1,21 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+my ($allocated, $wasted) = check_expected_pattern (<<'EOF');
+(malloc-classes) begin
+(malloc-classes) 13136 bytes requested in 136 blocks.
+(malloc-classes) Power-of-2 classes: 22016 bytes allocated, 40% wasted.
+(malloc-classes) Current classes: {N} bytes allocated, {N}% wasted.
+(malloc-classes) realloc resized blocks in place.
+(malloc-classes) PASS
+(malloc-classes) end
+EOF
+fail "Current classes allocated $allocated bytes for 13136 requested.\n"
+  if $allocated < 13136;
+fail "Current classes allocated $allocated bytes, more than power-of-2 "
+  . "classes' 22016.\n"
+  if $allocated > 22016;
+fail "Waste of $allocated bytes for 13136 reported as $wasted%.\n"
+  if $wasted != int (($allocated - 13136) * 100 / $allocated);
+pass;
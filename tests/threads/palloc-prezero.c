@@ -0,0 +1,86 @@
+/* Checks that single-page PAL_ZERO requests are served from the
+   pool of pages that idle CPUs zero ahead of time, and compares
+   their cost with zeroing on the spot.
+
+   Each round sleeps so that the idle thread can refill the pool,
+   then allocates PAGE_CNT zeroed pages from the kernel pool, as
+   thread_create() and page-table growth do, timing each call.
+   Every page must be all zeros.  The pages are then dirtied and
+   freed, so that a later round that gets them back only sees
+   zeros if they were zeroed again.  The first ROUND_CNT rounds
+   must all be zero-pool hits; the last runs with pre-zeroing
+   off and must all be misses. */
+
+#include <stdio.h>
+#include <string.h>
+#include "tests/threads/tests.h"
+#include "threads/cpu.h"
+#include "threads/init.h"
+#include "threads/palloc.h"
+#include "threads/vaddr.h"
+#include "devices/timer.h"
+
+#define PAGE_CNT 12             /* Pages allocated per round. */
+#define ROUND_CNT 3             /* Rounds with pre-zeroing on. */
+
+static uint64_t zero_round (bool prezero);
+
+void
+test_palloc_prezero (void)
+{
+  bool saved = palloc_prezero;
+  uint64_t hit_cycles = 0, miss_cycles;
+  int round;
+
+  for (round = 0; round < ROUND_CNT; round++)
+    hit_cycles += zero_round (true);
+  miss_cycles = zero_round (false);
+  palloc_prezero = saved;
+
+  palloc_print_stats ();
+  msg ("Pre-zeroed: %llu cycles per page; zeroed on the spot: "
+       "%llu cycles per page.", hit_cycles / ROUND_CNT, miss_cycles);
+  pass ();
+}
+
+/* Runs one round with pre-zeroing set to PREZERO and returns the
+   average cycles per allocation. */
+static uint64_t
+zero_round (bool prezero)
+{
+  uint8_t *pages[PAGE_CNT];
+  unsigned long long hits, misses, new_hits, new_misses;
+  uint64_t cycles = 0;
+  int i;
+  size_t j;
+
+  palloc_prezero = prezero;
+  timer_sleep (10);
+
+  palloc_zero_stats (0, &hits, &misses);
+  for (i = 0; i < PAGE_CNT; i++)
+    {
+      uint64_t start = rdtsc ();
+      pages[i] = palloc_get_page (PAL_ZERO);
+      cycles += rdtsc () - start;
+      if (pages[i] == NULL)
+        fail ("out of memory");
+      for (j = 0; j < PGSIZE; j++)
+        if (pages[i][j] != 0)
+          fail ("byte %zu of page %d is not zero", j, i);
+    }
+  palloc_zero_stats (0, &new_hits, &new_misses);
+
+  for (i = 0; i < PAGE_CNT; i++)
+    {
+      memset (pages[i], 0x5a, PGSIZE);
+      palloc_free_page (pages[i]);
+    }
+
+  if (prezero && new_hits - hits != PAGE_CNT)
+    fail ("%llu of %d pages were pre-zeroed", new_hits - hits, PAGE_CNT);
+  if (!prezero && new_misses - misses != PAGE_CNT)
+    fail ("%llu of %d pages were zeroed on the spot",
+          new_misses - misses, PAGE_CNT);
+  return cycles / PAGE_CNT;
+}
@@ -0,0 +1,27 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+our ($test);
+my ($hit, $miss) = check_expected_pattern (<<'EOF');
+(palloc-prezero) begin
+{LINES}
+(palloc-prezero) Pre-zeroed: {N} cycles per page; zeroed on the spot: {N} cycles per page.
+(palloc-prezero) PASS
+(palloc-prezero) end
+EOF
+
+# A pre-zeroed page saves clearing 4 kB on the spot.
+fail "Pre-zeroed pages cost $hit cycles, zeroing on the spot $miss.\n"
+  if $hit <= 0 || $hit >= $miss;
+
+# The kernel pool's statistics must count at least this test's
+# 36 hits and 12 misses.
+my ($zero) = grep (/^Palloc kernel pool: \d+ pages pre-zeroed, /,
+		   get_core_output ("run", read_text_file ("$test.output")));
+fail "Missing kernel pool zeroing statistics.\n" if !defined $zero;
+my ($hits, $misses) = $zero =~ /, (\d+) zero hits, (\d+) zero misses$/
+  or fail "Malformed kernel pool statistics: $zero\n";
+fail "Kernel pool counted $hits zero hits and $misses misses.\n"
+  if $hits < 36 || $misses < 12;
+pass;
@@ -0,0 +1,165 @@
+/* Allocates and frees a random mix of page runs from the kernel
+   pool and compares the cost with the bitmap scan that palloc
+   used before it became a buddy allocator.
+
+   OP_CNT operations pick a random slot.  If the slot holds a
+   run, it is freed; otherwise a run of 1 page (three times in
+   four) or of 2 to MAX_RUN pages is allocated into it.  The same
+   sequence is then replayed against a bitmap with as many bits
+   as the kernel pool has free pages, using
+   bitmap_scan_and_flip() and bitmap_set_multiple() as palloc
+   used to.  Only the bitmap operations are timed in the second
+   run, so palloc_free_multiple()'s figures also include filling
+   the freed pages with a debugging pattern.
+
+   Every page of every run is tagged with its slot, and the tags
+   are checked when the run is freed, so that two runs that
+   overlap are caught.  Once everything has been freed, the pool
+   must have as many free pages as it started with. */
+
+#include <bitmap.h>
+#include <random.h>
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/cpu.h"
+#include "threads/init.h"
+#include "threads/palloc.h"
+#include "threads/vaddr.h"
+
+#define OP_CNT 4000             /* Number of operations. */
+#define SLOT_CNT 24             /* Number of slots for runs. */
+#define MAX_RUN 8               /* Largest run, in pages. */
+
+/* Cost of one kind of operation. */
+struct op_cost
+  {
+    uint64_t cycles;            /* Total cycles. */
+    uint64_t max;               /* Most cycles for one operation. */
+    unsigned cnt;               /* Number of operations. */
+  };
+
+static unsigned char op_slot[OP_CNT];
+static unsigned char op_size[OP_CNT];
+
+static void add_cost (struct op_cost *, uint64_t start);
+static void print_cost (const char *, const struct op_cost *);
+
+void
+test_palloc_stress (void)
+{
+  uint8_t *runs[SLOT_CNT];
+  size_t sizes[SLOT_CNT];
+  size_t idxs[SLOT_CNT];
+  struct op_cost alloc_cost = {0, 0, 0}, free_cost = {0, 0, 0};
+  struct op_cost scan_cost = {0, 0, 0}, clear_cost = {0, 0, 0};
+  size_t free_before = palloc_free_cnt (0);
+  struct bitmap *map;
+  unsigned failures = 0;
+  int i, slot;
+
+  random_init (0);
+  for (i = 0; i < OP_CNT; i++)
+    {
+      op_slot[i] = random_ulong () % SLOT_CNT;
+      op_size[i] = (random_ulong () % 4 != 0 ? 1
+                    : 2 + random_ulong () % (MAX_RUN - 1));
+    }
+
+  /* Buddy allocator. */
+  for (slot = 0; slot < SLOT_CNT; slot++)
+    runs[slot] = NULL;
+  for (i = 0; i < OP_CNT; i++)
+    {
+      uint64_t start;
+      size_t page;
+
+      slot = op_slot[i];
+      if (runs[slot] != NULL)
+        {
+          for (page = 0; page < sizes[slot]; page++)
+            if (runs[slot][page * PGSIZE] != slot)
+              fail ("run in slot %d overwritten", slot);
+          start = rdtsc ();
+          palloc_free_multiple (runs[slot], sizes[slot]);
+          add_cost (&free_cost, start);
+          runs[slot] = NULL;
+        }
+      else
+        {
+          sizes[slot] = op_size[i];
+          start = rdtsc ();
+          runs[slot] = palloc_get_multiple (0, sizes[slot]);
+          add_cost (&alloc_cost, start);
+          if (runs[slot] == NULL)
+            failures++;
+          else
+            for (page = 0; page < sizes[slot]; page++)
+              runs[slot][page * PGSIZE] = slot;
+        }
+    }
+  palloc_print_stats ();
+  for (slot = 0; slot < SLOT_CNT; slot++)
+    if (runs[slot] != NULL)
+      palloc_free_multiple (runs[slot], sizes[slot]);
+  if (palloc_free_cnt (0) != free_before)
+    fail ("%zu pages free before, %zu after",
+          free_before, palloc_free_cnt (0));
+  if (failures > 0)
+    fail ("%u allocations failed", failures);
+
+  /* Bitmap scan, as palloc used to do. */
+  map = bitmap_create (free_before);
+  if (map == NULL)
+    fail ("out of memory for bitmap");
+  for (slot = 0; slot < SLOT_CNT; slot++)
+    idxs[slot] = BITMAP_ERROR;
+  for (i = 0; i < OP_CNT; i++)
+    {
+      uint64_t start;
+
+      slot = op_slot[i];
+      if (idxs[slot] != BITMAP_ERROR)
+        {
+          start = rdtsc ();
+          bitmap_set_multiple (map, idxs[slot], sizes[slot], false);
+          add_cost (&clear_cost, start);
+          idxs[slot] = BITMAP_ERROR;
+        }
+      else
+        {
+          sizes[slot] = op_size[i];
+          start = rdtsc ();
+          idxs[slot] = bitmap_scan_and_flip (map, 0, sizes[slot], false);
+          add_cost (&scan_cost, start);
+        }
+    }
+  bitmap_destroy (map);
+
+  print_cost ("buddy allocate", &alloc_cost);
+  print_cost ("buddy free", &free_cost);
+  print_cost ("bitmap scan", &scan_cost);
+  print_cost ("bitmap clear", &clear_cost);
+  pass ();
+}
+
+/* Charges COST for an operation that started at time-stamp
+   counter value START. */
+static void
+add_cost (struct op_cost *cost, uint64_t start)
+{
+  uint64_t cycles = rdtsc () - start;
+
+  cost->cycles += cycles;
+  if (cycles > cost->max)
+    cost->max = cycles;
+  cost->cnt++;
+}
+
+/* Prints COST, labeled NAME. */
+static void
+print_cost (const char *name, const struct op_cost *cost)
+{
+  msg ("%s: %u operations, %llu cycles average, %llu max.",
+       name, cost->cnt, cost->cnt > 0 ? cost->cycles / cost->cnt : 0,
+       cost->max);
+}
@@ -0,0 +1,47 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+our ($test);
+my (@v) = check_expected_pattern (<<'EOF');
+(palloc-stress) begin
+{LINES}
+(palloc-stress) buddy allocate: {N} operations, {N} cycles average, {N} max.
+(palloc-stress) buddy free: {N} operations, {N} cycles average, {N} max.
+(palloc-stress) bitmap scan: {N} operations, {N} cycles average, {N} max.
+(palloc-stress) bitmap clear: {N} operations, {N} cycles average, {N} max.
+(palloc-stress) PASS
+(palloc-stress) end
+EOF
+my (@names) = ("buddy allocate", "buddy free", "bitmap scan", "bitmap clear");
+my (@cnt) = @v[0, 3, 6, 9];
+
+# Both allocators replay the same 4000 operations.
+fail "Buddy allocator ran $cnt[0] + $cnt[1] operations, not 4000.\n"
+  if $cnt[0] + $cnt[1] != 4000;
+fail "Bitmap allocator ran $cnt[2] + $cnt[3] operations, not 4000.\n"
+  if $cnt[2] + $cnt[3] != 4000;
+foreach my $i (0...3) {
+    my ($avg, $max) = @v[$i * 3 + 1, $i * 3 + 2];
+    fail "$names[$i]: average $avg cycles, max $max.\n"
+      unless 0 < $avg && $avg <= $max;
+}
+
+# The statistics printed in between: two lines per pool.
+my (@stats) = grep (!/^\(palloc-stress\) /,
+		    get_core_output ("run", read_text_file ("$test.output")));
+fail "Expected 4 lines of pool statistics, got " . scalar (@stats) . ".\n"
+  if @stats != 4;
+foreach my $pool ("kernel", "user") {
+    my ($free) = shift (@stats);
+    my ($zero) = shift (@stats);
+    my ($pct) = $free =~ /^Palloc\ $pool\ pool:\ \d+\ of\ \d+\ pages\ free,
+			  \ blocks\ by\ order:(?:\ \d+:\d+)*,
+			  \ (\d+)%\ fragmented$/x
+      or fail "Malformed $pool pool statistics: $free\n";
+    fail "$pool pool is $pct% fragmented.\n" if $pct > 100;
+    $zero =~ /^Palloc\ $pool\ pool:\ \d+\ pages\ pre-zeroed,
+	      \ \d+\ zero\ hits,\ \d+\ zero\ misses$/x
+      or fail "Malformed $pool pool statistics: $zero\n";
+}
+pass;
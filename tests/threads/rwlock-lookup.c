@@ -0,0 +1,197 @@
+/* Measures lookup throughput in a read-mostly table, first with
+   the table guarded by a lock and then by a reader-writer lock,
+   and checks that the reader-writer lock does better.
+
+   Several reader threads look up entries in the table while one
+   writer occasionally updates them.  Some lookups "miss" and
+   sleep for a tick with the table held, much as a directory
+   lookup waits for a disk read.  Under a lock those waits
+   serialize; under a reader-writer lock readers wait in
+   parallel.
+
+   Readers also verify that they never see a half-done update,
+   which would mean that the writer was not excluded.
+
+   The table is synthetic.  It stands in for the directories and
+   the open inode list that dir_lookup() and inode_open() search,
+   since this kernel has no file system, so the figures show the
+   locks' behavior, not that of the file system paths. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/interrupt.h"
+#include "threads/malloc.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+#define READER_CNT 8            /* Number of reader threads. */
+#define ENTRY_CNT 64            /* Number of table entries. */
+#define MISS_INTERVAL 4         /* Every Nth lookup misses. */
+#define RUN_TICKS 200           /* Length of each run. */
+
+/* A table entry.  An update changes both fields, which must
+   always be seen to match. */
+struct entry
+  {
+    int key;
+    int check;
+  };
+
+/* Information about one run. */
+struct lookup_test 
+  {
+    bool use_rwlock;            /* Which of the following to use. */
+    struct lock lock;
+    struct rwlock rwlock;
+    struct entry table[ENTRY_CNT];
+    int64_t deadline;           /* Tick at which threads stop. */
+    long long lookups;          /* Lookups completed by all readers. */
+    int torn_cnt;               /* Half-done updates seen. */
+    struct semaphore done;      /* Upped by each thread. */
+  };
+
+static long long run (bool use_rwlock);
+static void reader (void *);
+static void writer (void *);
+static void read_begin (struct lookup_test *);
+static void read_end (struct lookup_test *);
+
+void
+test_rwlock_lookup (void) 
+{
+  long long lock_lookups, rwlock_lookups;
+
+  /* This test does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+
+  msg ("Running %d readers for %d ticks under each lock.",
+       READER_CNT, RUN_TICKS);
+  lock_lookups = run (false);
+  rwlock_lookups = run (true);
+
+  msg ("lock: %lld lookups per second.",
+       lock_lookups * TIMER_FREQ / RUN_TICKS);
+  msg ("rwlock: %lld lookups per second.",
+       rwlock_lookups * TIMER_FREQ / RUN_TICKS);
+  if (rwlock_lookups <= lock_lookups)
+    fail ("reader-writer lock did not improve lookup throughput");
+  pass ();
+}
+
+/* Runs one round of lookups, with the table guarded by a lock or
+   a reader-writer lock as USE_RWLOCK says, and returns the number
+   of lookups completed. */
+static long long
+run (bool use_rwlock) 
+{
+  struct lookup_test *test = malloc (sizeof *test);
+  long long lookups;
+  int i;
+
+  if (test == NULL)
+    fail ("out of memory");
+  test->use_rwlock = use_rwlock;
+  lock_init (&test->lock);
+  rwlock_init (&test->rwlock);
+  for (i = 0; i < ENTRY_CNT; i++)
+    test->table[i].key = test->table[i].check = i;
+  test->deadline = timer_ticks () + RUN_TICKS;
+  test->lookups = 0;
+  test->torn_cnt = 0;
+  sema_init (&test->done, 0);
+
+  for (i = 0; i < READER_CNT; i++)
+    thread_create ("reader", PRI_DEFAULT, reader, test);
+  thread_create ("writer", PRI_DEFAULT, writer, test);
+  for (i = 0; i < READER_CNT + 1; i++)
+    sema_down (&test->done);
+
+  if (test->torn_cnt != 0)
+    fail ("readers saw %d half-done updates", test->torn_cnt);
+  lookups = test->lookups;
+  free (test);
+  return lookups;
+}
+
+/* Reader thread. */
+static void
+reader (void *test_) 
+{
+  struct lookup_test *test = test_;
+  enum intr_level old_level;
+  long long lookups = 0;
+  int i = 0;
+
+  while (timer_ticks () < test->deadline)
+    {
+      struct entry *e = &test->table[i++ % ENTRY_CNT];
+
+      read_begin (test);
+      if (i % MISS_INTERVAL == 0)
+        timer_sleep (1);
+      if (e->key != e->check)
+        {
+          old_level = intr_disable ();
+          test->torn_cnt++;
+          intr_set_level (old_level);
+        }
+      read_end (test);
+      lookups++;
+    }
+
+  old_level = intr_disable ();
+  test->lookups += lookups;
+  intr_set_level (old_level);
+  sema_up (&test->done);
+}
+
+/* Writer thread.  Updates one entry every few ticks, yielding
+   halfway through each update. */
+static void
+writer (void *test_) 
+{
+  struct lookup_test *test = test_;
+  int i = 0;
+
+  while (timer_ticks () < test->deadline)
+    {
+      struct entry *e = &test->table[i++ % ENTRY_CNT];
+
+      if (test->use_rwlock)
+        rwlock_write_acquire (&test->rwlock);
+      else
+        lock_acquire (&test->lock);
+      e->key++;
+      thread_yield ();
+      e->check++;
+      if (test->use_rwlock)
+        rwlock_write_release (&test->rwlock);
+      else
+        lock_release (&test->lock);
+
+      timer_sleep (5);
+    }
+  sema_up (&test->done);
+}
+
+/* Enters a read-side critical section for TEST's table. */
+static void
+read_begin (struct lookup_test *test) 
+{
+  if (test->use_rwlock)
+    rwlock_read_acquire (&test->rwlock);
+  else
+    lock_acquire (&test->lock);
+}
+
+/* Leaves a read-side critical section for TEST's table. */
+static void
+read_end (struct lookup_test *test) 
+{
+  if (test->use_rwlock)
+    rwlock_read_release (&test->rwlock);
+  else
+    lock_release (&test->lock);
+}
@@ -0,0 +1,17 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+my ($lock, $rwlock) = check_expected_pattern (<<'EOF');
+(rwlock-lookup) begin
+(rwlock-lookup) Running 8 readers for 200 ticks under each lock.
+(rwlock-lookup) lock: {N} lookups per second.
+(rwlock-lookup) rwlock: {N} lookups per second.
+(rwlock-lookup) PASS
+(rwlock-lookup) end
+EOF
+fail "Readers made no progress under the lock.\n" if $lock <= 0;
+fail "Reader-writer lock managed $rwlock lookups per second, "
+  . "not more than the lock's $lock.\n"
+  if $rwlock <= $lock;
+pass;
@@ -0,0 +1,9 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+use tests::threads::sched_fair;
+
+# The interactive thread's small virtual runtime lets it preempt
+# the batch threads, so it should run within a tick of waking.
+check_sched_fair (950, 10000);
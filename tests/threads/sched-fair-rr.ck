@@ -0,0 +1,9 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+use tests::threads::sched_fair;
+
+# Round robin makes a woken thread wait behind the batch threads
+# for the rest of their time slices, so its delay is not bounded.
+check_sched_fair (900, undef);
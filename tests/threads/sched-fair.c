@@ -0,0 +1,190 @@
+/* Compares the fairness of the three schedulers.  The same
+   workload runs as sched-fair-rr under the default round-robin
+   scheduler, as sched-fair-mlfqs under the MLFQS, and as
+   sched-fair-cfs under the completely fair scheduler.
+
+   In the first phase, BATCH_CNT CPU-bound threads with nice 0
+   spin for PHASE_TICKS ticks.  Each thread's share of the CPU
+   cycles they used is printed, along with Jain's fairness index,
+   (sum x)^2 / (n * sum x^2), which is 1.000 when every share is
+   equal and 1/n when one thread gets everything.
+
+   In the second phase, two CPU-bound threads compete with an
+   interactive thread that sleeps for one tick, then computes for
+   about a millisecond, INTERACTIVE_ITERS times.  The delay from
+   each waking timer interrupt to the interactive thread running
+   is printed.  A fair scheduler should run it promptly, even
+   though it never gives up its share voluntarily to the batch
+   threads.
+
+   The numbers are informational; the test fails only if some
+   thread is starved outright. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+#define BATCH_CNT 4             /* CPU-bound threads in phase 1. */
+#define PHASE_TICKS (3 * TIMER_FREQ)    /* Length of phase 1. */
+#define INTERACTIVE_ITERS 100   /* Wake-ups in phase 2. */
+
+/* A CPU-bound thread. */
+struct batch_info
+  {
+    int64_t start;              /* Tick to start spinning. */
+    volatile bool *stop;        /* Set to stop spinning. */
+    uint64_t cycles;            /* Kernel cycles used. */
+    struct semaphore *done;     /* Upped on exit. */
+  };
+
+/* The interactive thread. */
+struct interactive_info
+  {
+    int64_t start;              /* Tick to start. */
+    int64_t max_delay;          /* Longest wake-up delay, in ns. */
+    int64_t total_delay;        /* Sum of wake-up delays, in ns. */
+    struct semaphore *done;     /* Upped on exit. */
+  };
+
+static void test_sched_fair (void);
+static void batch_thread (void *);
+static void interactive_thread (void *);
+
+void
+test_sched_fair_rr (void) 
+{
+  ASSERT (!thread_mlfqs && !thread_cfs);
+  test_sched_fair ();
+}
+
+void
+test_sched_fair_mlfqs (void) 
+{
+  ASSERT (thread_mlfqs);
+  test_sched_fair ();
+}
+
+void
+test_sched_fair_cfs (void) 
+{
+  ASSERT (thread_cfs);
+  test_sched_fair ();
+}
+
+static void
+test_sched_fair (void) 
+{
+  struct batch_info batch[BATCH_CNT];
+  struct interactive_info inter;
+  struct semaphore done;
+  volatile bool stop;
+  uint64_t sum = 0, sum_sq = 0;
+  int i;
+
+  /* Make sure the main thread gets to run when it wakes up. */
+  thread_set_priority (PRI_MAX);
+  thread_set_nice (NICE_MIN);
+  sema_init (&done, 0);
+
+  msg ("Phase 1: %d CPU-bound threads for %d ticks.",
+       BATCH_CNT, PHASE_TICKS);
+  stop = false;
+  for (i = 0; i < BATCH_CNT; i++) 
+    {
+      batch[i].start = timer_ticks () + 10;
+      batch[i].stop = &stop;
+      batch[i].done = &done;
+      thread_create ("batch", PRI_DEFAULT, batch_thread, &batch[i]);
+    }
+  timer_sleep (batch[BATCH_CNT - 1].start + PHASE_TICKS - timer_ticks ());
+  stop = true;
+  for (i = 0; i < BATCH_CNT; i++)
+    sema_down (&done);
+
+  /* Scale down to thousands of cycles, so that the sum of
+     squares cannot overflow. */
+  for (i = 0; i < BATCH_CNT; i++) 
+    {
+      uint64_t x = batch[i].cycles / 1000;
+      sum += x;
+      sum_sq += x * x;
+    }
+  for (i = 0; i < BATCH_CNT; i++) 
+    {
+      if (batch[i].cycles / 1000 == 0)
+        fail ("batch thread %d was starved", i);
+      msg ("Batch thread %d: %llu.%llu%% of cycles.", i,
+           batch[i].cycles / 1000 * 100 / sum,
+           batch[i].cycles / 1000 * 1000 / sum % 10);
+    }
+  msg ("Fairness index: %llu/1000.", sum * sum * 1000 / (BATCH_CNT * sum_sq));
+
+  msg ("Phase 2: interactive thread against 2 CPU-bound threads.");
+  stop = false;
+  for (i = 0; i < 2; i++) 
+    {
+      batch[i].start = timer_ticks () + 10;
+      batch[i].stop = &stop;
+      batch[i].done = &done;
+      thread_create ("batch", PRI_DEFAULT, batch_thread, &batch[i]);
+    }
+  inter.start = batch[1].start;
+  inter.done = &done;
+  thread_create ("interactive", PRI_DEFAULT, interactive_thread, &inter);
+  sema_down (&done);
+  stop = true;
+  for (i = 0; i < 2; i++)
+    sema_down (&done);
+
+  msg ("Interactive wake-up delay: avg %lld us, max %lld us.",
+       inter.total_delay / INTERACTIVE_ITERS / 1000,
+       inter.max_delay / 1000);
+  pass ();
+}
+
+/* Spins from INFO->start until told to stop, then records the
+   cycles it used. */
+static void
+batch_thread (void *info_) 
+{
+  struct batch_info *info = info_;
+  uint64_t cycles[CPU_MODE_CNT];
+
+  thread_set_nice (0);
+  timer_sleep (info->start - timer_ticks ());
+  thread_get_cycles (cycles);
+  info->cycles = cycles[CPU_MODE_KERNEL];
+  while (!*info->stop)
+    continue;
+  thread_get_cycles (cycles);
+  info->cycles = cycles[CPU_MODE_KERNEL] - info->cycles;
+  sema_up (info->done);
+}
+
+/* Sleeps for a tick and then computes briefly, over and over,
+   recording how long each wake-up took. */
+static void
+interactive_thread (void *info_) 
+{
+  struct interactive_info *info = info_;
+  int i;
+
+  thread_set_nice (0);
+  timer_sleep (info->start - timer_ticks ());
+  info->max_delay = info->total_delay = 0;
+  for (i = 0; i < INTERACTIVE_ITERS; i++) 
+    {
+      int64_t delay;
+
+      timer_sleep (1);
+      delay = timer_now_ns () - timer_last_interrupt_ns ();
+      info->total_delay += delay;
+      if (delay > info->max_delay)
+        info->max_delay = delay;
+      timer_udelay (1000);
+    }
+  sema_up (info->done);
+}
@@ -0,0 +1,47 @@
+# -*- perl -*-
+use strict;
+use warnings;
+
+# Checks the output of one of the sched-fair tests.  Fails unless
+# the batch threads' shares add up to 100% and Jain's fairness
+# index is at least MIN_FAIRNESS/1000, or, if MAX_DELAY is
+# defined, the interactive thread's average wake-up delay exceeds
+# MAX_DELAY microseconds.
+sub check_sched_fair {
+    my ($min_fairness, $max_delay) = @_;
+    our ($test);
+    my ($name) = $test =~ m%([^/]+)$%;
+
+    my ($expected) = <<EOF;
+($name) begin
+($name) Phase 1: 4 CPU-bound threads for 300 ticks.
+EOF
+    $expected .= "($name) Batch thread $_: {N}.{N}% of cycles.\n"
+      foreach 0...3;
+    $expected .= <<EOF;
+($name) Fairness index: {N}/1000.
+($name) Phase 2: interactive thread against 2 CPU-bound threads.
+($name) Interactive wake-up delay: avg {N} us, max {N} us.
+($name) PASS
+($name) end
+EOF
+    my (@v) = check_expected_pattern ($expected);
+    my ($fairness, $avg_delay, $max) = @v[8, 9, 10];
+
+    # Each share is rounded down to a tenth of a percent.
+    my ($total) = 0;
+    $total += $v[$_ * 2] * 10 + $v[$_ * 2 + 1] foreach 0...3;
+    fail "Batch threads' shares add up to " . $total / 10 . "%.\n"
+      if $total < 996 || $total > 1000;
+
+    fail "Fairness index is only $fairness/1000.\n"
+      if $fairness < $min_fairness || $fairness > 1000;
+    fail "Interactive wake-up delays avg $avg_delay us, max $max us, "
+      . "are out of order.\n"
+      unless 0 <= $avg_delay && $avg_delay <= $max;
+    fail "Interactive thread waited $avg_delay us per wake-up on average.\n"
+      if defined $max_delay && $avg_delay > $max_delay;
+    pass;
+}
+
+1;
@@ -0,0 +1,89 @@
+/* Checks the slab allocator's object caches.
+
+   Allocates OBJ_CNT objects from a cache whose constructor
+   counts its calls and marks each object, then frees them all
+   and allocates them again.  Every object must come back
+   constructed and distinct, and slabs must start their objects
+   at different colour offsets.  The constructor runs again in
+   later rounds only for slabs that were given back to the page
+   allocator when they became empty. */
+
+#include <stdio.h>
+#include <string.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/slab.h"
+#include "threads/vaddr.h"
+
+#define OBJ_CNT 200             /* Objects allocated at once. */
+#define ROUND_CNT 3             /* Times all objects are reallocated. */
+#define OBJ_MAGIC 0x5eedf00d    /* Marks a constructed object. */
+
+/* A test object. */
+struct obj
+  {
+    unsigned magic;             /* Set to OBJ_MAGIC when constructed. */
+    int owner;                  /* Index in the test's array, or -1. */
+    char pad[104];              /* Leaves room for colouring. */
+  };
+
+static unsigned ctor_cnt;
+static kmem_ctor_func obj_ctor;
+
+void
+test_slab_cache (void)
+{
+  static struct obj *objs[OBJ_CNT];
+  struct kmem_cache *cache;
+  unsigned ctors_after_first = 0;
+  bool colored = false;
+  int round, i;
+
+  cache = kmem_cache_create ("slab-test", sizeof (struct obj), obj_ctor);
+  for (round = 0; round < ROUND_CNT; round++)
+    {
+      for (i = 0; i < OBJ_CNT; i++)
+        {
+          objs[i] = kmem_cache_alloc (cache);
+          if (objs[i] == NULL)
+            fail ("out of memory");
+          if (objs[i]->magic != OBJ_MAGIC || objs[i]->owner != -1)
+            fail ("object %d was not in its constructed state", i);
+          objs[i]->owner = i;
+          if (pg_ofs (objs[i]) % sizeof *objs[i]
+              != pg_ofs (objs[0]) % sizeof *objs[0])
+            colored = true;
+        }
+      for (i = 0; i < OBJ_CNT; i++)
+        if (objs[i]->owner != i)
+          fail ("object %d was handed out twice", i);
+      if (round == 0)
+        ctors_after_first = ctor_cnt;
+      for (i = 0; i < OBJ_CNT; i++)
+        {
+          objs[i]->owner = -1;
+          kmem_cache_free (cache, objs[i]);
+        }
+    }
+
+  kmem_cache_print_stats ();
+  if (ctor_cnt < OBJ_CNT)
+    fail ("constructor ran %u times for %d objects", ctor_cnt, OBJ_CNT);
+  if (!colored)
+    fail ("all slabs use the same colour");
+  msg ("Constructor ran %u times for %d objects in %d rounds; "
+       "%u times after the first round.",
+       ctor_cnt, OBJ_CNT, ROUND_CNT, ctor_cnt - ctors_after_first);
+  pass ();
+}
+
+/* Constructs test object OBJ_. */
+static void
+obj_ctor (void *obj_)
+{
+  struct obj *obj = obj_;
+
+  obj->magic = OBJ_MAGIC;
+  obj->owner = -1;
+  ctor_cnt++;
+}
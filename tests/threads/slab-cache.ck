@@ -0,0 +1,29 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+my ($size, $per_slab, $slabs, $in_use, $peak, $allocs, $grows,
+    $ctors, $late_ctors) = check_expected_pattern (<<'EOF');
+(slab-cache) begin
+Slab slab-test: {N}-byte objects, {N} per slab, {N} slabs, {N} in use (peak {N}), {N} allocations, {N} grows
+(slab-cache) Constructor ran {N} times for 200 objects in 3 rounds; {N} times after the first round.
+(slab-cache) PASS
+(slab-cache) end
+EOF
+fail "Slabs hold $per_slab objects.\n" if $per_slab <= 0;
+fail "$in_use objects in use (peak $peak) after freeing all 200.\n"
+  if $in_use != 0 || $peak != 200;
+fail "Cache counted $allocs allocations, not 600.\n" if $allocs != 600;
+
+# Only one empty slab is kept once every object is freed.
+fail "Cache kept $slabs slabs with no objects in use.\n" if $slabs != 1;
+
+# Objects are constructed once, when their slab is created.  The
+# first round needs just enough slabs for 200 objects.
+my ($first_slabs) = int ((200 + $per_slab - 1) / $per_slab);
+fail "Constructor ran $ctors times for $grows slabs of $per_slab.\n"
+  if $ctors != $grows * $per_slab;
+fail "Constructor ran " . ($ctors - $late_ctors) . " times in the first "
+  . "round, for $first_slabs slabs of $per_slab.\n"
+  if $ctors - $late_ctors != $first_slabs * $per_slab;
+pass;
@@ -0,0 +1,142 @@
+/* Measures how much faster CPU-bound work finishes when it is
+   spread over every CPU than when one CPU does it all.
+
+   A job multiplies two DIM x DIM matrices REPS times, like the
+   matmult example program, in memory of its own, and records a
+   checksum of the product.  First a single worker does one job
+   per CPU, one after another; then one worker per CPU does a job
+   each, in parallel.  The elapsed times of the two rounds are
+   compared, and every job must come up with the same checksum.
+
+   On a uniprocessor there is nothing to spread the work over, so
+   the test fails there rather than pass without testing
+   anything. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/cpu.h"
+#include "threads/init.h"
+#include "threads/malloc.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+#define DIM 64                  /* Matrix dimension. */
+#define REPS 40                 /* Multiplications per job. */
+
+/* A worker thread. */
+struct worker
+  {
+    int job_cnt;                /* Number of jobs to do. */
+    int *checksums;             /* One per job. */
+    struct semaphore *done;     /* Upped when all jobs are done. */
+  };
+
+static struct worker workers[CPU_MAX];
+static int checksums[CPU_MAX];
+
+static int64_t run_round (int worker_cnt, int jobs_per_worker);
+static thread_func worker_func;
+static int matmult (void);
+
+void
+test_smp_speedup (void) 
+{
+  int64_t serial_ns, parallel_ns, speedup;
+  unsigned i;
+
+  if (cpu_cnt < 2)
+    fail ("needs at least 2 CPUs, but only %u are running", cpu_cnt);
+
+  serial_ns = run_round (1, cpu_cnt);
+  msg ("%u jobs on 1 CPU: %lld us.", cpu_cnt, serial_ns / 1000);
+  parallel_ns = run_round (cpu_cnt, 1);
+  msg ("%u jobs on %u CPUs: %lld us.", cpu_cnt, cpu_cnt,
+       parallel_ns / 1000);
+
+  for (i = 1; i < cpu_cnt; i++)
+    if (checksums[i] != checksums[0])
+      fail ("job %u computed checksum %d, not %d",
+            i, checksums[i], checksums[0]);
+
+  speedup = serial_ns * 100 / (parallel_ns > 0 ? parallel_ns : 1);
+  msg ("Speedup: %lld.%02lld on %u CPUs.",
+       speedup / 100, speedup % 100, cpu_cnt);
+  pass ();
+}
+
+/* Starts WORKER_CNT workers that do JOBS_PER_WORKER jobs each,
+   waits for them to finish, and returns the time that took, in
+   nanoseconds.  The jobs' checksums go into checksums[]. */
+static int64_t
+run_round (int worker_cnt, int jobs_per_worker) 
+{
+  struct semaphore done;
+  int64_t start;
+  int i;
+
+  sema_init (&done, 0);
+  start = timer_now_ns ();
+  for (i = 0; i < worker_cnt; i++)
+    {
+      struct worker *w = &workers[i];
+      char name[16];
+
+      w->job_cnt = jobs_per_worker;
+      w->checksums = &checksums[i * jobs_per_worker];
+      w->done = &done;
+      snprintf (name, sizeof name, "matmult %d", i);
+      if (thread_create (name, PRI_DEFAULT, worker_func, w) == TID_ERROR)
+        fail ("could not create thread %d", i);
+    }
+  for (i = 0; i < worker_cnt; i++)
+    sema_down (&done);
+  return timer_now_ns () - start;
+}
+
+/* Worker thread. */
+static void
+worker_func (void *w_) 
+{
+  struct worker *w = w_;
+  int i;
+
+  for (i = 0; i < w->job_cnt; i++)
+    w->checksums[i] = matmult ();
+  sema_up (w->done);
+}
+
+/* Does one job and returns its checksum. */
+static int
+matmult (void) 
+{
+  int (*a)[DIM] = malloc (sizeof (int[DIM][DIM]));
+  int (*b)[DIM] = malloc (sizeof (int[DIM][DIM]));
+  int (*c)[DIM] = malloc (sizeof (int[DIM][DIM]));
+  int checksum = 0;
+  int i, j, k, rep;
+
+  if (a == NULL || b == NULL || c == NULL)
+    fail ("out of memory");
+
+  for (rep = 0; rep < REPS; rep++)
+    {
+      for (i = 0; i < DIM; i++)
+        for (j = 0; j < DIM; j++)
+          {
+            a[i][j] = i + rep;
+            b[i][j] = j;
+            c[i][j] = 0;
+          }
+      for (i = 0; i < DIM; i++)
+        for (j = 0; j < DIM; j++)
+          for (k = 0; k < DIM; k++)
+            c[i][j] += a[i][k] * b[k][j];
+      checksum += c[DIM - 1][DIM - 1];
+    }
+
+  free (a);
+  free (b);
+  free (c);
+  return checksum;
+}
@@ -0,0 +1,23 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+my ($jobs, $serial_us, $jobs2, $cpu_cnt, $parallel_us,
+    $whole, $frac, $cpu_cnt2) = check_expected_pattern (<<'EOF');
+(smp-speedup) begin
+(smp-speedup) {N} jobs on 1 CPU: {N} us.
+(smp-speedup) {N} jobs on {N} CPUs: {N} us.
+(smp-speedup) Speedup: {N}.{N} on {N} CPUs.
+(smp-speedup) PASS
+(smp-speedup) end
+EOF
+fail "Expected one job per CPU.\n"
+  if $jobs != $cpu_cnt || $jobs2 != $cpu_cnt || $cpu_cnt2 != $cpu_cnt;
+
+# The jobs share no data, so spreading them over the CPUs should
+# make them finish at least half as many times faster as there
+# are CPUs.
+my ($speedup) = $whole + $frac / 100;
+fail "Speedup of $speedup on $cpu_cnt CPUs is below " . $cpu_cnt / 2 . ".\n"
+  if $speedup < $cpu_cnt / 2;
+pass;
@@ -0,0 +1,15 @@
+/* Runs the context-switch benchmarks from
+   threads/switch-bench.c.  In this kernel, without user
+   programs, only switches between kernel threads are measured;
+   tests/userprog/kernel/switch-bench covers the others. */
+
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/switch-bench.h"
+
+void
+test_switch_bench (void) 
+{
+  switch_bench ();
+  pass ();
+}
@@ -0,0 +1,13 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+my ($cycles) = check_expected_pattern (<<'EOF');
+(switch-bench) begin
+Context switch benchmarks (1000 round trips each):
+  kernel to kernel: {N} cycles per switch
+(switch-bench) PASS
+(switch-bench) end
+EOF
+fail "Switch took $cycles cycles.\n" if $cycles <= 0;
+pass;
@@ -17,6 +17,7 @@ static const struct test tests[] =
     {"alarm-priority", test_alarm_priority},
     {"alarm-zero", test_alarm_zero},
     {"alarm-negative", test_alarm_negative},
+    {"alarm-sleepers", test_alarm_sleepers},
     {"priority-change", test_priority_change},
     {"priority-donate-one", test_priority_donate_one},
     {"priority-donate-multiple", test_priority_donate_multiple},
@@ -29,6 +30,26 @@ static const struct test tests[] =
     {"priority-preempt", test_priority_preempt},
     {"priority-sema", test_priority_sema},
     {"priority-condvar", test_priority_condvar},
+    {"balance-converge", test_balance_converge},
+    {"thread-create-bench", test_thread_create_bench},
+    {"rwlock-lookup", test_rwlock_lookup},
+    {"cpu-cycles", test_cpu_cycles},
+    {"timer-accuracy", test_timer_accuracy},
+    {"wakeup-latency", test_wakeup_latency},
+    {"sched-fair-rr", test_sched_fair_rr},
+    {"sched-fair-mlfqs", test_sched_fair_mlfqs},
+    {"sched-fair-cfs", test_sched_fair_cfs},
+    {"edf-periodic", test_edf_periodic},
+    {"switch-bench", test_switch_bench},
+    {"palloc-stress", test_palloc_stress},
+    {"malloc-churn", test_malloc_churn},
+    {"slab-cache", test_slab_cache},
+    {"malloc-classes", test_malloc_classes},
+    {"palloc-prezero", test_palloc_prezero},
+    {"balance-pull", test_balance_pull},
+    {"intr-off-window", test_intr_off_window},
+    {"lock-adaptive", test_lock_adaptive},
+    {"smp-speedup", test_smp_speedup},
     {"mlfqs-load-1", test_mlfqs_load_1},
     {"mlfqs-load-60", test_mlfqs_load_60},
     {"mlfqs-load-avg", test_mlfqs_load_avg},
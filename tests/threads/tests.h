@@ -11,6 +11,7 @@ extern test_func test_alarm_simultaneous;
 extern test_func test_alarm_priority;
 extern test_func test_alarm_zero;
 extern test_func test_alarm_negative;
+extern test_func test_alarm_sleepers;
 extern test_func test_priority_change;
 extern test_func test_priority_donate_one;
 extern test_func test_priority_donate_multiple;
@@ -23,6 +24,26 @@ extern test_func test_priority_fifo;
 extern test_func test_priority_preempt;
 extern test_func test_priority_sema;
 extern test_func test_priority_condvar;
+extern test_func test_balance_converge;
+extern test_func test_thread_create_bench;
+extern test_func test_rwlock_lookup;
+extern test_func test_cpu_cycles;
+extern test_func test_timer_accuracy;
+extern test_func test_wakeup_latency;
+extern test_func test_sched_fair_rr;
+extern test_func test_sched_fair_mlfqs;
+extern test_func test_sched_fair_cfs;
+extern test_func test_edf_periodic;
+extern test_func test_switch_bench;
+extern test_func test_palloc_stress;
+extern test_func test_malloc_churn;
+extern test_func test_slab_cache;
+extern test_func test_malloc_classes;
+extern test_func test_palloc_prezero;
+extern test_func test_balance_pull;
+extern test_func test_intr_off_window;
+extern test_func test_lock_adaptive;
+extern test_func test_smp_speedup;
 extern test_func test_mlfqs_load_1;
 extern test_func test_mlfqs_load_60;
 extern test_func test_mlfqs_load_avg;
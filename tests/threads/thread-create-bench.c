@@ -0,0 +1,56 @@
+/* Measures how quickly short-lived threads can be created and
+   joined.  Each thread does nothing but signal a semaphore, so
+   the time is dominated by thread_create() and thread_exit().
+
+   The main thread runs at a lower priority than the threads it
+   creates, so that each one runs to completion, and its page is
+   released, before the next is created.  This is the pattern
+   that the thread page cache speeds up. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+#define THREAD_CNT 5000         /* Number of threads to create. */
+
+static void worker (void *);
+
+void
+test_thread_create_bench (void) 
+{
+  struct semaphore done;
+  int64_t start, elapsed;
+  int i;
+
+  /* This test does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+
+  thread_set_priority (PRI_DEFAULT - 1);
+  sema_init (&done, 0);
+
+  msg ("Creating and joining %d threads.", THREAD_CNT);
+  start = timer_ticks ();
+  for (i = 0; i < THREAD_CNT; i++) 
+    {
+      if (thread_create ("worker", PRI_DEFAULT, worker, &done) == TID_ERROR)
+        fail ("could not create thread %d", i);
+      sema_down (&done);
+    }
+  elapsed = timer_elapsed (start);
+
+  msg ("Finished in %lld ticks.", elapsed);
+  thread_print_stats ();
+  pass ();
+}
+
+/* Worker thread. */
+static void
+worker (void *done_) 
+{
+  struct semaphore *done = done_;
+
+  sema_up (done);
+}
@@ -0,0 +1,24 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+my (@v) = check_expected_pattern (<<'EOF');
+(thread-create-bench) begin
+(thread-create-bench) Creating and joining 5000 threads.
+(thread-create-bench) Finished in {N} ticks.
+Thread: {N} idle ticks, {N} kernel ticks, {N} user ticks
+Thread page cache: {N} hits, {N} misses
+Thread: {N} idle cycles, {N} kernel cycles, {N} user cycles, {N} interrupt cycles
+{LINES}
+(thread-create-bench) PASS
+(thread-create-bench) end
+EOF
+my ($ticks, $hits, $misses) = @v[0, 4, 5];
+
+# Each worker exits before the next is created, so nearly every
+# thread_create() should reuse the page of the thread before it.
+fail "Only $hits of 5000 thread creations hit the page cache.\n"
+  if $hits < 4500;
+fail "Thread page cache missed $misses times.\n" if $misses > 500;
+fail "Creating 5000 threads took $ticks ticks.\n" if $ticks > 1000;
+pass;
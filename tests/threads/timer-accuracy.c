@@ -0,0 +1,68 @@
+/* Sleeps repeatedly for a range of durations, from a few
+   microseconds to several timer ticks, and measures how late
+   each sleep wakes up against timer_now_ns().
+
+   For each duration, prints the distribution of wake-up
+   lateness.  Fails if any sleep returns early or if the clock
+   ever runs backward. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "devices/timer.h"
+
+#define SAMPLE_CNT 20           /* Sleeps per duration. */
+
+/* Upper bounds, in ns, of the lateness histogram buckets.  The
+   last bucket holds everything larger. */
+static const int64_t bucket_limits[] =
+  { 1000, 10 * 1000, 100 * 1000, 1000 * 1000, 10 * 1000 * 1000 };
+#define BUCKET_CNT (sizeof bucket_limits / sizeof *bucket_limits + 1)
+
+void
+test_timer_accuracy (void) 
+{
+  static const int64_t durations[] =
+    { 5 * 1000, 50 * 1000, 500 * 1000, 5 * 1000 * 1000,
+      25 * 1000 * 1000 };
+  size_t d;
+  int64_t last = timer_now_ns ();
+
+  for (d = 0; d < sizeof durations / sizeof *durations; d++) 
+    {
+      int hist[BUCKET_CNT] = { 0 };
+      int64_t min = INT64_MAX, max = 0, sum = 0;
+      int i;
+
+      for (i = 0; i < SAMPLE_CNT; i++) 
+        {
+          int64_t start, late;
+          size_t b;
+
+          start = timer_now_ns ();
+          if (start < last)
+            fail ("clock ran backward by %lld ns", last - start);
+          timer_nsleep (durations[d]);
+          last = timer_now_ns ();
+          late = last - start - durations[d];
+          if (late < 0)
+            fail ("%lld ns sleep woke %lld ns early", durations[d], -late);
+
+          for (b = 0; b < BUCKET_CNT - 1; b++)
+            if (late < bucket_limits[b])
+              break;
+          hist[b]++;
+          if (late < min)
+            min = late;
+          if (late > max)
+            max = late;
+          sum += late;
+        }
+
+      msg ("%lld ns sleep: late by min %lld, avg %lld, max %lld ns.",
+           durations[d], min, sum / SAMPLE_CNT, max);
+      msg ("  <1us %d, <10us %d, <100us %d, <1ms %d, <10ms %d, more %d",
+           hist[0], hist[1], hist[2], hist[3], hist[4], hist[5]);
+    }
+  pass ();
+}
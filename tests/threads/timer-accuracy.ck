@@ -0,0 +1,29 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+my (@durations) = (5000, 50000, 500000, 5000000, 25000000);
+my ($expected) = "(timer-accuracy) begin\n";
+$expected .= "(timer-accuracy) $_ ns sleep: late by min {N}, avg {N}, "
+  . "max {N} ns.\n"
+  . "(timer-accuracy)   <1us {N}, <10us {N}, <100us {N}, <1ms {N}, "
+  . "<10ms {N}, more {N}\n"
+  foreach @durations;
+$expected .= "(timer-accuracy) PASS\n(timer-accuracy) end\n";
+my (@v) = check_expected_pattern ($expected);
+
+foreach my $duration (@durations) {
+    my ($min, $avg, $max, @hist) = splice (@v, 0, 9);
+    my ($samples) = 0;
+    $samples += $_ foreach @hist;
+
+    fail "$duration ns sleep: min $min, avg $avg, max $max out of order.\n"
+      unless 0 <= $min && $min <= $avg && $avg <= $max;
+    fail "$duration ns sleep: histogram holds $samples samples, not 20.\n"
+      if $samples != 20;
+
+    # No sleep should overshoot by more than two timer ticks.
+    fail "$duration ns sleep woke up as much as $max ns late.\n"
+      if $max > 20000000;
+}
+pass;
@@ -0,0 +1,84 @@
+/* Measures the latency from a timer interrupt to the thread it
+   wakes running, while a lower-priority thread keeps the CPU
+   busy.
+
+   The main thread raises its priority and sleeps for one tick,
+   SAMPLE_CNT times, and records how long after the waking timer
+   interrupt it got the CPU back.  A woken thread that outranks
+   the running one should preempt it at once rather than wait
+   for the end of its time slice, so every wake-up should come
+   well within one tick of the interrupt.
+
+   Disk interrupts wake their waiters through the same
+   sema_up() and thread_unblock() path, but the threads tests
+   run without a disk, so only the timer is measured here. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+#define SAMPLE_CNT 200          /* Number of wake-ups measured. */
+
+static volatile bool hog_stop;
+static struct semaphore hog_done;
+
+static void hog (void *);
+static int compare_ns (const void *, const void *);
+
+void
+test_wakeup_latency (void) 
+{
+  static int64_t samples[SAMPLE_CNT];
+  int64_t limit = 1000000000 / TIMER_FREQ;
+  int i;
+
+  /* This test does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+
+  thread_set_priority (PRI_DEFAULT + 10);
+  hog_stop = false;
+  sema_init (&hog_done, 0);
+  thread_create ("hog", PRI_DEFAULT, hog, NULL);
+
+  for (i = 0; i < SAMPLE_CNT; i++) 
+    {
+      timer_sleep (1);
+      samples[i] = timer_now_ns () - timer_last_interrupt_ns ();
+    }
+
+  hog_stop = true;
+  sema_down (&hog_done);
+  thread_set_priority (PRI_DEFAULT);
+
+  qsort (samples, SAMPLE_CNT, sizeof *samples, compare_ns);
+  msg ("Wake-up latency: p50 %lld ns, p90 %lld ns, p99 %lld ns, "
+       "max %lld ns.",
+       samples[SAMPLE_CNT / 2], samples[SAMPLE_CNT * 9 / 10],
+       samples[SAMPLE_CNT * 99 / 100], samples[SAMPLE_CNT - 1]);
+  if (samples[SAMPLE_CNT * 99 / 100] >= limit)
+    fail ("99th percentile latency exceeds one timer tick");
+  pass ();
+}
+
+/* Spins until told to stop. */
+static void
+hog (void *aux UNUSED) 
+{
+  while (!hog_stop)
+    continue;
+  sema_up (&hog_done);
+}
+
+/* Orders the int64_t values at A and B. */
+static int
+compare_ns (const void *a_, const void *b_) 
+{
+  const int64_t *a = a_;
+  const int64_t *b = b_;
+
+  return *a < *b ? -1 : *a > *b;
+}
@@ -0,0 +1,17 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+my ($p50, $p90, $p99, $max) = check_expected_pattern (<<'EOF');
+(wakeup-latency) begin
+(wakeup-latency) Wake-up latency: p50 {N} ns, p90 {N} ns, p99 {N} ns, max {N} ns.
+(wakeup-latency) PASS
+(wakeup-latency) end
+EOF
+fail "Percentiles $p50, $p90, $p99, $max ns are out of order.\n"
+  unless 0 <= $p50 && $p50 <= $p90 && $p90 <= $p99 && $p99 <= $max;
+
+# A woken thread that outranks the hog should preempt it well
+# within the 10 ms tick.
+fail "99th percentile wake-up latency is $p99 ns.\n" if $p99 >= 10000000;
+pass;
@@ -0,0 +1,74 @@
+/* Checks that a wake-up is not lost when it arrives after a
+   waiter has read the futex but before it calls futex_wait().
+
+   A user-space mutex or condition reads the futex word, decides
+   to sleep, and only then enters the kernel.  Another thread may
+   change the word and call futex_wake() in between, when nobody
+   is waiting yet.  futex_wait() must then see that the word no
+   longer holds the value the waiter read and return at once,
+   instead of sleeping through the wake-up. */
+
+#include "tests/userprog/kernel/tests.h"
+#include <stdio.h>
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "userprog/futex.h"
+
+static struct semaphore go, done;
+static bool returned;
+static int result;
+
+static thread_func waiter;
+
+void
+test_futex_lost_wakeup (void) 
+{
+  int *kfutex = user_page_create ();
+  int woken;
+
+  sema_init (&go, 0);
+  sema_init (&done, 0);
+  returned = false;
+
+  /* The waiter outranks us, so it reads the futex and then
+     stops on GO before thread_create() returns. */
+  thread_create ("waiter", PRI_DEFAULT + 1, waiter, NULL);
+
+  /* Release the waiter while nobody is waiting on the futex. */
+  *kfutex = 1;
+  woken = futex_wake (USER_PAGE, 1);
+  msg ("futex_wake() before futex_wait() woke %d threads.", woken);
+
+  /* The waiter now calls futex_wait() with the stale value.  It
+     still outranks us, so if futex_wait() returned it has
+     finished by the time we run again. */
+  sema_up (&go);
+  if (!returned)
+    {
+      futex_wake (USER_PAGE, 1);
+      sema_down (&done);
+      fail ("futex_wait() slept through a wake-up");
+    }
+  msg ("futex_wait() after the wake-up returned %d.", result);
+  sema_down (&done);
+
+  user_page_destroy ();
+  pass ();
+}
+
+/* Reads the futex, lets the main thread run, and then waits on
+   the futex with the value read. */
+static void
+waiter (void *aux UNUSED) 
+{
+  int *futex = USER_PAGE;
+  int value;
+
+  user_page_enter ();
+  value = *futex;
+  sema_down (&go);
+  result = futex_wait (futex, value);
+  returned = true;
+  user_page_leave ();
+  sema_up (&done);
+}
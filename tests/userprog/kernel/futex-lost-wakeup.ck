@@ -0,0 +1,12 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(futex-lost-wakeup) begin
+(futex-lost-wakeup) futex_wake() before futex_wait() woke 0 threads.
+(futex-lost-wakeup) futex_wait() after the wake-up returned -1.
+(futex-lost-wakeup) PASS
+(futex-lost-wakeup) end
+EOF
+pass;
@@ -0,0 +1,75 @@
+/* Checks that futex_wait() returns -1 without blocking when the
+   futex does not hold the expected value, and that futex_wait()
+   and futex_wake() both return -1 for addresses that are not
+   valid futexes: a null pointer, a kernel address, a misaligned
+   address, an unmapped user address, and any address in a
+   thread without a user address space. */
+
+#include "tests/userprog/kernel/tests.h"
+#include <stdint.h>
+#include <stdio.h>
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#include "userprog/futex.h"
+
+static struct semaphore done;
+static bool returned;
+static int result;
+
+static thread_func waiter;
+static void check_bad (const char *what, void *addr);
+
+void
+test_futex_mismatch (void) 
+{
+  int *kfutex = user_page_create ();
+  uint8_t *page = USER_PAGE;
+
+  /* The waiter outranks us, so unless it blocks it has finished
+     by the time thread_create() returns. */
+  *kfutex = 5;
+  sema_init (&done, 0);
+  returned = false;
+  thread_create ("waiter", PRI_DEFAULT + 1, waiter, NULL);
+  if (!returned)
+    {
+      futex_wake (USER_PAGE, 1);
+      sema_down (&done);
+      fail ("futex_wait() blocked although the value differed");
+    }
+  msg ("futex_wait() on a futex holding 5, expecting 4, returned %d.",
+       result);
+  sema_down (&done);
+
+  check_bad ("a null pointer", NULL);
+  check_bad ("a kernel address", PHYS_BASE);
+  check_bad ("a misaligned address", page + 1);
+  check_bad ("an unmapped address", page + PGSIZE);
+
+  user_page_leave ();
+  check_bad ("a thread without user memory", page);
+  user_page_destroy ();
+  pass ();
+}
+
+/* Waits on the futex, expecting a value other than the one it
+   holds. */
+static void
+waiter (void *aux UNUSED) 
+{
+  user_page_enter ();
+  result = futex_wait (USER_PAGE, 4);
+  returned = true;
+  user_page_leave ();
+  sema_up (&done);
+}
+
+/* Calls futex_wait() and futex_wake() on ADDR, described by WHAT,
+   and reports what they return. */
+static void
+check_bad (const char *what, void *addr) 
+{
+  msg ("On %s, futex_wait() returned %d and futex_wake() returned %d.",
+       what, futex_wait (addr, 0), futex_wake (addr, 1));
+}
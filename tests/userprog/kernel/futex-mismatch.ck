@@ -0,0 +1,16 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(futex-mismatch) begin
+(futex-mismatch) futex_wait() on a futex holding 5, expecting 4, returned -1.
+(futex-mismatch) On a null pointer, futex_wait() returned -1 and futex_wake() returned -1.
+(futex-mismatch) On a kernel address, futex_wait() returned -1 and futex_wake() returned -1.
+(futex-mismatch) On a misaligned address, futex_wait() returned -1 and futex_wake() returned -1.
+(futex-mismatch) On an unmapped address, futex_wait() returned -1 and futex_wake() returned -1.
+(futex-mismatch) On a thread without user memory, futex_wait() returned -1 and futex_wake() returned -1.
+(futex-mismatch) PASS
+(futex-mismatch) end
+EOF
+pass;
@@ -0,0 +1,63 @@
+/* Blocks threads of different priorities on one futex, in an
+   order unrelated to their priorities, and checks that
+   futex_wake() wakes them highest priority first. */
+
+#include "tests/userprog/kernel/tests.h"
+#include <stdio.h>
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "userprog/futex.h"
+
+#define WAITER_CNT 5
+
+static struct semaphore done;
+static int order[WAITER_CNT];
+static int woken_cnt;
+
+static thread_func waiter;
+
+void
+test_futex_priority (void) 
+{
+  static const int boosts[WAITER_CNT] = {3, 1, 5, 2, 4};
+  int i;
+
+  user_page_create ();
+  sema_init (&done, 0);
+  woken_cnt = 0;
+
+  /* Each waiter outranks us, so it blocks before thread_create()
+     returns. */
+  for (i = 0; i < WAITER_CNT; i++)
+    {
+      char name[16];
+      snprintf (name, sizeof name, "priority %d", PRI_DEFAULT + boosts[i]);
+      thread_create (name, PRI_DEFAULT + boosts[i], waiter, NULL);
+    }
+
+  /* Each woken waiter also outranks us, so it runs to the end
+     before futex_wake() returns. */
+  for (i = 0; i < WAITER_CNT; i++)
+    {
+      if (futex_wake (USER_PAGE, 1) != 1)
+        fail ("futex_wake() did not wake a thread");
+      sema_down (&done);
+    }
+
+  for (i = 0; i < WAITER_CNT; i++)
+    msg ("Woken thread %d had priority %d.", i, order[i]);
+  user_page_destroy ();
+  pass ();
+}
+
+/* Waits on the futex, which holds 0, and then records its own
+   priority in the next slot of ORDER. */
+static void
+waiter (void *aux UNUSED) 
+{
+  user_page_enter ();
+  futex_wait (USER_PAGE, 0);
+  order[woken_cnt++] = thread_get_priority ();
+  user_page_leave ();
+  sema_up (&done);
+}
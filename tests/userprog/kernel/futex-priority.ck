@@ -0,0 +1,15 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(futex-priority) begin
+(futex-priority) Woken thread 0 had priority 36.
+(futex-priority) Woken thread 1 had priority 35.
+(futex-priority) Woken thread 2 had priority 34.
+(futex-priority) Woken thread 3 had priority 33.
+(futex-priority) Woken thread 4 had priority 32.
+(futex-priority) PASS
+(futex-priority) end
+EOF
+pass;
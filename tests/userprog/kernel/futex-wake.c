@@ -0,0 +1,68 @@
+/* Blocks WAITER_CNT threads on a futex in a shared user page and
+   checks that futex_wake() wakes no more than the number of
+   threads asked for, reports how many it woke, and that each
+   woken thread's futex_wait() returns 0. */
+
+#include "tests/userprog/kernel/tests.h"
+#include <stdio.h>
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "userprog/futex.h"
+
+#define WAITER_CNT 3
+
+static struct semaphore done;
+static int results[WAITER_CNT];
+
+static thread_func waiter;
+
+void
+test_futex_wake (void) 
+{
+  int *futex = USER_PAGE;
+  int woken, i;
+
+  user_page_create ();
+  sema_init (&done, 0);
+
+  /* Each waiter outranks us, so it blocks before thread_create()
+     returns. */
+  for (i = 0; i < WAITER_CNT; i++)
+    {
+      char name[16];
+      snprintf (name, sizeof name, "waiter %d", i);
+      results[i] = 1;
+      thread_create (name, PRI_DEFAULT + 1, waiter, &results[i]);
+    }
+
+  woken = futex_wake (futex, 2);
+  msg ("futex_wake (2) woke %d threads.", woken);
+  sema_down (&done);
+  sema_down (&done);
+
+  woken = futex_wake (futex, WAITER_CNT);
+  msg ("futex_wake (%d) woke %d threads.", WAITER_CNT, woken);
+  sema_down (&done);
+
+  woken = futex_wake (futex, WAITER_CNT);
+  msg ("futex_wake (%d) with no waiters woke %d threads.", WAITER_CNT, woken);
+
+  for (i = 0; i < WAITER_CNT; i++)
+    if (results[i] != 0)
+      fail ("futex_wait() in waiter %d returned %d", i, results[i]);
+  user_page_destroy ();
+  pass ();
+}
+
+/* Waits on the futex, which holds 0, and stores futex_wait()'s
+   return value in *RESULT_. */
+static void
+waiter (void *result_) 
+{
+  int *result = result_;
+
+  user_page_enter ();
+  *result = futex_wait (USER_PAGE, 0);
+  user_page_leave ();
+  sema_up (&done);
+}
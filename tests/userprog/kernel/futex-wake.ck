@@ -0,0 +1,13 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(futex-wake) begin
+(futex-wake) futex_wake (2) woke 2 threads.
+(futex-wake) futex_wake (3) woke 1 threads.
+(futex-wake) futex_wake (3) with no waiters woke 0 threads.
+(futex-wake) PASS
+(futex-wake) end
+EOF
+pass;
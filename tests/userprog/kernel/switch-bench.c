@@ -0,0 +1,16 @@
+/* Runs the context-switch benchmarks from threads/switch-bench.c
+   in a kernel with user programs, which times switches between
+   threads with page directories as well as between kernel
+   threads.  The .ck file checks that switches within one address
+   space leave CR3 alone and that switches across address spaces
+   reload it. */
+
+#include "tests/userprog/kernel/tests.h"
+#include "threads/switch-bench.h"
+
+void
+test_switch_bench (void) 
+{
+  switch_bench ();
+  pass ();
+}
@@ -0,0 +1,25 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+my (@v) = check_expected_pattern (<<'EOF');
+(switch-bench) begin
+Context switch benchmarks (1000 round trips each):
+  kernel to kernel: {N} cycles per switch
+  user to user, same address space: {N} cycles per switch, {N} page directory loads
+  user to user, cross address space: {N} cycles per switch, {N} page directory loads
+(switch-bench) PASS
+(switch-bench) end
+EOF
+my ($same_loads, $cross_loads) = @v[2, 4];
+
+# 1000 round trips are 2000 switches.  Between threads that share
+# a page directory none of them should reload it, except around the
+# odd switch to some other kernel thread.
+fail "Switches within one address space loaded CR3 $same_loads times.\n"
+  if $same_loads > 20;
+fail "2000 switches across address spaces loaded CR3 only "
+  . "$cross_loads times.\n"
+  if $cross_loads < 2000;
+fail "Switch took $_ cycles.\n" foreach grep ($_ <= 0, @v[0, 1, 3]);
+pass;
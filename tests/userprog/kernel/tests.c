@@ -0,0 +1,152 @@
+#include "tests/userprog/kernel/tests.h"
+#include <debug.h>
+#include <string.h>
+#include <stdio.h>
+#include "threads/interrupt.h"
+#include "threads/palloc.h"
+#include "threads/thread.h"
+#include "userprog/pagedir.h"
+#include "userprog/process.h"
+
+/* Tests of kernel code that user programs cannot exercise on
+   their own, run with the "ktest" action in a kernel with user
+   programs. */
+
+struct test 
+  {
+    const char *name;
+    test_func *function;
+  };
+
+static const struct test tests[] = 
+  {
+    {"futex-wake", test_futex_wake},
+    {"futex-lost-wakeup", test_futex_lost_wakeup},
+    {"futex-mismatch", test_futex_mismatch},
+    {"futex-priority", test_futex_priority},
+    {"switch-bench", test_switch_bench},
+  };
+
+static const char *test_name;
+
+/* Page directory that maps USER_PAGE, or a null pointer. */
+static uint32_t *user_pd;
+
+static void set_pagedir (uint32_t *pd);
+
+/* Runs the test named NAME. */
+void
+run_test (const char *name) 
+{
+  const struct test *t;
+
+  for (t = tests; t < tests + sizeof tests / sizeof *tests; t++)
+    if (!strcmp (name, t->name))
+      {
+        test_name = name;
+        msg ("begin");
+        t->function ();
+        msg ("end");
+        return;
+      }
+  PANIC ("no test named \"%s\"", name);
+}
+
+/* Prints FORMAT as if with printf(),
+   prefixing the output by the name of the test
+   and following it with a new-line character. */
+void
+msg (const char *format, ...) 
+{
+  va_list args;
+  
+  printf ("(%s) ", test_name);
+  va_start (args, format);
+  vprintf (format, args);
+  va_end (args);
+  putchar ('\n');
+}
+
+/* Prints failure message FORMAT as if with printf(),
+   prefixing the output by the name of the test and FAIL:
+   and following it with a new-line character,
+   and then panics the kernel. */
+void
+fail (const char *format, ...) 
+{
+  va_list args;
+  
+  printf ("(%s) FAIL: ", test_name);
+  va_start (args, format);
+  vprintf (format, args);
+  va_end (args);
+  putchar ('\n');
+
+  PANIC ("test failed");
+}
+
+/* Prints a message indicating the current test passed. */
+void
+pass (void) 
+{
+  printf ("(%s) PASS\n", test_name);
+}
+
+/* Creates a page directory that maps a zeroed, writable page at
+   user address USER_PAGE, and makes it the running thread's.
+   Returns the page's kernel address. */
+void *
+user_page_create (void) 
+{
+  void *kpage;
+
+  ASSERT (user_pd == NULL);
+
+  user_pd = pagedir_create ();
+  kpage = palloc_get_page (PAL_USER | PAL_ZERO);
+  if (user_pd == NULL || kpage == NULL
+      || !pagedir_set_page (user_pd, USER_PAGE, kpage, true))
+    fail ("out of memory");
+  user_page_enter ();
+  return kpage;
+}
+
+/* Makes the page directory from user_page_create() the running
+   thread's, so that the thread can use USER_PAGE. */
+void
+user_page_enter (void) 
+{
+  ASSERT (user_pd != NULL);
+
+  set_pagedir (user_pd);
+}
+
+/* Gives up the running thread's page directory.  Threads that
+   called user_page_enter() must do this before they exit, so
+   that process_exit() does not destroy the page directory. */
+void
+user_page_leave (void) 
+{
+  set_pagedir (NULL);
+}
+
+/* Leaves and destroys the page directory from
+   user_page_create(), along with its page. */
+void
+user_page_destroy (void) 
+{
+  user_page_leave ();
+  pagedir_destroy (user_pd);
+  user_pd = NULL;
+}
+
+/* Makes PD, which may be null, the running thread's page
+   directory and activates it. */
+static void
+set_pagedir (uint32_t *pd) 
+{
+  enum intr_level old_level = intr_disable ();
+  thread_current ()->pagedir = pd;
+  process_activate ();
+  intr_set_level (old_level);
+}
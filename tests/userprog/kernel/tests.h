@@ -0,0 +1,26 @@
+#ifndef TESTS_USERPROG_KERNEL_TESTS_H
+#define TESTS_USERPROG_KERNEL_TESTS_H
+
+void run_test (const char *);
+
+typedef void test_func (void);
+
+extern test_func test_futex_wake;
+extern test_func test_futex_lost_wakeup;
+extern test_func test_futex_mismatch;
+extern test_func test_futex_priority;
+extern test_func test_switch_bench;
+
+void msg (const char *, ...);
+void fail (const char *, ...);
+void pass (void);
+
+/* User page shared by the threads of a test. */
+#define USER_PAGE ((void *) 0x10000000)
+
+void *user_page_create (void);
+void user_page_enter (void);
+void user_page_leave (void);
+void user_page_destroy (void);
+
+#endif /* tests/userprog/kernel/tests.h */
@@ -0,0 +1,434 @@
+#include "threads/cpu.h"
+#include <debug.h>
+#include <stdio.h>
+#include <string.h>
+#include "threads/defer.h"
+#include "threads/init.h"
+#include "threads/interrupt.h"
+#include "threads/loader.h"
+#include "threads/palloc.h"
+#include "threads/pte.h"
+#include "threads/vaddr.h"
+#include "devices/lapic.h"
+#include "devices/timer.h"
+#ifdef USERPROG
+#include "userprog/gdt.h"
+#include "userprog/tss.h"
+#endif
+
+/* Per-CPU data areas, indexed by CPU number.  CPU 0 is the boot
+   processor. */
+struct cpu cpus[CPU_MAX];
+
+/* Number of CPUs online.  Only the boot processor is online
+   until cpu_start_aps() brings up the others, the application
+   processors, which take CPU numbers 1, 2, ... in the order they
+   come online. */
+unsigned cpu_cnt;
+
+/* MP floating pointer structure, which the BIOS leaves in low
+   memory on a multiprocessor to locate the MP configuration
+   table.  See the Intel MultiProcessor Specification, version
+   1.4, chapter 4 "MP Configuration Table". */
+struct mp_float
+  {
+    char signature[4];          /* "_MP_". */
+    uint32_t config;            /* Physical address of struct mp_config. */
+    uint8_t length;             /* Length in 16-byte units. */
+    uint8_t revision;           /* Specification revision. */
+    uint8_t checksum;           /* Makes all the bytes sum to 0. */
+    uint8_t features[5];        /* Feature information. */
+  } __attribute__ ((packed));
+
+/* MP configuration table header, followed by ENTRY_CNT entries. */
+struct mp_config
+  {
+    char signature[4];          /* "PCMP". */
+    uint16_t length;            /* Length of header and entries. */
+    uint8_t revision;           /* Specification revision. */
+    uint8_t checksum;           /* Makes all the bytes sum to 0. */
+    char oem[8];                /* OEM ID. */
+    char product[12];           /* Product ID. */
+    uint32_t oem_table;         /* Physical address of OEM table. */
+    uint16_t oem_length;        /* Size of OEM table. */
+    uint16_t entry_cnt;         /* Number of entries. */
+    uint32_t lapic_addr;        /* Physical address of local APICs. */
+    uint16_t ext_length;        /* Length of extended entries. */
+    uint8_t ext_checksum;       /* Checksum of extended entries. */
+    uint8_t reserved;
+  } __attribute__ ((packed));
+
+/* Processor entry in the MP configuration table.  Entries of
+   every other type are MP_ENTRY_SIZE bytes long. */
+#define MP_PROCESSOR 0
+#define MP_ENTRY_SIZE 8
+struct mp_processor
+  {
+    uint8_t type;               /* MP_PROCESSOR. */
+    uint8_t apic_id;            /* Local APIC ID. */
+    uint8_t apic_version;       /* Local APIC version. */
+    uint8_t flags;              /* MP_ENABLED, MP_BOOT. */
+    uint32_t signature;         /* CPU stepping, model, family. */
+    uint32_t features;          /* CPUID feature flags. */
+    uint32_t reserved[2];
+  } __attribute__ ((packed));
+#define MP_ENABLED 0x01         /* Usable. */
+#define MP_BOOT 0x02            /* The boot processor. */
+
+/* Handshake between the boot processor and an application
+   processor that it is starting.  Both sides change AP_STATE
+   only with an atomic exchange, so if the boot processor gives
+   up on an application processor at the moment it comes up,
+   exactly one of them sees the other's change. */
+enum ap_state
+  {
+    AP_WAITING,                 /* Startup IPIs sent. */
+    AP_STARTED,                 /* Running cpu_ap_main(). */
+    AP_ABANDONED                /* Given up on by the boot processor. */
+  };
+static volatile uint32_t ap_state;
+#define AP_START_MS 100         /* Time allowed to start, in ms. */
+
+static rb_less_func vruntime_less;
+static rb_less_func deadline_less;
+static struct mp_config *mp_find_config (void);
+static struct mp_float *mp_search (uintptr_t paddr, size_t size);
+static bool mp_checksum (const void *, size_t size);
+static bool start_ap (struct cpu *, unsigned apic_id);
+static uint32_t *ap_var (uint32_t *);
+static uint32_t atomic_xchg (volatile uint32_t *, uint32_t);
+
+/* Initializes the boot processor's per-CPU data area.  Must be
+   called before any thread is put on a run queue. */
+void
+cpu_init (void)
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  cpu_init_data (&cpus[0], 0);
+  cpu_cnt = 1;
+}
+
+/* Brings up the application processors listed in the BIOS's MP
+   configuration table, up to CPU_MAX CPUs in all, and raises
+   cpu_cnt to the number online.  Does nothing on a machine
+   without an MP configuration table, which is a uniprocessor.
+   Must be called on the boot processor with interrupts on, after
+   the timer is calibrated and before any user process starts. */
+void
+cpu_start_aps (void)
+{
+  extern char ap_start[], ap_start_end[];
+  extern uint32_t ap_cr3;
+  struct mp_config *mp = mp_find_config ();
+  uint8_t *entry;
+  uint32_t *pd;
+  int i;
+
+  ASSERT (intr_get_level () == INTR_ON);
+  ASSERT (cpu_cnt == 1);
+
+  if (mp == NULL)
+    return;
+  lapic_map (mp->lapic_addr);
+  lapic_init ();
+  cpus[0].apic_id = lapic_id ();
+
+  /* The startup code turns on paging while it runs in low
+     memory, so give it a page directory that also maps low
+     memory one-to-one.  Each CPU leaves that page directory
+     in cpu_ap_main(), so init_page_dir never needs the
+     one-to-one mapping. */
+  pd = palloc_get_page (PAL_ASSERT);
+  memcpy (pd, init_page_dir, PGSIZE);
+  pd[0] = pd[pd_no (PHYS_BASE)];
+  memcpy (ptov (LOADER_AP_START), ap_start, ap_start_end - ap_start);
+  *ap_var (&ap_cr3) = vtop (pd);
+
+  entry = (uint8_t *) (mp + 1);
+  for (i = 0; i < mp->entry_cnt; i++)
+    {
+      struct mp_processor *p = (struct mp_processor *) entry;
+
+      if (p->type != MP_PROCESSOR)
+        {
+          entry += MP_ENTRY_SIZE;
+          continue;
+        }
+      entry += sizeof *p;
+      if ((p->flags & MP_ENABLED) == 0 || p->apic_id == cpus[0].apic_id)
+        continue;
+      if (cpu_cnt == CPU_MAX)
+        {
+          printf ("Only %d CPUs are supported; ignoring the rest.\n",
+                  CPU_MAX);
+          break;
+        }
+
+      /* From here on, every interrupts-off section must keep the
+         other CPUs out. */
+      if (cpu_cnt == 1)
+        intr_lock_start ();
+      if (!start_ap (&cpus[cpu_cnt], p->apic_id))
+        break;
+    }
+  palloc_free_page (pd);
+
+  if (cpu_cnt > 1)
+    printf ("%u CPUs online.\n", cpu_cnt);
+}
+
+/* Starts the application processor with local APIC ID APIC_ID
+   as CPU C, whose number must be cpu_cnt, and brings it online.
+   Returns true if successful, false if the processor did not
+   respond. */
+static bool
+start_ap (struct cpu *c, unsigned apic_id)
+{
+  extern uint32_t ap_esp;
+  enum intr_level old_level;
+  void *stack;
+  int ms;
+
+  cpu_init_data (c, c - cpus);
+  c->apic_id = apic_id;
+  stack = thread_init_ap (c);
+  if (stack == NULL)
+    return false;
+  defer_start (c);
+
+  *ap_var (&ap_esp) = (uint32_t) stack;
+  ap_state = AP_WAITING;
+  lapic_start_ap (apic_id, LOADER_AP_START);
+  for (ms = 0; ms < AP_START_MS && ap_state == AP_WAITING; ms++)
+    timer_mdelay (1);
+  if (atomic_xchg (&ap_state, AP_ABANDONED) != AP_STARTED)
+    {
+      printf ("CPU with local APIC ID %u did not start.\n", apic_id);
+      return false;
+    }
+
+  /* The first thread the new CPU runs is its deferred-work
+     thread.  Keep the CPU out of cpu_cnt until then, so that no
+     other CPU steals that thread from its run queue. */
+  while (c->defer_worker == NULL)
+    asm volatile ("pause" : : : "memory");
+
+  old_level = intr_disable ();
+  cpu_cnt++;
+  intr_set_level (old_level);
+  return true;
+}
+
+/* Application processor entry point, called by ap-start.S with
+   interrupts off on the stack of the CPU's idle thread, which
+   start_ap() prepared.  Finishes setting up the CPU and enters
+   the idle loop. */
+void
+cpu_ap_main (void)
+{
+  struct cpu *c = cpu_current ();
+
+  /* Leave the startup page directory, which the boot processor
+     frees once every CPU is up. */
+  asm volatile ("movl %0, %%cr3" : : "r" (vtop (init_page_dir))
+                : "memory");
+
+  /* Tell the boot processor we are here, unless it already gave
+     up on us, in which case our idle thread is not ours to run. */
+  if (atomic_xchg (&ap_state, AP_STARTED) == AP_ABANDONED)
+    for (;;)
+      asm volatile ("cli; hlt" : : : "memory");
+
+  intr_init_ap ();
+#ifdef USERPROG
+  tss_init ();
+  gdt_init ();
+#endif
+  lapic_init ();
+  c->mode_since = rdtsc ();
+  thread_start_ap ();
+}
+
+/* Asks CPU C, which is not the CPU we are running on, to check
+   whether a thread on its run queue now outranks the thread it
+   is running.  Does nothing if C is not online yet; it will look
+   at its run queue when it first schedules. */
+void
+cpu_kick (struct cpu *c)
+{
+  ASSERT (c != cpu_current ());
+
+  if (c->id < cpu_cnt)
+    lapic_send_ipi (c->apic_id, IPI_RESCHEDULE);
+}
+
+/* Returns the per-CPU data area of the CPU we are running on.
+
+   Each CPU runs on the stack of its current thread, and `struct
+   thread' records the CPU the thread is running on, so this
+   needs no CPU-specific register. */
+struct cpu *
+cpu_current (void)
+{
+  struct thread *t = running_thread ();
+
+  ASSERT (t->cpu != NULL);
+  return t->cpu;
+}
+
+/* Charges the cycles since the last accounting point to the
+   running thread, under the mode the CPU has been in, and then
+   puts the CPU in MODE.  Returns the mode the CPU was in.
+
+   This is called at every thread switch and at every entry to
+   and exit from an interrupt handler, so each thread's cycles
+   are split exactly between user code, kernel code, and the
+   external interrupts that arrived while it was running.  Time
+   in the idle thread's kernel mode is counted as idle time
+   instead. */
+enum cpu_mode
+cpu_account (enum cpu_mode mode)
+{
+  enum intr_level old_level = intr_disable ();
+  struct cpu *c = cpu_current ();
+  struct thread *t = running_thread ();
+  uint64_t now = rdtsc ();
+  uint64_t cycles = now - c->mode_since;
+  enum cpu_mode old_mode = c->mode;
+
+  t->cycles[old_mode] += cycles;
+  if (t == c->idle_thread && old_mode == CPU_MODE_KERNEL)
+    c->idle_cycles += cycles;
+  else
+    c->cycles[old_mode] += cycles;
+  c->mode = mode;
+  c->mode_since = now;
+  intr_set_level (old_level);
+
+  return old_mode;
+}
+
+/* Initializes C as the data area for CPU number ID.  Does not
+   bring that CPU online. */
+void
+cpu_init_data (struct cpu *c, unsigned id)
+{
+  int i;
+
+  memset (c, 0, sizeof *c);
+  c->id = id;
+  spinlock_init (&c->rq.lock);
+  list_init (&c->deferred);
+  c->mode = CPU_MODE_KERNEL;
+  c->mode_since = rdtsc ();
+  for (i = 0; i < PRI_CNT; i++)
+    list_init (&c->rq.queues[i]);
+  rb_init (&c->rq.cfs_tree, vruntime_less, NULL);
+  rb_init (&c->rq.edf_tree, deadline_less, NULL);
+  list_init (&c->edf_pending);
+}
+
+/* Returns true if thread A has less vruntime than thread B. */
+static bool
+vruntime_less (const struct rb_elem *a_, const struct rb_elem *b_,
+               void *aux UNUSED)
+{
+  const struct thread *a = rb_entry (a_, struct thread, cfs_elem);
+  const struct thread *b = rb_entry (b_, struct thread, cfs_elem);
+
+  return a->vruntime < b->vruntime;
+}
+
+/* Returns true if thread A has an earlier deadline than thread
+   B. */
+static bool
+deadline_less (const struct rb_elem *a_, const struct rb_elem *b_,
+               void *aux UNUSED)
+{
+  const struct thread *a = rb_entry (a_, struct thread, edf_elem);
+  const struct thread *b = rb_entry (b_, struct thread, edf_elem);
+
+  return a->edf_deadline < b->edf_deadline;
+}
+
+/* Returns the MP configuration table, or a null pointer if the
+   BIOS did not provide a valid one.  The MP floating pointer
+   structure is in the first kB of the extended BIOS data area,
+   in the last kB of base memory, or in the BIOS ROM. */
+static struct mp_config *
+mp_find_config (void)
+{
+  uint16_t ebda_seg = *(uint16_t *) ptov (0x40e);
+  uint16_t base_kb = *(uint16_t *) ptov (0x413);
+  uintptr_t ram_end = init_ram_pages * PGSIZE;
+  struct mp_float *mpf = NULL;
+  struct mp_config *mp;
+
+  if (ebda_seg != 0)
+    mpf = mp_search ((uintptr_t) ebda_seg << 4, 1024);
+  if (mpf == NULL)
+    mpf = mp_search (base_kb * 1024 - 1024, 1024);
+  if (mpf == NULL)
+    mpf = mp_search (0xf0000, 0x10000);
+  if (mpf == NULL || mpf->config == 0
+      || mpf->config + sizeof *mp > ram_end)
+    return NULL;
+
+  mp = ptov (mpf->config);
+  if (memcmp (mp->signature, "PCMP", 4) != 0
+      || mpf->config + mp->length > ram_end
+      || !mp_checksum (mp, mp->length))
+    return NULL;
+  return mp;
+}
+
+/* Returns the MP floating pointer structure in the SIZE bytes of
+   physical memory starting at PADDR, or a null pointer if there
+   is none. */
+static struct mp_float *
+mp_search (uintptr_t paddr, size_t size)
+{
+  uintptr_t p;
+
+  for (p = paddr; p + sizeof (struct mp_float) <= paddr + size; p += 16)
+    {
+      struct mp_float *mpf = ptov (p);
+      if (memcmp (mpf->signature, "_MP_", 4) == 0
+          && mp_checksum (mpf, sizeof *mpf))
+        return mpf;
+    }
+  return NULL;
+}
+
+/* Returns true if the SIZE bytes at P sum to 0, modulo 256. */
+static bool
+mp_checksum (const void *p_, size_t size)
+{
+  const uint8_t *p = p_;
+  uint8_t sum = 0;
+
+  while (size-- > 0)
+    sum += *p++;
+  return sum == 0;
+}
+
+/* Returns the copy in low memory, at LOADER_AP_START, of VAR,
+   which is one of the variables in ap-start.S. */
+static uint32_t *
+ap_var (uint32_t *var)
+{
+  extern char ap_start[];
+
+  return ptov (LOADER_AP_START + ((char *) var - ap_start));
+}
+
+/* Atomically stores VALUE in *P and returns the old value.
+   XCHG with a memory operand is implicitly locked.  See
+   [IA32-v2b] "XCHG". */
+static uint32_t
+atomic_xchg (volatile uint32_t *p, uint32_t value)
+{
+  asm volatile ("xchgl %0, %1" : "+r" (value), "+m" (*p) : : "memory");
+  return value;
+}
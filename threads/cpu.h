@@ -0,0 +1,96 @@
+#ifndef THREADS_CPU_H
+#define THREADS_CPU_H
+
+#include <debug.h>
+#include <list.h>
+#include <stdint.h>
+#include "threads/synch.h"
+#include "threads/thread.h"
+
+/* Maximum number of CPUs supported. */
+#define CPU_MAX 8
+
+/* Run queues of threads in THREAD_READY state on one CPU.
+   There is one FIFO queue per priority level.  Bit N of MASK is
+   set if and only if QUEUES[N] is nonempty, so that the
+   highest-priority ready thread can be found with a single bit
+   scan.
+
+   Under the CFS scheduler, ordinary threads are kept in CFS_TREE
+   instead, ordered by vruntime, and only per-CPU workers use
+   the priority queues.
+
+   EDF real-time threads that have budget left are kept in
+   EDF_TREE, ordered by deadline, under any scheduler, and run
+   ahead of all other threads. */
+struct run_queue
+  {
+    struct spinlock lock;               /* Protects the other members. */
+    struct list queues[PRI_CNT];        /* One queue per priority. */
+    uint64_t mask;                      /* Nonempty queues. */
+    int cnt;                            /* Number of queued threads. */
+    int load_cnt;                       /* Queued threads that count
+                                           toward the MLFQS load. */
+    struct rb_tree cfs_tree;            /* CFS threads, by vruntime. */
+    int64_t min_vruntime;               /* Never-decreasing vruntime floor. */
+    unsigned long cfs_weight;           /* Total weight of CFS_TREE. */
+    struct rb_tree edf_tree;            /* EDF threads, by deadline. */
+  };
+
+/* Per-CPU data area.
+
+   Each CPU schedules the threads on its own run queue.  RUNNING
+   may be read by any CPU with interrupts off.  Everything else
+   in this structure is touched only by its own CPU, with
+   interrupts off. */
+struct cpu
+  {
+    unsigned id;                        /* Index in cpus[]. */
+    unsigned apic_id;                   /* Local APIC ID. */
+    struct run_queue rq;                /* Ready threads. */
+    struct thread *idle_thread;         /* This CPU's idle thread. */
+    struct thread *running;             /* Thread running now. */
+    bool in_external_intr;              /* In an external interrupt? */
+    bool yield_on_return;               /* Yield when it returns? */
+    unsigned thread_ticks;              /* # of timer ticks since last yield. */
+    bool yield_pending;                 /* Readied thread outranks running one. */
+    struct list deferred;               /* Pending deferred work. */
+    struct thread *defer_worker;        /* Runs deferred work. */
+    struct list edf_pending;            /* EDF threads awaiting next period. */
+    unsigned edf_util;                  /* Admitted EDF utilization. */
+    enum cpu_mode mode;                 /* What the CPU is doing now. */
+    uint64_t mode_since;                /* TSC when MODE was last charged. */
+
+    /* Statistics. */
+    long long idle_ticks;               /* # of timer ticks spent idle. */
+    long long kernel_ticks;             /* # of timer ticks in kernel threads. */
+    long long user_ticks;               /* # of timer ticks in user programs. */
+    long long steals;                   /* # of threads pulled while idle. */
+    long long migrations;               /* # of threads moved to this CPU. */
+    uint64_t cycles[CPU_MODE_CNT];      /* Cycles used by threads, by mode. */
+    uint64_t idle_cycles;               /* Cycles spent in the idle thread. */
+  };
+
+extern struct cpu cpus[CPU_MAX];
+extern unsigned cpu_cnt;
+
+void cpu_init (void);
+void cpu_init_data (struct cpu *, unsigned id);
+void cpu_start_aps (void);
+void cpu_ap_main (void) NO_RETURN;
+struct cpu *cpu_current (void);
+void cpu_kick (struct cpu *);
+enum cpu_mode cpu_account (enum cpu_mode);
+
+/* Returns the processor's time-stamp counter, which counts CPU
+   cycles since reset. */
+static inline uint64_t
+rdtsc (void)
+{
+  /* See [IA32-v2b] "RDTSC". */
+  uint64_t tsc;
+  asm volatile ("rdtsc" : "=A" (tsc));
+  return tsc;
+}
+
+#endif /* threads/cpu.h */
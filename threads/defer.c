@@ -0,0 +1,90 @@
+#include "threads/defer.h"
+#include <debug.h>
+#include "threads/cpu.h"
+#include "threads/interrupt.h"
+#include "threads/thread.h"
+
+bool defer_enabled = true;
+
+static thread_func defer_worker;
+
+/* Starts CPU C's deferred-work thread, on C.  Work queued
+   before then is kept and run once the thread starts. */
+void
+defer_start (struct cpu *c) 
+{
+  thread_create_on (c, "deferred", PRI_MAX, defer_worker, NULL);
+}
+
+/* Initializes W to run FUNC(AUX) each time it is scheduled. */
+void
+deferred_work_init (struct deferred_work *w, deferred_func *func, void *aux) 
+{
+  ASSERT (w != NULL);
+  ASSERT (func != NULL);
+
+  w->func = func;
+  w->aux = aux;
+  w->pending = false;
+}
+
+/* Queues W to run on the current CPU's worker thread, unless it
+   is already queued, in which case a single run handles both
+   requests.  May be called from an interrupt handler.  If
+   deferred work is disabled, runs W immediately instead. */
+void
+defer_schedule (struct deferred_work *w) 
+{
+  struct cpu *c;
+  enum intr_level old_level;
+
+  if (!defer_enabled)
+    {
+      w->func (w->aux);
+      return;
+    }
+
+  old_level = intr_disable ();
+  if (!w->pending)
+    {
+      c = cpu_current ();
+      w->pending = true;
+      list_push_back (&c->deferred, &w->elem);
+      if (c->defer_worker != NULL
+          && c->defer_worker->status == THREAD_BLOCKED)
+        {
+          thread_unblock (c->defer_worker);
+          thread_yield_to_higher ();
+        }
+    }
+  intr_set_level (old_level);
+}
+
+/* Deferred-work thread.  Runs every item on its CPU's pending
+   list, in the order queued, then blocks until more arrive.
+   Items queued while a batch runs are picked up in the same
+   batch. */
+static void
+defer_worker (void *aux UNUSED) 
+{
+  struct cpu *c;
+
+  thread_make_worker ();
+
+  intr_disable ();
+  c = cpu_current ();
+  c->defer_worker = thread_current ();
+  for (;;) 
+    {
+      while (!list_empty (&c->deferred))
+        {
+          struct deferred_work *w = list_entry (list_pop_front (&c->deferred),
+                                                struct deferred_work, elem);
+          w->pending = false;
+          intr_enable ();
+          w->func (w->aux);
+          intr_disable ();
+        }
+      thread_block ();
+    }
+}
@@ -0,0 +1,40 @@
+#ifndef THREADS_DEFER_H
+#define THREADS_DEFER_H
+
+#include <list.h>
+#include <stdbool.h>
+
+struct cpu;
+
+/* Deferred work.
+
+   An interrupt handler runs with interrupts off, so anything it
+   does delays every other interrupt.  A handler can instead do
+   only what must happen right away, such as reading a device
+   register, and queue a work item for the rest.  Work items run
+   soon after, in a per-CPU kernel worker thread at PRI_MAX, with
+   interrupts on. */
+
+/* Function run for a deferred work item. */
+typedef void deferred_func (void *aux);
+
+/* A deferred work item. */
+struct deferred_work
+  {
+    struct list_elem elem;      /* Element in a per-CPU pending list. */
+    deferred_func *func;        /* Function to run. */
+    void *aux;                  /* Argument to FUNC. */
+    bool pending;               /* Queued but not yet started? */
+  };
+
+/* If true (default), run work items in the worker thread.  If
+   false, run them immediately in the caller, even in interrupt
+   context, as before deferred work existed.  Controlled by
+   kernel command-line option "-nodefer". */
+extern bool defer_enabled;
+
+void defer_start (struct cpu *);
+void deferred_work_init (struct deferred_work *, deferred_func *, void *aux);
+void defer_schedule (struct deferred_work *);
+
+#endif /* threads/defer.h */
@@ -0,0 +1,92 @@
+#ifndef THREADS_FIXED_POINT_H
+#define THREADS_FIXED_POINT_H
+
+#include <stdint.h>
+
+/* Signed 17.14 fixed-point arithmetic, as used by the
+   multi-level feedback queue scheduler.
+
+   A fixed-point number X represents the real number X / FP_ONE.
+   The kernel does not use floating point, so values such as the
+   load average and each thread's recent CPU usage are kept in
+   this form.  Multiplication and division go through 64-bit
+   intermediates so that they do not overflow. */
+typedef int fixed_point;
+
+/* Number of fractional bits. */
+#define FP_SHIFT 14
+
+/* The fixed-point representation of 1. */
+#define FP_ONE (1 << FP_SHIFT)
+
+/* Converts integer N to fixed point. */
+static inline fixed_point
+fp_from_int (int n)
+{
+  return n * FP_ONE;
+}
+
+/* Converts X to an integer, rounding toward zero. */
+static inline int
+fp_to_int_zero (fixed_point x)
+{
+  return x / FP_ONE;
+}
+
+/* Converts X to an integer, rounding to nearest. */
+static inline int
+fp_to_int_nearest (fixed_point x)
+{
+  return x >= 0 ? (x + FP_ONE / 2) / FP_ONE : (x - FP_ONE / 2) / FP_ONE;
+}
+
+/* Returns X + Y. */
+static inline fixed_point
+fp_add (fixed_point x, fixed_point y)
+{
+  return x + y;
+}
+
+/* Returns X + N, for integer N. */
+static inline fixed_point
+fp_add_int (fixed_point x, int n)
+{
+  return x + n * FP_ONE;
+}
+
+/* Returns X - Y. */
+static inline fixed_point
+fp_sub (fixed_point x, fixed_point y)
+{
+  return x - y;
+}
+
+/* Returns X * Y. */
+static inline fixed_point
+fp_mul (fixed_point x, fixed_point y)
+{
+  return ((int64_t) x) * y / FP_ONE;
+}
+
+/* Returns X * N, for integer N. */
+static inline fixed_point
+fp_mul_int (fixed_point x, int n)
+{
+  return x * n;
+}
+
+/* Returns X / Y. */
+static inline fixed_point
+fp_div (fixed_point x, fixed_point y)
+{
+  return ((int64_t) x) * FP_ONE / y;
+}
+
+/* Returns X / N, for integer N. */
+static inline fixed_point
+fp_div_int (fixed_point x, int n)
+{
+  return x / n;
+}
+
+#endif /* threads/fixed-point.h */
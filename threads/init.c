@@ -15,6 +15,8 @@
 #include "devices/timer.h"
 #include "devices/vga.h"
 #include "devices/rtc.h"
+#include "threads/cpu.h"
+#include "threads/defer.h"
 #include "threads/interrupt.h"
 #include "threads/io.h"
 #include "threads/loader.h"
@@ -22,12 +24,15 @@
 #include "threads/palloc.h"
 #include "threads/pte.h"
 #include "threads/thread.h"
+#include "threads/switch-bench.h"
+#include "threads/trace.h"
 #ifdef USERPROG
 #include "userprog/process.h"
 #include "userprog/exception.h"
 #include "userprog/gdt.h"
 #include "userprog/syscall.h"
 #include "userprog/tss.h"
+#include "tests/userprog/kernel/tests.h"
 #else
 #include "tests/threads/tests.h"
 #endif
@@ -63,6 +68,8 @@ static void paging_init (void);
 static char **read_command_line (void);
 static char **parse_options (char **argv);
 static void run_actions (char **argv);
+static void trace_dump_action (char **argv);
+static void switch_bench_action (char **argv);
 static void usage (void);
 
 #ifdef FILESYS
@@ -117,8 +124,10 @@ main (void)
 
   /* Start thread scheduler and enable interrupts. */
   thread_start ();
+  defer_start (&cpus[0]);
   serial_init_queue ();
   timer_calibrate ();
+  cpu_start_aps ();
 
 #ifdef FILESYS
   /* Initialize file system. */
@@ -256,6 +265,20 @@ parse_options (char **argv)
         random_init (atoi (value));
       else if (!strcmp (name, "-mlfqs"))
         thread_mlfqs = true;
+      else if (!strcmp (name, "-cfs"))
+        thread_cfs = true;
+      else if (!strcmp (name, "-tickless"))
+        timer_tickless = true;
+      else if (!strcmp (name, "-trace"))
+        trace_enabled = true;
+      else if (!strcmp (name, "-nodefer"))
+        defer_enabled = false;
+      else if (!strcmp (name, "-introff"))
+        intr_off_timing = true;
+      else if (!strcmp (name, "-nomagazines"))
+        malloc_magazines = false;
+      else if (!strcmp (name, "-noprezero"))
+        palloc_prezero = false;
 #ifdef USERPROG
       else if (!strcmp (name, "-ul"))
         user_page_limit = atoi (value);
@@ -263,6 +286,8 @@ parse_options (char **argv)
       else
         PANIC ("unknown option `%s' (use -h for help)", name);
     }
+  if (thread_mlfqs && thread_cfs)
+    PANIC ("-mlfqs and -cfs are mutually exclusive");
 
   /* Initialize the random number generator based on the system
      time.  This has no effect if an "-rs" option was specified.
@@ -292,6 +317,33 @@ run_task (char **argv)
   printf ("Execution of '%s' complete.\n", task);
 }
 
+#ifdef USERPROG
+/* Runs the kernel test specified in ARGV[1]. */
+static void
+run_kernel_test (char **argv)
+{
+  const char *test = argv[1];
+  
+  printf ("Executing '%s':\n", test);
+  run_test (test);
+  printf ("Execution of '%s' complete.\n", test);
+}
+#endif
+
+/* Prints the scheduler trace to the console. */
+static void
+trace_dump_action (char **argv UNUSED) 
+{
+  trace_dump ();
+}
+
+/* Runs the context-switch benchmarks. */
+static void
+switch_bench_action (char **argv UNUSED) 
+{
+  switch_bench ();
+}
+
 /* Executes all of the actions specified in ARGV[]
    up to the null pointer sentinel. */
 static void
@@ -309,6 +361,11 @@ run_actions (char **argv)
   static const struct action actions[] = 
     {
       {"run", 2, run_task},
+      {"trace-dump", 1, trace_dump_action},
+      {"switch-bench", 1, switch_bench_action},
+#ifdef USERPROG
+      {"ktest", 2, run_kernel_test},
+#endif
 #ifdef FILESYS
       {"ls", 1, fsutil_ls},
       {"cat", 2, fsutil_cat},
@@ -354,9 +411,12 @@ usage (void)
           "\nAvailable actions:\n"
 #ifdef USERPROG
           "  run 'PROG [ARG...]' Run PROG and wait for it to complete.\n"
+          "  ktest TEST         Run kernel TEST.\n"
 #else
           "  run TEST           Run TEST.\n"
 #endif
+          "  trace-dump         Print the scheduler trace (see -trace).\n"
+          "  switch-bench       Measure context switch costs.\n"
 #ifdef FILESYS
           "  ls                 List files in the root directory.\n"
           "  cat FILE           Print FILE to the console.\n"
@@ -379,6 +439,13 @@ usage (void)
 #endif
           "  -rs=SEED           Set random number seed to SEED.\n"
           "  -mlfqs             Use multi-level feedback queue scheduler.\n"
+          "  -cfs               Use completely fair scheduler.\n"
+          "  -tickless          Stop the timer tick while the CPU is idle.\n"
+          "  -trace             Record scheduler events for trace-dump.\n"
+          "  -nodefer           Run deferred work in interrupt handlers.\n"
+          "  -introff           Time the longest span with interrupts off.\n"
+          "  -nomagazines       Bypass malloc's per-CPU magazines.\n"
+          "  -noprezero         Zero pages on demand, not when idle.\n"
 #ifdef USERPROG
           "  -ul=COUNT          Limit user memory to COUNT pages.\n"
 #endif
@@ -3,11 +3,14 @@
 #include <inttypes.h>
 #include <stdint.h>
 #include <stdio.h>
+#include "threads/cpu.h"
 #include "threads/flags.h"
 #include "threads/intr-stubs.h"
 #include "threads/io.h"
 #include "threads/thread.h"
+#include "threads/synch.h"
 #include "threads/vaddr.h"
+#include "devices/lapic.h"
 #include "devices/timer.h"
 
 /* Programmable Interrupt Controller (PIC) registers.
@@ -43,9 +46,35 @@ static unsigned int unexpected_cnt[INTR_CNT];
    pre-empted.  Handlers for external interrupts also may not
    sleep, although they may invoke intr_yield_on_return() to
    request that a new process be scheduled just before the
-   interrupt returns. */
-static bool in_external_intr;   /* Are we processing an external interrupt? */
-static bool yield_on_return;    /* Should we yield on interrupt return? */
+   interrupt returns.  Each CPU tracks whether it is processing
+   an external interrupt in its struct cpu. */
+
+/* With more than one CPU online, turning interrupts off on one
+   CPU no longer keeps the others out, yet much of the kernel
+   still relies on it for mutual exclusion.  So once
+   intr_lock_start() is called, a CPU holds INTR_LOCK whenever it
+   has interrupts off, acquiring it as interrupts go off and
+   releasing it just before they come back on.  The lock belongs
+   to the CPU, not to a thread: a thread that switches to another
+   with interrupts off passes it on, and the other thread releases
+   it when it turns interrupts on. */
+static struct spinlock intr_lock;
+static bool intr_locking;       /* Is INTR_LOCK in use? */
+
+/* Interrupts-off accounting, in time-stamp counter cycles.
+   INTR_OFF_SINCE is when interrupts were last turned off, or 0
+   if that has not been observed yet (as during boot).  Once more
+   than one CPU is online, only the holder of INTR_LOCK updates
+   these, so they measure the longest span any CPU kept the
+   others out.  Only done if INTR_OFF_TIMING is set, because
+   reading the time-stamp counter at every transition is not
+   free. */
+bool intr_off_timing;
+static uint64_t intr_off_since;
+static uint64_t intr_off_max;   /* Longest span with interrupts off. */
+
+static void intr_off_begin (void);
+static void intr_off_end (void);
 
 /* Programmable Interrupt Controller helpers. */
 static void pic_init (void);
@@ -90,12 +119,24 @@ intr_enable (void)
   enum intr_level old_level = intr_get_level ();
   ASSERT (!intr_context ());
 
+  if (old_level == INTR_OFF)
+    {
+      if (__builtin_expect (intr_off_timing, 0))
+        intr_off_end ();
+      if (intr_locking)
+        spinlock_release (&intr_lock);
+    }
+
   /* Enable interrupts by setting the interrupt flag.
 
      See [IA32-v2b] "STI" and [IA32-v3a] 5.8.1 "Masking Maskable
      Hardware Interrupts". */
   asm volatile ("sti");
 
+  /* Threads woken while interrupts were off may outrank us. */
+  if (old_level == INTR_OFF)
+    thread_yield_pending ();
+
   return old_level;
 }
 
@@ -110,8 +151,100 @@ intr_disable (void)
      Hardware Interrupts". */
   asm volatile ("cli" : : : "memory");
 
+  if (old_level == INTR_ON)
+    {
+      if (intr_locking)
+        spinlock_acquire (&intr_lock);
+      if (__builtin_expect (intr_off_timing, 0))
+        intr_off_begin ();
+    }
+
   return old_level;
 }
+
+/* Enables interrupts and waits for the next one, which is
+   handled before this function returns.  Interrupts must be
+   off.  Used by the idle thread. */
+void
+intr_halt (void) 
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  if (__builtin_expect (intr_off_timing, 0))
+    intr_off_end ();
+  if (intr_locking)
+    spinlock_release (&intr_lock);
+
+  /* The `sti' instruction disables interrupts until the
+     completion of the next instruction, so these two
+     instructions are executed atomically.  This atomicity is
+     important; otherwise, an interrupt could be handled between
+     re-enabling interrupts and waiting for the next one to
+     occur, wasting as much as one clock tick worth of time.
+
+     See [IA32-v2a] "HLT", [IA32-v2b] "STI", and [IA32-v3a]
+     7.11.1 "HLT Instruction". */
+  asm volatile ("sti; hlt" : : : "memory");
+}
+
+/* Makes every CPU hold the interrupt lock while it has
+   interrupts off, from now on.  Called on the boot processor,
+   with interrupts on, before the first application processor
+   starts. */
+void
+intr_lock_start (void) 
+{
+  ASSERT (intr_get_level () == INTR_ON);
+  ASSERT (!intr_locking);
+
+  spinlock_init (&intr_lock);
+  spinlock_set_name (&intr_lock, "interrupts");
+  barrier ();
+  intr_locking = true;
+}
+
+/* Notes that interrupts were just turned off. */
+static void
+intr_off_begin (void) 
+{
+  intr_off_since = rdtsc ();
+}
+
+/* Notes that interrupts are about to be turned on, and updates
+   the longest interrupts-off span seen. */
+static void
+intr_off_end (void) 
+{
+  if (intr_off_since != 0)
+    {
+      uint64_t span = rdtsc () - intr_off_since;
+      if (span > intr_off_max)
+        intr_off_max = span;
+    }
+}
+
+/* Returns the longest span with interrupts off since boot or
+   since the last call, in time-stamp counter cycles, and starts
+   over.  Always returns 0 unless INTR_OFF_TIMING is set. */
+uint64_t
+intr_off_max_reset (void) 
+{
+  enum intr_level old_level = intr_disable ();
+  uint64_t max = intr_off_max;
+
+  intr_off_max = 0;
+  intr_set_level (old_level);
+  return max;
+}
+
+/* Prints interrupt statistics. */
+void
+intr_print_stats (void) 
+{
+  if (intr_off_timing)
+    printf ("Interrupts: longest interrupts-off span %"PRIu64" cycles\n",
+            intr_off_max);
+}
 
 /* Initializes the interrupt system. */
 void
@@ -157,6 +290,25 @@ intr_init (void)
   intr_names[19] = "#XF SIMD Floating-Point Exception";
 }
 
+/* Initializes interrupt handling on an application processor,
+   which shares the boot processor's IDT.  The processor starts
+   out with interrupts off, so it acquires the interrupt lock. */
+void
+intr_init_ap (void)
+{
+  uint64_t idtr_operand;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+  ASSERT (intr_locking);
+
+  idtr_operand = make_idtr_operand (sizeof idt - 1, idt);
+  asm volatile ("lidt %0" : : "m" (idtr_operand));
+
+  spinlock_acquire (&intr_lock);
+  if (intr_off_timing)
+    intr_off_begin ();
+}
+
 /* Registers interrupt VEC_NO to invoke HANDLER with descriptor
    privilege level DPL.  Names the interrupt NAME for debugging
    purposes.  The interrupt handler will be invoked with
@@ -203,15 +355,28 @@ intr_register_int (uint8_t vec_no, int dpl, enum intr_level level,
                    intr_handler_func *handler, const char *name)
 {
   ASSERT (vec_no < 0x20 || vec_no > 0x2f);
+  ASSERT (vec_no < IPI_FIRST);
   register_handler (vec_no, dpl, level, handler, name);
 }
 
+/* Registers inter-processor interrupt VEC_NO, which one CPU
+   sends another with lapic_send_ipi(), to invoke HANDLER, which
+   is named NAME for debugging purposes.  IPIs are handled like
+   external interrupts, with interrupts disabled. */
+void
+intr_register_ipi (uint8_t vec_no, intr_handler_func *handler,
+                   const char *name) 
+{
+  ASSERT (vec_no >= IPI_FIRST && vec_no <= IPI_LAST);
+  register_handler (vec_no, 0, INTR_OFF, handler, name);
+}
+
 /* Returns true during processing of an external interrupt
    and false at all other times. */
 bool
 intr_context (void) 
 {
-  return in_external_intr;
+  return cpu_cnt > 0 && cpu_current ()->in_external_intr;
 }
 
 /* During processing of an external interrupt, directs the
@@ -222,7 +387,7 @@ void
 intr_yield_on_return (void) 
 {
   ASSERT (intr_context ());
-  yield_on_return = true;
+  cpu_current ()->yield_on_return = true;
 }
 
 /* 8259A Programmable Interrupt Controller. */
@@ -258,6 +423,34 @@ pic_init (void)
   outb (PIC1_DATA, 0x00);
 }
 
+/* Returns true if external interrupt VEC_NO has been raised but
+   not yet delivered, according to its PIC's interrupt request
+   register.  Interrupts must be off. */
+bool
+intr_ext_pending (uint8_t vec_no) 
+{
+  int irq = vec_no - 0x20;
+  uint8_t irr;
+
+  ASSERT (vec_no >= 0x20 && vec_no < 0x30);
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  /* OCW3: make the next read of the control port return the
+     IRR. */
+  if (irq < 8)
+    {
+      outb (PIC0_CTRL, 0x0a);
+      irr = inb (PIC0_CTRL);
+    }
+  else
+    {
+      outb (PIC1_CTRL, 0x0a);
+      irr = inb (PIC1_CTRL);
+      irq -= 8;
+    }
+  return (irr & (1 << irq)) != 0;
+}
+
 /* Sends an end-of-interrupt signal to the PIC for the given IRQ.
    If we don't acknowledge the IRQ, it will never be delivered to
    us again, so this is important.  */
@@ -344,28 +537,57 @@ make_idtr_operand (uint16_t limit, void *base)
 void
 intr_handler (struct intr_frame *frame) 
 {
-  bool external;
+  bool external, ipi;
   intr_handler_func *handler;
+  enum cpu_mode interrupted;
+  struct cpu *c;
+
+  /* Interrupts were just turned off, unless the gate left them
+     on or they were off already. */
+  if ((frame->eflags & FLAG_IF) && intr_get_level () == INTR_OFF)
+    {
+      if (intr_locking)
+        spinlock_acquire (&intr_lock);
+      if (intr_off_timing)
+        intr_off_begin ();
+    }
 
   /* External interrupts are special.
      We only handle one at a time (so interrupts must be off)
-     and they need to be acknowledged on the PIC (see below).
+     and they need to be acknowledged on the PIC, or for IPIs on
+     the local APIC (see below).
      An external interrupt handler cannot sleep. */
-  external = frame->vec_no >= 0x20 && frame->vec_no < 0x30;
+  ipi = frame->vec_no >= IPI_FIRST && frame->vec_no <= IPI_LAST;
+  external = (frame->vec_no >= 0x20 && frame->vec_no < 0x30) || ipi;
+  c = cpu_current ();
+
+  /* Charge the cycles up to here to the interrupted code.  User
+     programs are entered through intr_exit without passing
+     through here, so check the frame to tell whether we came
+     from user mode. */
+  if ((frame->cs & 3) == 3)
+    c->mode = CPU_MODE_USER;
+  interrupted = cpu_account (external ? CPU_MODE_INTR : CPU_MODE_KERNEL);
+
   if (external) 
     {
       ASSERT (intr_get_level () == INTR_OFF);
       ASSERT (!intr_context ());
 
-      in_external_intr = true;
-      yield_on_return = false;
+      c->in_external_intr = true;
+      c->yield_on_return = false;
+
+      /* Catch up on any ticks skipped while the CPU was idle. */
+      if (!ipi)
+        timer_leave_tickless ();
     }
 
   /* Invoke the interrupt's handler. */
   handler = intr_handlers[frame->vec_no];
   if (handler != NULL)
     handler (frame);
-  else if (frame->vec_no == 0x27 || frame->vec_no == 0x2f)
+  else if (frame->vec_no == 0x27 || frame->vec_no == 0x2f
+           || frame->vec_no == LAPIC_SPURIOUS)
     {
       /* There is no handler, but this interrupt can trigger
          spuriously due to a hardware fault or hardware race
@@ -380,12 +602,32 @@ intr_handler (struct intr_frame *frame)
       ASSERT (intr_get_level () == INTR_OFF);
       ASSERT (intr_context ());
 
-      in_external_intr = false;
-      pic_end_of_interrupt (frame->vec_no); 
+      c->in_external_intr = false;
+      if (ipi)
+        lapic_eoi ();
+      else
+        pic_end_of_interrupt (frame->vec_no); 
 
-      if (yield_on_return) 
+      if (c->yield_on_return) 
         thread_yield (); 
     }
+  else if (frame->eflags & FLAG_IF)
+    {
+      /* The interrupted code had interrupts on, so it can be
+         preempted by a thread this handler woke. */
+      thread_yield_pending ();
+    }
+
+  cpu_account (interrupted);
+
+  /* Returning from the interrupt turns interrupts back on. */
+  if ((frame->eflags & FLAG_IF) && intr_get_level () == INTR_OFF)
+    {
+      if (intr_off_timing)
+        intr_off_end ();
+      if (intr_locking)
+        spinlock_release (&intr_lock);
+    }
 }
 
 /* Handles an unexpected interrupt with interrupt frame F.  An
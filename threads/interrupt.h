@@ -15,6 +15,8 @@ enum intr_level intr_get_level (void);
 enum intr_level intr_set_level (enum intr_level);
 enum intr_level intr_enable (void);
 enum intr_level intr_disable (void);
+void intr_halt (void);
+void intr_lock_start (void);
 
 /* Interrupt stack frame. */
 struct intr_frame
@@ -58,13 +60,22 @@ struct intr_frame
 typedef void intr_handler_func (struct intr_frame *);
 
 void intr_init (void);
+void intr_init_ap (void);
 void intr_register_ext (uint8_t vec, intr_handler_func *, const char *name);
+void intr_register_ipi (uint8_t vec, intr_handler_func *, const char *name);
 void intr_register_int (uint8_t vec, int dpl, enum intr_level,
                         intr_handler_func *, const char *name);
 bool intr_context (void);
 void intr_yield_on_return (void);
+bool intr_ext_pending (uint8_t vec);
+
+/* Whether to time spans with interrupts off.  Controlled by
+   kernel command-line option "-introff". */
+extern bool intr_off_timing;
 
 void intr_dump_frame (const struct intr_frame *);
+uint64_t intr_off_max_reset (void);
+void intr_print_stats (void);
 const char *intr_name (uint8_t vec);
 
 #endif /* threads/interrupt.h */
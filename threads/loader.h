@@ -8,6 +8,12 @@
 /* Physical address of kernel base. */
 #define LOADER_KERN_BASE 0x20000       /* 128 kB. */
 
+/* Physical address to which the kernel copies the application
+   processor startup code in ap-start.S.  Must be page-aligned
+   and below 1 MB, and must not overlap the loader, whose
+   command-line arguments are still in use. */
+#define LOADER_AP_START 0x8000         /* 32 kB. */
+
 /* Kernel virtual address at which all physical memory is mapped.
    Must be aligned on a 4 MB boundary. */
 #define LOADER_PHYS_BASE 0xc0000000     /* 3 GB. */
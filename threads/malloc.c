@@ -5,17 +5,22 @@
 #include <stdint.h>
 #include <stdio.h>
 #include <string.h>
+#include "threads/cpu.h"
+#include "threads/interrupt.h"
 #include "threads/palloc.h"
 #include "threads/synch.h"
 #include "threads/vaddr.h"
 
 /* A simple implementation of malloc().
 
-   The size of each request, in bytes, is rounded up to a power
-   of 2 and assigned to the "descriptor" that manages blocks of
-   that size.  The descriptor keeps a list of free blocks.  If
-   the free list is nonempty, one of its blocks is used to
-   satisfy the request.
+   The size of each request, in bytes, is rounded up to the
+   nearest size class and assigned to the "descriptor" that
+   manages blocks of that size.  The classes are the powers of 2
+   from 16 to 1024 bytes and, halfway between each pair, 1.5
+   times the smaller one, so that rounding up wastes less than a
+   third of a block rather than up to half of it.  The descriptor
+   keeps a list of free blocks.  If the free list is nonempty, one
+   of its blocks is used to satisfy the request.
 
    Otherwise, a new page of memory, called an "arena", is
    obtained from the page allocator (if none is available,
@@ -32,7 +37,22 @@
    because they're too big to fit in a single page with a
    descriptor.  We handle those by allocating contiguous pages
    with the page allocator and sticking the allocation size at
-   the beginning of the allocated block's arena header. */
+   the beginning of the allocated block's arena header.  A big
+   block that realloc() grows takes the pages that follow it, if
+   they are free, instead of moving.
+
+   In front of the descriptors sits a per-CPU cache of free
+   blocks, a "magazine" for each descriptor, after Bonwick and
+   Adams, "Magazines and Vmem", USENIX 2001.  malloc() and free()
+   pop and push blocks in the running CPU's magazine with
+   interrupts off and without taking the descriptor's lock.
+   Only when the magazine is empty, or full, do they take the
+   lock, to move MAG_BATCH blocks between it and the
+   descriptor's free list, which serves as the shared depot.
+   Blocks in a magazine count as in use as far as their arena is
+   concerned. */
+
+bool malloc_magazines = true;
 
 /* Descriptor. */
 struct desc
@@ -41,6 +61,7 @@ struct desc
     size_t blocks_per_arena;    /* Number of blocks in an arena. */
     struct list free_list;      /* List of free blocks. */
     struct lock lock;           /* Lock. */
+    char name[16];              /* Lock name, for lock_print_stats(). */
   };
 
 /* Magic number for detecting arena corruption. */
@@ -60,27 +81,71 @@ struct block
     struct list_elem free_elem; /* Free list element. */
   };
 
+/* Block sizes of the descriptors, in increasing order. */
+static const size_t class_sizes[] =
+  {16, 24, 32, 48, 64, 96, 128, 192, 256, 384, 512, 768, 1024};
+#define CLASS_CNT (sizeof class_sizes / sizeof *class_sizes)
+#define CLASS_MAX 1024          /* Largest class size. */
+#define CLASS_GRAIN 8           /* Class sizes are multiples of this. */
+
 /* Our set of descriptors. */
-static struct desc descs[10];   /* Descriptors. */
-static size_t desc_cnt;         /* Number of descriptors. */
+static struct desc descs[CLASS_CNT];    /* Descriptors. */
+static size_t desc_cnt;                 /* Number of descriptors. */
+
+/* Maps DIV_ROUND_UP (SIZE, CLASS_GRAIN), for SIZE up to
+   CLASS_MAX, to the index in descs[] of the smallest descriptor
+   for a SIZE-byte request. */
+static uint8_t size_to_desc[CLASS_MAX / CLASS_GRAIN + 1];
+
+/* Per-CPU magazines. */
+#define MAG_ROUNDS 16           /* Capacity of a magazine. */
+#define MAG_BATCH 8             /* Blocks moved to or from the depot. */
+
+/* A CPU's cache of free blocks for one descriptor, used as a
+   stack. */
+struct magazine
+  {
+    size_t cnt;                         /* Number of blocks. */
+    struct block *rounds[MAG_ROUNDS];   /* Blocks, most recent last. */
+  };
+
+/* Magazines for each CPU and descriptor. */
+static struct magazine magazines[CPU_MAX][sizeof descs / sizeof *descs];
 
 static struct arena *block_to_arena (struct block *);
 static struct block *arena_to_block (struct arena *, size_t idx);
+static struct desc *size_desc (size_t size);
+static struct magazine *cpu_magazine (struct desc *);
+static void magazine_fill (struct desc *, struct block **, size_t cnt);
+static size_t depot_get (struct desc *, struct block **, size_t cnt);
+static void depot_put (struct desc *, struct block **, size_t cnt);
 
 /* Initializes the malloc() descriptors. */
 void
 malloc_init (void) 
 {
-  size_t block_size;
+  size_t i;
 
-  for (block_size = 16; block_size < PGSIZE / 2; block_size *= 2)
+  for (i = 0; i < CLASS_CNT; i++)
     {
+      size_t block_size = class_sizes[i];
       struct desc *d = &descs[desc_cnt++];
-      ASSERT (desc_cnt <= sizeof descs / sizeof *descs);
+
+      ASSERT (block_size % CLASS_GRAIN == 0 && block_size <= CLASS_MAX);
       d->block_size = block_size;
       d->blocks_per_arena = (PGSIZE - sizeof (struct arena)) / block_size;
       list_init (&d->free_list);
-      lock_init (&d->lock);
+      lock_init_adaptive (&d->lock);
+      snprintf (d->name, sizeof d->name, "malloc %zu", block_size);
+      lock_set_name (&d->lock, d->name);
+    }
+
+  for (i = 0; i <= CLASS_MAX / CLASS_GRAIN; i++)
+    {
+      size_t d = 0;
+      while (descs[d].block_size < i * CLASS_GRAIN)
+        d++;
+      size_to_desc[i] = d;
     }
 }
 
@@ -92,6 +157,8 @@ malloc (size_t size)
   struct desc *d;
   struct block *b;
   struct arena *a;
+  struct block *batch[MAG_BATCH];
+  size_t cnt;
 
   /* A null pointer satisfies a request for 0 bytes. */
   if (size == 0)
@@ -99,10 +166,8 @@ malloc (size_t size)
 
   /* Find the smallest descriptor that satisfies a SIZE-byte
      request. */
-  for (d = descs; d < descs + desc_cnt; d++)
-    if (d->block_size >= size)
-      break;
-  if (d == descs + desc_cnt) 
+  d = size_desc (size);
+  if (d == NULL) 
     {
       /* SIZE is too big for any descriptor.
          Allocate enough pages to hold SIZE plus an arena. */
@@ -119,38 +184,28 @@ malloc (size_t size)
       return a + 1;
     }
 
-  lock_acquire (&d->lock);
-
-  /* If the free list is empty, create a new arena. */
-  if (list_empty (&d->free_list))
+  /* Fast path: take a block from this CPU's magazine. */
+  if (malloc_magazines)
     {
-      size_t i;
-
-      /* Allocate a page. */
-      a = palloc_get_page (0);
-      if (a == NULL) 
-        {
-          lock_release (&d->lock);
-          return NULL; 
-        }
+      enum intr_level old_level = intr_disable ();
+      struct magazine *m = cpu_magazine (d);
 
-      /* Initialize arena and add its blocks to the free list. */
-      a->magic = ARENA_MAGIC;
-      a->desc = d;
-      a->free_cnt = d->blocks_per_arena;
-      for (i = 0; i < d->blocks_per_arena; i++) 
-        {
-          struct block *b = arena_to_block (a, i);
-          list_push_back (&d->free_list, &b->free_elem);
-        }
+      b = m->cnt > 0 ? m->rounds[--m->cnt] : NULL;
+      intr_set_level (old_level);
+      if (b != NULL)
+        return b;
     }
 
-  /* Get a block from free list and return it. */
-  b = list_entry (list_pop_front (&d->free_list), struct block, free_elem);
-  a = block_to_arena (b);
-  a->free_cnt--;
+  /* Slow path: get a batch of blocks from the descriptor, return
+     the first, and put the rest in the magazine. */
+  lock_acquire (&d->lock);
+  cnt = depot_get (d, batch, malloc_magazines ? MAG_BATCH : 1);
   lock_release (&d->lock);
-  return b;
+
+  if (cnt == 0)
+    return NULL;
+  magazine_fill (d, batch + 1, cnt - 1);
+  return batch[0];
 }
 
 /* Allocates and return A times B bytes initialized to zeroes.
@@ -174,9 +229,11 @@ calloc (size_t a, size_t b)
   return p;
 }
 
-/* Returns the number of bytes allocated for BLOCK. */
-static size_t
-block_size (void *block) 
+/* Returns the number of bytes allocated for BLOCK, which must
+   have been obtained from malloc(), calloc(), or realloc().  This
+   may be more than was requested. */
+size_t
+malloc_usable_size (void *block) 
 {
   struct block *b = block;
   struct arena *a = block_to_arena (b);
@@ -190,7 +247,13 @@ block_size (void *block)
    If successful, returns the new block; on failure, returns a
    null pointer.
    A call with null OLD_BLOCK is equivalent to malloc(NEW_SIZE).
-   A call with zero NEW_SIZE is equivalent to free(OLD_BLOCK). */
+   A call with zero NEW_SIZE is equivalent to free(OLD_BLOCK).
+
+   The block stays where it is if NEW_SIZE falls in its current
+   size class, or if it is a big block and NEW_SIZE is still too
+   big for any descriptor: a big block shrinks by freeing its
+   tail pages and grows by taking the pages that follow it, if
+   they are free. */
 void *
 realloc (void *old_block, size_t new_size) 
 {
@@ -201,10 +264,35 @@ realloc (void *old_block, size_t new_size)
     }
   else 
     {
-      void *new_block = malloc (new_size);
+      void *new_block;
+
+      if (old_block != NULL)
+        {
+          struct arena *a = block_to_arena (old_block);
+          struct desc *d = size_desc (new_size);
+
+          if (a->desc != NULL && a->desc == d)
+            return old_block;
+          if (a->desc == NULL && d == NULL)
+            {
+              size_t page_cnt = DIV_ROUND_UP (new_size + sizeof *a, PGSIZE);
+
+              if (page_cnt < a->free_cnt)
+                palloc_free_multiple ((uint8_t *) a + page_cnt * PGSIZE,
+                                      a->free_cnt - page_cnt);
+              if (page_cnt <= a->free_cnt
+                  || palloc_grow (a, a->free_cnt, page_cnt))
+                {
+                  a->free_cnt = page_cnt;
+                  return old_block;
+                }
+            }
+        }
+
+      new_block = malloc (new_size);
       if (old_block != NULL && new_block != NULL)
         {
-          size_t old_size = block_size (old_block);
+          size_t old_size = malloc_usable_size (old_block);
           size_t min_size = new_size < old_size ? new_size : old_size;
           memcpy (new_block, old_block, min_size);
           free (old_block);
@@ -233,25 +321,38 @@ free (void *p)
           memset (b, 0xcc, d->block_size);
 #endif
   
-          lock_acquire (&d->lock);
-
-          /* Add block to free list. */
-          list_push_front (&d->free_list, &b->free_elem);
-
-          /* If the arena is now entirely unused, free it. */
-          if (++a->free_cnt >= d->blocks_per_arena) 
+          if (malloc_magazines)
             {
-              size_t i;
+              enum intr_level old_level = intr_disable ();
+              struct magazine *m = cpu_magazine (d);
+              struct block *batch[MAG_BATCH];
 
-              ASSERT (a->free_cnt == d->blocks_per_arena);
-              for (i = 0; i < d->blocks_per_arena; i++) 
+              /* Fast path: put the block in this CPU's
+                 magazine. */
+              if (m->cnt < MAG_ROUNDS)
                 {
-                  struct block *b = arena_to_block (a, i);
-                  list_remove (&b->free_elem);
+                  m->rounds[m->cnt++] = b;
+                  intr_set_level (old_level);
+                  return;
                 }
-              palloc_free_page (a);
+
+              /* Slow path: the magazine is full, so give its
+                 oldest blocks back to the descriptor. */
+              memcpy (batch, m->rounds, sizeof batch);
+              memmove (m->rounds, m->rounds + MAG_BATCH,
+                       (MAG_ROUNDS - MAG_BATCH) * sizeof *m->rounds);
+              m->cnt -= MAG_BATCH;
+              m->rounds[m->cnt++] = b;
+              intr_set_level (old_level);
+
+              lock_acquire (&d->lock);
+              depot_put (d, batch, MAG_BATCH);
+              lock_release (&d->lock);
+              return;
             }
 
+          lock_acquire (&d->lock);
+          depot_put (d, &b, 1);
           lock_release (&d->lock);
         }
       else
@@ -281,6 +382,128 @@ block_to_arena (struct block *b)
   return a;
 }
 
+/* Returns the running CPU's magazine for descriptor D.
+   Interrupts must be off. */
+static struct magazine *
+cpu_magazine (struct desc *d) 
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+  return &magazines[cpu_current ()->id][d - descs];
+}
+
+/* Puts the CNT blocks in BLOCKS, from descriptor D, in the
+   running CPU's magazine for D.  Any that do not fit go back to
+   D. */
+static void
+magazine_fill (struct desc *d, struct block **blocks, size_t cnt) 
+{
+  enum intr_level old_level = intr_disable ();
+  struct magazine *m = cpu_magazine (d);
+
+  while (cnt > 0 && m->cnt < MAG_ROUNDS)
+    m->rounds[m->cnt++] = blocks[--cnt];
+  intr_set_level (old_level);
+
+  if (cnt > 0)
+    {
+      lock_acquire (&d->lock);
+      depot_put (d, blocks, cnt);
+      lock_release (&d->lock);
+    }
+}
+
+/* Takes up to CNT blocks from descriptor D's free list, creating
+   new arenas as needed, and stores them in BLOCKS.  Returns the
+   number of blocks taken, which is less than CNT only if memory
+   ran out.  D's lock must be held. */
+static size_t
+depot_get (struct desc *d, struct block **blocks, size_t cnt) 
+{
+  size_t taken;
+
+  ASSERT (lock_held_by_current_thread (&d->lock));
+
+  for (taken = 0; taken < cnt; taken++)
+    {
+      struct block *b;
+      struct arena *a;
+
+      /* If the free list is empty, create a new arena. */
+      if (list_empty (&d->free_list))
+        {
+          size_t i;
+
+          /* Allocate a page. */
+          a = palloc_get_page (0);
+          if (a == NULL) 
+            break;
+
+          /* Initialize arena and add its blocks to the free
+             list. */
+          a->magic = ARENA_MAGIC;
+          a->desc = d;
+          a->free_cnt = d->blocks_per_arena;
+          for (i = 0; i < d->blocks_per_arena; i++) 
+            {
+              struct block *b = arena_to_block (a, i);
+              list_push_back (&d->free_list, &b->free_elem);
+            }
+        }
+
+      /* Get a block from free list. */
+      b = list_entry (list_pop_front (&d->free_list), struct block,
+                      free_elem);
+      a = block_to_arena (b);
+      a->free_cnt--;
+      blocks[taken] = b;
+    }
+  return taken;
+}
+
+/* Returns the CNT blocks in BLOCKS to descriptor D's free list,
+   freeing any arena that is left entirely unused.  D's lock must
+   be held. */
+static void
+depot_put (struct desc *d, struct block **blocks, size_t cnt) 
+{
+  size_t i;
+
+  ASSERT (lock_held_by_current_thread (&d->lock));
+
+  for (i = 0; i < cnt; i++)
+    {
+      struct block *b = blocks[i];
+      struct arena *a = block_to_arena (b);
+
+      /* Add block to free list. */
+      list_push_front (&d->free_list, &b->free_elem);
+
+      /* If the arena is now entirely unused, free it. */
+      if (++a->free_cnt >= d->blocks_per_arena) 
+        {
+          size_t j;
+
+          ASSERT (a->free_cnt == d->blocks_per_arena);
+          for (j = 0; j < d->blocks_per_arena; j++) 
+            {
+              struct block *b = arena_to_block (a, j);
+              list_remove (&b->free_elem);
+            }
+          palloc_free_page (a);
+        }
+    }
+}
+
+/* Returns the smallest descriptor whose blocks hold SIZE bytes,
+   or a null pointer if SIZE is too big for any descriptor. */
+static struct desc *
+size_desc (size_t size) 
+{
+  if (size > CLASS_MAX)
+    return NULL;
+  return &descs[size_to_desc[DIV_ROUND_UP (size, CLASS_GRAIN)]];
+}
+
 /* Returns the (IDX - 1)'th block within arena A. */
 static struct block *
 arena_to_block (struct arena *a, size_t idx) 
@@ -2,12 +2,20 @@
 #define THREADS_MALLOC_H
 
 #include <debug.h>
+#include <stdbool.h>
 #include <stddef.h>
 
+/* If true (default), malloc() and free() go through per-CPU
+   magazines of free blocks.  If false, every call takes its
+   descriptor's lock.  Controlled by kernel command-line option
+   "-nomagazines". */
+extern bool malloc_magazines;
+
 void malloc_init (void);
 void *malloc (size_t) __attribute__ ((malloc));
 void *calloc (size_t, size_t) __attribute__ ((malloc));
 void *realloc (void *, size_t);
 void free (void *);
+size_t malloc_usable_size (void *);
 
 #endif /* threads/malloc.h */
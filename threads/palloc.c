@@ -1,12 +1,13 @@
 #include "threads/palloc.h"
-#include <bitmap.h>
 #include <debug.h>
 #include <inttypes.h>
+#include <list.h>
 #include <round.h>
 #include <stddef.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <string.h>
+#include "threads/interrupt.h"
 #include "threads/loader.h"
 #include "threads/synch.h"
 #include "threads/vaddr.h"
@@ -23,14 +24,70 @@
 
    By default, half of system RAM is given to the kernel pool and
    half to the user pool.  That should be huge overkill for the
-   kernel pool, but that's just fine for demonstration purposes. */
+   kernel pool, but that's just fine for demonstration purposes.
+
+   Each pool is a binary buddy allocator.  Free pages are kept in
+   blocks of 2**ORDER pages, for ORDER from 0 to ORDER_CNT - 1,
+   each aligned, relative to the start of the pool, on a multiple
+   of its size.  A block of order ORDER and the block next to it
+   that together would form an aligned block of order ORDER + 1
+   are "buddies".  Allocation takes the smallest free block that
+   is big enough, splitting it in halves as needed, and freeing a
+   block merges it with its buddy for as long as the buddy is
+   free too.  Both take O(lg n) time in the size of the pool.
+
+   A request for a number of pages that is not a power of 2 is
+   served from the next larger block, and the pages beyond the
+   request are freed again at once.  A page run may be freed
+   piecemeal, or several runs at once, as long as every page in
+   it is allocated.
+
+   Each free block keeps its list element in its own first page.
+   A byte per page, at the start of the pool, records the order
+   of the free block that begins at that page, if any.
+
+   Each pool also keeps a stack of free pages that are already
+   filled with zeros, for single-page PAL_ZERO requests, so that
+   thread creation and page-table growth do not clear a page on
+   the spot.  The idle thread refills it: once it drops below
+   ZERO_LOW pages, idle CPUs take pages off the free lists and
+   zero them until it holds ZERO_HIGH pages, or a quarter of the
+   pool's free pages, whichever is less.  The pages in it still
+   count as free, and are given back to the free lists if an
+   allocation fails without them. */
+
+/* If true (default), keep pools of pre-zeroed pages. */
+bool palloc_prezero = true;
+
+/* Number of block sizes.  Enough for a pool of 4 GB. */
+#define ORDER_CNT 21
+
+/* Watermarks for each pool's pre-zeroed pages. */
+#define ZERO_LOW 16             /* Start refilling below this. */
+#define ZERO_HIGH 64            /* Stop refilling at this. */
 
 /* A memory pool. */
 struct pool
   {
-    struct lock lock;                   /* Mutual exclusion. */
-    struct bitmap *used_map;            /* Bitmap of free pages. */
+    struct spinlock lock;               /* Mutual exclusion. */
     uint8_t *base;                      /* Base of pool. */
+    size_t page_cnt;                    /* Number of pages in pool. */
+    size_t free_cnt;                    /* Number of free pages. */
+    uint8_t *free_order;                /* Per page: 1 + order of the free
+                                           block starting there, or 0. */
+    struct list free_lists[ORDER_CNT];  /* Free blocks, by order. */
+    uint32_t free_mask;                 /* Bit ORDER set if
+                                           free_lists[ORDER] is nonempty. */
+
+    /* Pre-zeroed pages. */
+    void *zeroed[ZERO_HIGH];            /* Free pages filled with zeros. */
+    size_t zeroed_cnt;                  /* Number of pages in zeroed[]. */
+    size_t zeroing_cnt;                 /* Pages being zeroed for it. */
+    bool refilling;                     /* Refilling up to ZERO_HIGH? */
+    unsigned long long zero_hits;       /* PAL_ZERO requests served
+                                           from zeroed[]. */
+    unsigned long long zero_misses;     /* PAL_ZERO requests zeroed on
+                                           the spot. */
   };
 
 /* Two pools: one for kernel data, one for user pages. */
@@ -39,6 +96,18 @@ static struct pool kernel_pool, user_pool;
 static void init_pool (struct pool *, void *base, size_t page_cnt,
                        const char *name);
 static bool page_from_pool (const struct pool *, void *page);
+static void remove_block (struct pool *, size_t page_idx, int order);
+static size_t alloc_block (struct pool *, int order);
+static void *alloc_run (struct pool *, size_t page_cnt, int order);
+static void *pop_zeroed (struct pool *);
+static void release_zeroed (struct pool *);
+static bool wants_zeroed (const struct pool *);
+static bool zero_pool_page (struct pool *);
+static size_t find_free_block (const struct pool *, size_t page_idx,
+                               int *order);
+static void free_block (struct pool *, size_t page_idx, int order);
+static void free_run (struct pool *, size_t page_idx, size_t page_cnt);
+static void print_pool_stats (struct pool *, const char *name);
 
 /* Initializes the page allocator.  At most USER_PAGE_LIMIT
    pages are put into the user pool. */
@@ -71,24 +140,45 @@ void *
 palloc_get_multiple (enum palloc_flags flags, size_t page_cnt)
 {
   struct pool *pool = flags & PAL_USER ? &user_pool : &kernel_pool;
-  void *pages;
-  size_t page_idx;
+  enum intr_level old_level;
+  void *pages = NULL;
+  bool zeroed = false;
+  int order;
 
   if (page_cnt == 0)
     return NULL;
 
-  lock_acquire (&pool->lock);
-  page_idx = bitmap_scan_and_flip (pool->used_map, 0, page_cnt, false);
-  lock_release (&pool->lock);
+  /* Smallest block that holds PAGE_CNT pages. */
+  for (order = 0; order < ORDER_CNT && ((size_t) 1 << order) < page_cnt;
+       order++)
+    continue;
 
-  if (page_idx != BITMAP_ERROR)
-    pages = pool->base + PGSIZE * page_idx;
-  else
-    pages = NULL;
+  old_level = intr_disable ();
+  spinlock_acquire (&pool->lock);
+  if (flags & PAL_ZERO)
+    {
+      if (page_cnt == 1 && palloc_prezero)
+        pages = pop_zeroed (pool);
+      zeroed = pages != NULL;
+      if (zeroed)
+        pool->zero_hits++;
+      else
+        pool->zero_misses++;
+    }
+  if (pages == NULL)
+    pages = alloc_run (pool, page_cnt, order);
+  if (pages == NULL && pool->zeroed_cnt > 0)
+    {
+      /* The pre-zeroed pages may be what is missing. */
+      release_zeroed (pool);
+      pages = alloc_run (pool, page_cnt, order);
+    }
+  spinlock_release (&pool->lock);
+  intr_set_level (old_level);
 
   if (pages != NULL) 
     {
-      if (flags & PAL_ZERO)
+      if ((flags & PAL_ZERO) && !zeroed)
         memset (pages, 0, PGSIZE * page_cnt);
     }
   else 
@@ -118,6 +208,7 @@ void
 palloc_free_multiple (void *pages, size_t page_cnt) 
 {
   struct pool *pool;
+  enum intr_level old_level;
   size_t page_idx;
 
   ASSERT (pg_ofs (pages) == 0);
@@ -132,13 +223,99 @@ palloc_free_multiple (void *pages, size_t page_cnt)
     NOT_REACHED ();
 
   page_idx = pg_no (pages) - pg_no (pool->base);
+  ASSERT (page_idx + page_cnt <= pool->page_cnt);
 
 #ifndef NDEBUG
   memset (pages, 0xcc, PGSIZE * page_cnt);
 #endif
 
-  ASSERT (bitmap_all (pool->used_map, page_idx, page_cnt));
-  bitmap_set_multiple (pool->used_map, page_idx, page_cnt, false);
+  old_level = intr_disable ();
+  spinlock_acquire (&pool->lock);
+  free_run (pool, page_idx, page_cnt);
+  pool->free_cnt += page_cnt;
+  spinlock_release (&pool->lock);
+  intr_set_level (old_level);
+}
+
+/* Tries to extend the run of PAGE_CNT pages at PAGES, obtained
+   from palloc_get_multiple(), to NEW_PAGE_CNT pages by allocating
+   the pages that follow it.  Returns true if successful.  Returns
+   false, changing nothing, if any of those pages is in use or
+   outside the pool. */
+bool
+palloc_grow (void *pages, size_t page_cnt, size_t new_page_cnt) 
+{
+  struct pool *pool;
+  enum intr_level old_level;
+  size_t start, end, idx;
+  bool success = true;
+  int order;
+
+  ASSERT (pg_ofs (pages) == 0);
+  ASSERT (new_page_cnt >= page_cnt);
+
+  if (page_from_pool (&kernel_pool, pages))
+    pool = &kernel_pool;
+  else if (page_from_pool (&user_pool, pages))
+    pool = &user_pool;
+  else
+    NOT_REACHED ();
+
+  start = pg_no (pages) - pg_no (pool->base) + page_cnt;
+  end = start - page_cnt + new_page_cnt;
+  if (end > pool->page_cnt)
+    return false;
+
+  old_level = intr_disable ();
+  spinlock_acquire (&pool->lock);
+
+  /* Pre-zeroed pages in [START, END) are free but off the free
+     lists, so put them back for the check below to find. */
+  for (idx = 0; idx < pool->zeroed_cnt; )
+    {
+      size_t page_idx = pg_no (pool->zeroed[idx]) - pg_no (pool->base);
+      if (page_idx >= start && page_idx < end)
+        {
+          pool->zeroed[idx] = pool->zeroed[--pool->zeroed_cnt];
+          free_block (pool, page_idx, 0);
+          if (pool->zeroed_cnt <= ZERO_LOW)
+            pool->refilling = true;
+        }
+      else
+        idx++;
+    }
+
+  /* Check that every page in [START, END) is free. */
+  for (idx = start; idx < end && success; )
+    {
+      size_t block = find_free_block (pool, idx, &order);
+      if (block != SIZE_MAX)
+        idx = block + ((size_t) 1 << order);
+      else
+        success = false;
+    }
+
+  /* Take the free blocks that overlap [START, END), and free
+     again the parts of them outside it. */
+  if (success)
+    {
+      for (idx = start; idx < end; )
+        {
+          size_t block = find_free_block (pool, idx, &order);
+          size_t block_end = block + ((size_t) 1 << order);
+
+          remove_block (pool, block, order);
+          free_run (pool, block, idx - block);
+          if (block_end > end)
+            free_run (pool, end, block_end - end);
+          idx = block_end;
+        }
+      pool->free_cnt -= new_page_cnt - page_cnt;
+    }
+
+  spinlock_release (&pool->lock);
+  intr_set_level (old_level);
+  return success;
 }
 
 /* Frees the page at PAGE. */
@@ -148,25 +325,81 @@ palloc_free_page (void *page)
   palloc_free_multiple (page, 1);
 }
 
+/* Returns the number of free pages in the user pool, if
+   PAL_USER is set in FLAGS, or otherwise in the kernel pool. */
+size_t
+palloc_free_cnt (enum palloc_flags flags) 
+{
+  return (flags & PAL_USER ? &user_pool : &kernel_pool)->free_cnt;
+}
+
+/* Zeroes one free page for a pool that is short of pre-zeroed
+   pages.  Returns false, doing nothing, if no pool needs one.
+   Called by the idle thread, with interrupts on, so that a
+   thread that becomes ready preempts it between any two pages
+   or in the middle of one. */
+bool
+palloc_zero_idle (void) 
+{
+  return palloc_prezero
+         && (zero_pool_page (&kernel_pool) || zero_pool_page (&user_pool));
+}
+
+/* Stores the number of PAL_ZERO requests from the user pool, if
+   PAL_USER is set in FLAGS, or otherwise from the kernel pool,
+   that were served with a pre-zeroed page in *HITS, and the
+   number that had to be zeroed on the spot in *MISSES. */
+void
+palloc_zero_stats (enum palloc_flags flags, unsigned long long *hits,
+                   unsigned long long *misses) 
+{
+  struct pool *pool = flags & PAL_USER ? &user_pool : &kernel_pool;
+
+  *hits = pool->zero_hits;
+  *misses = pool->zero_misses;
+}
+
+/* Prints a fragmentation report for each pool. */
+void
+palloc_print_stats (void) 
+{
+  print_pool_stats (&kernel_pool, "kernel pool");
+  print_pool_stats (&user_pool, "user pool");
+}
+
 /* Initializes pool P as starting at START and ending at END,
    naming it NAME for debugging purposes. */
 static void
 init_pool (struct pool *p, void *base, size_t page_cnt, const char *name) 
 {
-  /* We'll put the pool's used_map at its base.
-     Calculate the space needed for the bitmap
-     and subtract it from the pool's size. */
-  size_t bm_pages = DIV_ROUND_UP (bitmap_buf_size (page_cnt), PGSIZE);
-  if (bm_pages > page_cnt)
-    PANIC ("Not enough memory in %s for bitmap.", name);
-  page_cnt -= bm_pages;
+  /* We'll put the pool's free_order map at its base.
+     Calculate the space needed for it and subtract it from the
+     pool's size. */
+  size_t map_pages = DIV_ROUND_UP (page_cnt, PGSIZE);
+  int order;
+
+  if (map_pages > page_cnt)
+    PANIC ("Not enough memory in %s for free map.", name);
+  page_cnt -= map_pages;
 
   printf ("%zu pages available in %s.\n", page_cnt, name);
 
   /* Initialize the pool. */
-  lock_init (&p->lock);
-  p->used_map = bitmap_create_in_buf (page_cnt, base, bm_pages * PGSIZE);
-  p->base = base + bm_pages * PGSIZE;
+  spinlock_init (&p->lock);
+  spinlock_set_name (&p->lock, name);
+  p->free_order = base;
+  memset (p->free_order, 0, page_cnt);
+  p->base = base + map_pages * PGSIZE;
+  p->page_cnt = page_cnt;
+  p->free_cnt = page_cnt;
+  for (order = 0; order < ORDER_CNT; order++)
+    list_init (&p->free_lists[order]);
+  p->free_mask = 0;
+  p->zeroed_cnt = 0;
+  p->zeroing_cnt = 0;
+  p->refilling = true;
+  p->zero_hits = p->zero_misses = 0;
+  free_run (p, 0, page_cnt);
 }
 
 /* Returns true if PAGE was allocated from POOL,
@@ -176,7 +409,257 @@ page_from_pool (const struct pool *pool, void *page)
 {
   size_t page_no = pg_no (page);
   size_t start_page = pg_no (pool->base);
-  size_t end_page = start_page + bitmap_size (pool->used_map);
+  size_t end_page = start_page + pool->page_cnt;
 
   return page_no >= start_page && page_no < end_page;
 }
+
+/* Returns the list element kept in the first page of the free
+   block at PAGE_IDX in POOL. */
+static struct list_elem *
+block_elem (const struct pool *pool, size_t page_idx) 
+{
+  return (struct list_elem *) (pool->base + PGSIZE * page_idx);
+}
+
+/* Adds the block of order ORDER at PAGE_IDX to POOL's free
+   lists. */
+static void
+push_block (struct pool *pool, size_t page_idx, int order) 
+{
+  list_push_front (&pool->free_lists[order], block_elem (pool, page_idx));
+  pool->free_order[page_idx] = order + 1;
+  pool->free_mask |= 1u << order;
+}
+
+/* Removes the free block of order ORDER at PAGE_IDX from POOL's
+   free lists. */
+static void
+remove_block (struct pool *pool, size_t page_idx, int order) 
+{
+  list_remove (block_elem (pool, page_idx));
+  pool->free_order[page_idx] = 0;
+  if (list_empty (&pool->free_lists[order]))
+    pool->free_mask &= ~(1u << order);
+}
+
+/* Returns the index of the free block in POOL that contains the
+   page at PAGE_IDX and stores its order in *ORDER, or returns
+   SIZE_MAX if that page is in use. */
+static size_t
+find_free_block (const struct pool *pool, size_t page_idx, int *order) 
+{
+  int o;
+
+  for (o = 0; o < ORDER_CNT; o++)
+    {
+      size_t block = page_idx & ~(((size_t) 1 << o) - 1);
+      if (pool->free_order[block] == o + 1)
+        {
+          *order = o;
+          return block;
+        }
+    }
+  return SIZE_MAX;
+}
+
+/* Allocates a block of 2**ORDER pages from POOL and returns the
+   index of its first page, or SIZE_MAX if no block that large is
+   free.  POOL's lock must be held. */
+static size_t
+alloc_block (struct pool *pool, int order) 
+{
+  uint32_t mask = pool->free_mask & ~((1u << order) - 1);
+  size_t page_idx;
+  int have;
+
+  ASSERT (spinlock_held (&pool->lock));
+
+  if (mask == 0)
+    return SIZE_MAX;
+
+  /* Take the smallest big enough block and split it, freeing the
+     upper half each time, until it is the right size. */
+  have = __builtin_ctz (mask);
+  page_idx = (pg_no (list_front (&pool->free_lists[have]))
+              - pg_no (pool->base));
+  remove_block (pool, page_idx, have);
+  while (have > order)
+    {
+      have--;
+      push_block (pool, page_idx + ((size_t) 1 << have), have);
+    }
+  return page_idx;
+}
+
+/* Allocates PAGE_CNT pages from POOL, taking them from a block
+   of 2**ORDER pages, and returns the first one, or a null
+   pointer if no block that large is free.  POOL's lock must be
+   held. */
+static void *
+alloc_run (struct pool *pool, size_t page_cnt, int order) 
+{
+  size_t page_idx = order < ORDER_CNT ? alloc_block (pool, order) : SIZE_MAX;
+
+  if (page_idx == SIZE_MAX)
+    return NULL;
+
+  /* Give back the pages beyond PAGE_CNT. */
+  free_run (pool, page_idx + page_cnt, ((size_t) 1 << order) - page_cnt);
+  pool->free_cnt -= page_cnt;
+  return pool->base + PGSIZE * page_idx;
+}
+
+/* Takes a page from POOL's pre-zeroed pages and returns it, or
+   returns a null pointer if there are none.  POOL's lock must be
+   held. */
+static void *
+pop_zeroed (struct pool *pool) 
+{
+  ASSERT (spinlock_held (&pool->lock));
+
+  if (pool->zeroed_cnt == 0)
+    return NULL;
+  if (pool->zeroed_cnt <= ZERO_LOW)
+    pool->refilling = true;
+  pool->free_cnt--;
+  return pool->zeroed[--pool->zeroed_cnt];
+}
+
+/* Returns all of POOL's pre-zeroed pages to its free lists.
+   POOL's lock must be held. */
+static void
+release_zeroed (struct pool *pool) 
+{
+  ASSERT (spinlock_held (&pool->lock));
+
+  while (pool->zeroed_cnt > 0)
+    {
+      void *page = pool->zeroed[--pool->zeroed_cnt];
+      free_block (pool, pg_no (page) - pg_no (pool->base), 0);
+    }
+  pool->refilling = true;
+}
+
+/* Returns true if POOL should have another pre-zeroed page.
+   POOL's lock must be held. */
+static bool
+wants_zeroed (const struct pool *pool) 
+{
+  size_t cnt = pool->zeroed_cnt + pool->zeroing_cnt;
+
+  return (pool->refilling && cnt < ZERO_HIGH
+          && (cnt + 1) * 4 <= pool->free_cnt);
+}
+
+/* Takes a page off POOL's free lists, zeroes it, and adds it to
+   POOL's pre-zeroed pages, if POOL wants another one.  Returns
+   true if it did.  The page is zeroed without the lock held and
+   with interrupts on. */
+static bool
+zero_pool_page (struct pool *pool) 
+{
+  enum intr_level old_level;
+  size_t page_idx = SIZE_MAX;
+  void *page;
+
+  old_level = intr_disable ();
+  spinlock_acquire (&pool->lock);
+  if (wants_zeroed (pool))
+    {
+      page_idx = alloc_block (pool, 0);
+      if (page_idx != SIZE_MAX)
+        pool->zeroing_cnt++;
+    }
+  spinlock_release (&pool->lock);
+  intr_set_level (old_level);
+
+  if (page_idx == SIZE_MAX)
+    return false;
+
+  page = pool->base + PGSIZE * page_idx;
+  memset (page, 0, PGSIZE);
+
+  old_level = intr_disable ();
+  spinlock_acquire (&pool->lock);
+  pool->zeroing_cnt--;
+  pool->zeroed[pool->zeroed_cnt++] = page;
+  if (pool->zeroed_cnt + pool->zeroing_cnt >= ZERO_HIGH)
+    pool->refilling = false;
+  spinlock_release (&pool->lock);
+  intr_set_level (old_level);
+  return true;
+}
+
+/* Frees the block of 2**ORDER pages at PAGE_IDX in POOL, merging
+   it with its buddy for as long as the buddy is free.  POOL's
+   lock must be held, or POOL must not yet be in use. */
+static void
+free_block (struct pool *pool, size_t page_idx, int order) 
+{
+  ASSERT (pool->free_order[page_idx] == 0);
+
+  while (order < ORDER_CNT - 1)
+    {
+      size_t buddy = page_idx ^ ((size_t) 1 << order);
+      if (buddy + ((size_t) 1 << order) > pool->page_cnt
+          || pool->free_order[buddy] != order + 1)
+        break;
+      remove_block (pool, buddy, order);
+      if (buddy < page_idx)
+        page_idx = buddy;
+      order++;
+    }
+  push_block (pool, page_idx, order);
+}
+
+/* Frees the PAGE_CNT pages starting at PAGE_IDX in POOL, which
+   need not form a single block, by splitting them into the
+   largest aligned blocks that fit. */
+static void
+free_run (struct pool *pool, size_t page_idx, size_t page_cnt) 
+{
+  while (page_cnt > 0)
+    {
+      int order = 0;
+
+      while (order < ORDER_CNT - 1
+             && page_idx % ((size_t) 2 << order) == 0
+             && ((size_t) 2 << order) <= page_cnt)
+        order++;
+      free_block (pool, page_idx, order);
+      page_idx += (size_t) 1 << order;
+      page_cnt -= (size_t) 1 << order;
+    }
+}
+
+/* Prints POOL's free page count, the number of free blocks of
+   each order, and its fragmentation: how far its largest free
+   block falls short of the largest power of 2 no greater than
+   the number of pages on its free lists, which is the largest
+   block that they could form if they were contiguous.  Then
+   prints its pre-zeroed page count, hits, and misses. */
+static void
+print_pool_stats (struct pool *pool, const char *name) 
+{
+  size_t listed = pool->free_cnt - pool->zeroed_cnt - pool->zeroing_cnt;
+  size_t largest = 0;
+  size_t ideal = 1;
+  int order;
+
+  printf ("Palloc %s: %zu of %zu pages free, blocks by order:",
+          name, pool->free_cnt, pool->page_cnt);
+  for (order = 0; order < ORDER_CNT; order++)
+    if (pool->free_mask & (1u << order))
+      {
+        printf (" %d:%zu", order, list_size (&pool->free_lists[order]));
+        largest = (size_t) 1 << order;
+      }
+  while (ideal * 2 <= listed && ideal < (size_t) 1 << (ORDER_CNT - 1))
+    ideal *= 2;
+  printf (", %zu%% fragmented\n",
+          listed > 0 ? 100 - largest * 100 / ideal : 0);
+  printf ("Palloc %s: %zu pages pre-zeroed, %llu zero hits, "
+          "%llu zero misses\n",
+          name, pool->zeroed_cnt, pool->zero_hits, pool->zero_misses);
+}
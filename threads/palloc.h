@@ -1,6 +1,7 @@
 #ifndef THREADS_PALLOC_H
 #define THREADS_PALLOC_H
 
+#include <stdbool.h>
 #include <stddef.h>
 
 /* How to allocate pages. */
@@ -11,10 +12,22 @@ enum palloc_flags
     PAL_USER = 004              /* User page. */
   };
 
+/* If true (default), idle CPUs keep a pool of pre-zeroed pages
+   for single-page PAL_ZERO requests.  If false, every PAL_ZERO
+   request zeroes its pages on the spot.  Controlled by kernel
+   command-line option "-noprezero". */
+extern bool palloc_prezero;
+
 void palloc_init (size_t user_page_limit);
 void *palloc_get_page (enum palloc_flags);
 void *palloc_get_multiple (enum palloc_flags, size_t page_cnt);
 void palloc_free_page (void *);
 void palloc_free_multiple (void *, size_t page_cnt);
+bool palloc_grow (void *, size_t page_cnt, size_t new_page_cnt);
+size_t palloc_free_cnt (enum palloc_flags);
+bool palloc_zero_idle (void);
+void palloc_zero_stats (enum palloc_flags, unsigned long long *hits,
+                        unsigned long long *misses);
+void palloc_print_stats (void);
 
 #endif /* threads/palloc.h */
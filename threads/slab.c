@@ -0,0 +1,276 @@
+#include "threads/slab.h"
+#include <debug.h>
+#include <list.h>
+#include <round.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "threads/interrupt.h"
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/synch.h"
+#include "threads/vaddr.h"
+
+/* Slab allocator, after Bonwick, "The Slab Allocator: An
+   Object-Caching Kernel Memory Allocator", USENIX 1994.
+
+   A cache hands out objects of a single size and type.  It gets
+   memory from the page allocator one page, or "slab", at a time,
+   carves the slab into objects, and runs the cache's constructor
+   on each object once, when the slab is created.  Objects keep
+   their constructed state while they sit free in the cache, so
+   a client that returns each object to that state before
+   kmem_cache_free() does not have to initialize it again on
+   every kmem_cache_alloc().
+
+   Each slab begins with a header, which holds a stack of the
+   indexes of its free objects, so that the free objects
+   themselves are never written to.  The objects follow the
+   header at an offset, the slab's "colour", that steps by
+   CACHE_LINE from one slab to the next within the space left
+   over at the end of the page.  That way the objects at the same
+   index in different slabs fall in different cache lines.
+
+   A cache keeps its slabs on three lists: those with no free
+   objects, those with some, and those with all objects free.
+   Objects are allocated from a partly used slab when there is
+   one, so that free objects concentrate in few slabs.  Up to
+   EMPTY_MAX empty slabs are kept for reuse; others go back to the
+   page allocator. */
+
+/* Size of a cache line, in bytes. */
+#define CACHE_LINE 64
+
+/* Alignment of objects within a slab. */
+#define OBJ_ALIGN 8
+
+/* Number of empty slabs that a cache keeps. */
+#define EMPTY_MAX 1
+
+/* A cache of objects. */
+struct kmem_cache
+  {
+    struct lock lock;           /* Protects the other members. */
+    const char *name;           /* Name, for statistics. */
+    size_t size;                /* Object size, with padding. */
+    kmem_ctor_func *ctor;       /* Constructor, or null. */
+    size_t obj_cnt;             /* Objects per slab. */
+    size_t hdr_size;            /* Bytes of slab header. */
+    size_t color_max;           /* Largest colour offset. */
+    size_t next_color;          /* Colour for the next slab. */
+    struct list full;           /* Slabs with no free objects. */
+    struct list partial;        /* Slabs with some free objects. */
+    struct list empty;          /* Slabs with every object free. */
+    size_t empty_cnt;           /* Number of slabs in EMPTY. */
+    struct list_elem elem;      /* Element in `caches'. */
+
+    /* Statistics. */
+    size_t slab_cnt;            /* Number of slabs. */
+    size_t in_use;              /* Objects allocated. */
+    size_t peak_in_use;         /* Most objects ever allocated at once. */
+    unsigned long long allocs;  /* Calls to kmem_cache_alloc(). */
+    unsigned long long grows;   /* Slabs created. */
+  };
+
+/* Slab header, at the start of each slab's page. */
+struct slab
+  {
+    struct kmem_cache *cache;   /* Owning cache. */
+    struct list_elem elem;      /* Element in one of the cache's lists. */
+    uint8_t *objs;              /* First object. */
+    size_t free_cnt;            /* Number of free objects. */
+    uint16_t free[];            /* Indexes of free objects, as a stack. */
+  };
+
+/* All caches, for kmem_cache_print_stats(). */
+static struct list caches = LIST_INITIALIZER (caches);
+
+static struct slab *slab_create (struct kmem_cache *);
+static void slab_move (struct kmem_cache *, struct slab *);
+
+/* Creates and returns a cache of objects of SIZE bytes named
+   NAME, which must remain valid as long as the cache exists.
+   CTOR, if nonnull, is called on each object once, when it is
+   added to the cache.  Panics if memory is not available, since
+   caches are created at initialization time. */
+struct kmem_cache *
+kmem_cache_create (const char *name, size_t size, kmem_ctor_func *ctor)
+{
+  struct kmem_cache *c;
+  enum intr_level old_level;
+
+  ASSERT (name != NULL);
+  ASSERT (size > 0);
+
+  c = malloc (sizeof *c);
+  if (c == NULL)
+    PANIC ("out of memory creating slab cache %s", name);
+
+  c->name = name;
+  c->size = ROUND_UP (size, OBJ_ALIGN);
+  c->ctor = ctor;
+
+  /* Fit as many objects as possible, each with its entry in the
+     header's free stack. */
+  c->obj_cnt = ((PGSIZE - sizeof (struct slab) - OBJ_ALIGN)
+                / (c->size + sizeof (uint16_t)));
+  if (c->obj_cnt == 0)
+    PANIC ("slab cache %s: %zu-byte objects do not fit in a page",
+           name, size);
+  c->hdr_size = ROUND_UP (sizeof (struct slab)
+                          + c->obj_cnt * sizeof (uint16_t), OBJ_ALIGN);
+  c->color_max = PGSIZE - c->hdr_size - c->obj_cnt * c->size;
+  c->next_color = 0;
+
+  list_init (&c->full);
+  list_init (&c->partial);
+  list_init (&c->empty);
+  c->empty_cnt = 0;
+  c->slab_cnt = c->in_use = c->peak_in_use = 0;
+  c->allocs = c->grows = 0;
+  lock_init_adaptive (&c->lock);
+  lock_set_name (&c->lock, name);
+
+  old_level = intr_disable ();
+  list_push_back (&caches, &c->elem);
+  intr_set_level (old_level);
+  return c;
+}
+
+/* Obtains and returns a constructed object from cache C.
+   Returns a null pointer if memory is not available. */
+void *
+kmem_cache_alloc (struct kmem_cache *c)
+{
+  struct slab *s;
+  void *obj;
+
+  lock_acquire (&c->lock);
+  if (!list_empty (&c->partial))
+    s = list_entry (list_front (&c->partial), struct slab, elem);
+  else
+    {
+      if (list_empty (&c->empty) && slab_create (c) == NULL)
+        {
+          lock_release (&c->lock);
+          return NULL;
+        }
+      s = list_entry (list_front (&c->empty), struct slab, elem);
+      c->empty_cnt--;
+    }
+
+  obj = s->objs + s->free[--s->free_cnt] * c->size;
+  slab_move (c, s);
+  c->allocs++;
+  if (++c->in_use > c->peak_in_use)
+    c->peak_in_use = c->in_use;
+  lock_release (&c->lock);
+
+  return obj;
+}
+
+/* Returns OBJ, which must have come from cache C and must be in
+   its constructed state, to C. */
+void
+kmem_cache_free (struct kmem_cache *c, void *obj)
+{
+  struct slab *s;
+  size_t idx;
+
+  if (obj == NULL)
+    return;
+
+  s = pg_round_down (obj);
+  ASSERT (s->cache == c);
+  ASSERT ((uint8_t *) obj >= s->objs);
+  idx = ((uint8_t *) obj - s->objs) / c->size;
+  ASSERT (idx < c->obj_cnt && s->objs + idx * c->size == obj);
+
+  lock_acquire (&c->lock);
+  ASSERT (s->free_cnt < c->obj_cnt);
+  s->free[s->free_cnt++] = idx;
+  c->in_use--;
+  slab_move (c, s);
+  lock_release (&c->lock);
+}
+
+/* Prints usage statistics for each cache. */
+void
+kmem_cache_print_stats (void)
+{
+  struct list_elem *e;
+
+  for (e = list_begin (&caches); e != list_end (&caches); e = list_next (e))
+    {
+      struct kmem_cache *c = list_entry (e, struct kmem_cache, elem);
+      printf ("Slab %s: %zu-byte objects, %zu per slab, %zu slabs, "
+              "%zu in use (peak %zu), %llu allocations, %llu grows\n",
+              c->name, c->size, c->obj_cnt, c->slab_cnt, c->in_use,
+              c->peak_in_use, c->allocs, c->grows);
+    }
+}
+
+/* Creates a slab for cache C, constructs its objects, adds it
+   to C's empty slabs, and returns it.  Returns a null pointer if
+   memory is not available.  C's lock must be held. */
+static struct slab *
+slab_create (struct kmem_cache *c)
+{
+  struct slab *s;
+  size_t i;
+
+  ASSERT (lock_held_by_current_thread (&c->lock));
+
+  s = palloc_get_page (0);
+  if (s == NULL)
+    return NULL;
+
+  s->cache = c;
+  s->objs = (uint8_t *) s + c->hdr_size + c->next_color;
+  c->next_color += CACHE_LINE;
+  if (c->next_color > c->color_max)
+    c->next_color = 0;
+
+  /* Hand out the lowest-addressed objects first. */
+  s->free_cnt = c->obj_cnt;
+  for (i = 0; i < c->obj_cnt; i++)
+    {
+      s->free[i] = c->obj_cnt - 1 - i;
+      if (c->ctor != NULL)
+        c->ctor (s->objs + i * c->size);
+    }
+
+  list_push_front (&c->empty, &s->elem);
+  c->empty_cnt++;
+  c->slab_cnt++;
+  c->grows++;
+  return s;
+}
+
+/* Moves slab S to the list in cache C that matches its number of
+   free objects, after an object has been allocated from it or
+   freed to it.  Frees S instead if it is empty and C already
+   keeps enough empty slabs.  If S was on C's empty list, the
+   caller must already have taken it out of EMPTY_CNT.  C's lock
+   must be held. */
+static void
+slab_move (struct kmem_cache *c, struct slab *s)
+{
+  ASSERT (lock_held_by_current_thread (&c->lock));
+
+  list_remove (&s->elem);
+  if (s->free_cnt == 0)
+    list_push_front (&c->full, &s->elem);
+  else if (s->free_cnt < c->obj_cnt)
+    list_push_front (&c->partial, &s->elem);
+  else if (c->empty_cnt < EMPTY_MAX)
+    {
+      list_push_front (&c->empty, &s->elem);
+      c->empty_cnt++;
+    }
+  else
+    {
+      c->slab_cnt--;
+      palloc_free_page (s);
+    }
+}
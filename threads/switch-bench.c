@@ -0,0 +1,175 @@
+#include "threads/switch-bench.h"
+#include <stdint.h>
+#include <stdio.h>
+#include "threads/cpu.h"
+#include "threads/interrupt.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#ifdef USERPROG
+#include "userprog/pagedir.h"
+#include "userprog/process.h"
+#endif
+
+/* Context-switch microbenchmarks.
+
+   Each benchmark is the ping-pong from sema_self_test(): two
+   threads of equal priority take turns upping a semaphore the
+   other is waiting on, so every round trip is two context
+   switches, each preceded by a sema_up() and a sema_down().  The
+   reported figure is the average number of CPU cycles per
+   switch, including that semaphore work.
+
+   In a kernel with user programs, the two threads can also be
+   given page directories of their own, to measure switches
+   between threads of the same user address space and between
+   threads of different ones.  These threads never actually
+   enter user mode, but the scheduler treats them exactly as it
+   would user threads.  For these, the number of page directory
+   loads during the timed round trips is reported too: switches
+   within one address space should not need any. */
+
+/* Number of round trips timed per benchmark. */
+#define ROUND_CNT 1000
+
+/* Number of untimed round trips run first, to warm up the
+   caches. */
+#define WARMUP_CNT 16
+
+/* State shared by the two threads of a benchmark. */
+struct ping_pong
+  {
+    struct semaphore ping;      /* Upped by the main thread. */
+    struct semaphore pong;      /* Upped by the helper thread. */
+    struct semaphore done;      /* Upped when the helper finishes. */
+    uint32_t *pd;               /* Helper's page directory. */
+  };
+
+static uint64_t run_benchmark (uint32_t *main_pd, uint32_t *helper_pd,
+                               long long *loads);
+static thread_func pong_thread;
+static void set_pagedir (uint32_t *pd);
+static long long load_cnt (void);
+
+/* Runs each context-switch benchmark and prints its result. */
+void
+switch_bench (void)
+{
+  printf ("Context switch benchmarks (%d round trips each):\n", ROUND_CNT);
+  printf ("  kernel to kernel: %llu cycles per switch\n",
+          run_benchmark (NULL, NULL, NULL));
+#ifdef USERPROG
+  {
+    uint32_t *pd1 = pagedir_create ();
+    uint32_t *pd2 = pagedir_create ();
+    uint64_t cycles;
+    long long loads;
+
+    if (pd1 != NULL && pd2 != NULL)
+      {
+        cycles = run_benchmark (pd1, pd1, &loads);
+        printf ("  user to user, same address space: "
+                "%llu cycles per switch, %lld page directory loads\n",
+                cycles, loads);
+        cycles = run_benchmark (pd1, pd2, &loads);
+        printf ("  user to user, cross address space: "
+                "%llu cycles per switch, %lld page directory loads\n",
+                cycles, loads);
+      }
+    else
+      printf ("  user to user: out of memory\n");
+    if (pd1 != NULL)
+      pagedir_destroy (pd1);
+    if (pd2 != NULL)
+      pagedir_destroy (pd2);
+  }
+#endif
+}
+
+/* Runs one ping-pong benchmark between the running thread, using
+   page directory MAIN_PD, and a new thread using HELPER_PD.
+   Either may be null, for a kernel thread.  Returns the average
+   number of cycles per context switch.  If LOADS is nonnull,
+   stores in it the number of page directory loads during the
+   timed round trips. */
+static uint64_t
+run_benchmark (uint32_t *main_pd, uint32_t *helper_pd, long long *loads)
+{
+  struct ping_pong pp;
+  uint64_t start, end;
+  long long start_loads;
+  int i;
+
+  sema_init (&pp.ping, 0);
+  sema_init (&pp.pong, 0);
+  sema_init (&pp.done, 0);
+  pp.pd = helper_pd;
+
+  set_pagedir (main_pd);
+  thread_create ("switch-bench", thread_get_priority (), pong_thread, &pp);
+  for (i = 0; i < WARMUP_CNT; i++)
+    {
+      sema_up (&pp.ping);
+      sema_down (&pp.pong);
+    }
+  start_loads = load_cnt ();
+  start = rdtsc ();
+  for (i = 0; i < ROUND_CNT; i++)
+    {
+      sema_up (&pp.ping);
+      sema_down (&pp.pong);
+    }
+  end = rdtsc ();
+  if (loads != NULL)
+    *loads = load_cnt () - start_loads;
+  sema_down (&pp.done);
+  set_pagedir (NULL);
+
+  return (end - start) / (2 * ROUND_CNT);
+}
+
+/* Helper thread for run_benchmark().  Answers each of the main
+   thread's pings with a pong. */
+static void
+pong_thread (void *pp_)
+{
+  struct ping_pong *pp = pp_;
+  int i;
+
+  set_pagedir (pp->pd);
+  for (i = 0; i < WARMUP_CNT + ROUND_CNT; i++)
+    {
+      sema_down (&pp->ping);
+      sema_up (&pp->pong);
+    }
+
+  /* Give up the page directory before exiting, so that
+     process_exit() does not destroy it. */
+  set_pagedir (NULL);
+  sema_up (&pp->done);
+}
+
+/* Makes PD, which may be null, the running thread's page
+   directory and activates it.  Does nothing in a kernel without
+   user programs. */
+static void
+set_pagedir (uint32_t *pd UNUSED)
+{
+#ifdef USERPROG
+  enum intr_level old_level = intr_disable ();
+  thread_current ()->pagedir = pd;
+  process_activate ();
+  intr_set_level (old_level);
+#endif
+}
+
+/* Returns the number of page directory loads so far, or 0 in a
+   kernel without user programs. */
+static long long
+load_cnt (void)
+{
+#ifdef USERPROG
+  return pagedir_load_cnt ();
+#else
+  return 0;
+#endif
+}
@@ -0,0 +1,6 @@
+#ifndef THREADS_SWITCH_BENCH_H
+#define THREADS_SWITCH_BENCH_H
+
+void switch_bench (void);
+
+#endif /* threads/switch-bench.h */
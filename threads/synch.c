@@ -27,10 +27,41 @@
 */
 
 #include "threads/synch.h"
+#include <inttypes.h>
 #include <stdio.h>
 #include <string.h>
 #include "threads/interrupt.h"
 #include "threads/thread.h"
+#include "devices/timer.h"
+
+/* Maximum length of a chain of lock holders that a priority
+   donation is passed along. */
+#define DONATION_DEPTH_MAX 8
+
+/* Number of times an adaptive lock polls a holder that is
+   running on another CPU before giving up and blocking. */
+#define LOCK_SPIN_MAX 1000
+
+/* Number of locks listed by lock_print_stats(). */
+#define LOCK_STATS_TOP 10
+
+/* Locks given a name with lock_set_name(), for
+   lock_print_stats(). */
+static struct list named_locks = LIST_INITIALIZER (named_locks);
+
+/* Spin locks given a name with spinlock_set_name(), for
+   lock_print_stats(). */
+static struct list named_spinlocks = LIST_INITIALIZER (named_spinlocks);
+
+static bool priority_less (const struct list_elem *,
+                           const struct list_elem *, void *aux);
+static bool cond_waiter_less (const struct list_elem *,
+                              const struct list_elem *, void *aux);
+static void insert_by_priority (struct list *, struct list_elem *,
+                                list_less_func *);
+static void donate_priority (struct lock *);
+static void lock_take (struct lock *);
+static bool lock_spin (struct lock *);
 
 /* Initializes semaphore SEMA to VALUE.  A semaphore is a
    nonnegative integer along with two atomic operators for
@@ -40,7 +71,11 @@
      decrement it.
 
    - up or "V": increment the value (and wake up one waiting
-     thread, if any). */
+     thread, if any).
+
+   Waiting threads are kept sorted by nonincreasing priority, and
+   in arrival order among equal priorities, so that the thread
+   to wake is always at the front. */
 void
 sema_init (struct semaphore *sema, unsigned value) 
 {
@@ -68,7 +103,9 @@ sema_down (struct semaphore *sema)
   old_level = intr_disable ();
   while (sema->value == 0) 
     {
-      list_push_back (&sema->waiters, &thread_current ()->elem);
+      struct thread *cur = thread_current ();
+      insert_by_priority (&sema->waiters, &cur->elem, priority_less);
+      cur->waiting_sema = sema;
       thread_block ();
     }
   sema->value--;
@@ -102,7 +139,10 @@ sema_try_down (struct semaphore *sema)
 }
 
 /* Up or "V" operation on a semaphore.  Increments SEMA's value
-   and wakes up one thread of those waiting for SEMA, if any.
+   and wakes up the highest-priority thread of those waiting for
+   SEMA, if any.  Yields if the woken thread outranks the running
+   thread, or, if the caller has interrupts off, as soon as it
+   turns them back on.
 
    This function may be called from an interrupt handler. */
 void
@@ -114,10 +154,58 @@ sema_up (struct semaphore *sema)
 
   old_level = intr_disable ();
   if (!list_empty (&sema->waiters)) 
-    thread_unblock (list_entry (list_pop_front (&sema->waiters),
-                                struct thread, elem));
+    {
+      struct thread *t = list_entry (list_pop_front (&sema->waiters),
+                                     struct thread, elem);
+      t->waiting_sema = NULL;
+      thread_unblock (t);
+    }
   sema->value++;
   intr_set_level (old_level);
+
+  thread_yield_to_higher ();
+}
+
+/* Moves T, which is blocked in sema_down(), to the position in
+   its semaphore's wait list that matches its new priority.
+   Interrupts must be off. */
+void
+sema_reposition_waiter (struct thread *t)
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+  ASSERT (t->status == THREAD_BLOCKED && t->waiting_sema != NULL);
+
+  list_remove (&t->elem);
+  insert_by_priority (&t->waiting_sema->waiters, &t->elem, priority_less);
+}
+
+/* Inserts ELEM into LIST, which is sorted by nonincreasing
+   priority according to LESS, after every element of equal
+   priority.  The search starts from the back of the list, so
+   inserting a waiter that does not outrank the others takes
+   constant time. */
+static void
+insert_by_priority (struct list *list, struct list_elem *elem,
+                    list_less_func *less)
+{
+  struct list_elem *e;
+
+  for (e = list_rbegin (list); e != list_rend (list); e = list_prev (e))
+    if (!less (e, elem, NULL))
+      break;
+  list_insert (list_next (e), elem);
+}
+
+/* Returns true if the thread that owns list element A has lower
+   priority than the one that owns B, false otherwise. */
+static bool
+priority_less (const struct list_elem *a_, const struct list_elem *b_,
+               void *aux UNUSED)
+{
+  const struct thread *a = list_entry (a_, struct thread, elem);
+  const struct thread *b = list_entry (b_, struct thread, elem);
+
+  return a->priority < b->priority;
 }
 
 static void sema_test_helper (void *sema_);
@@ -178,9 +266,94 @@ lock_init (struct lock *lock)
   ASSERT (lock != NULL);
 
   lock->holder = NULL;
+  lock->max_priority = PRI_MIN;
+  lock->adaptive = false;
+  lock->name = NULL;
+  lock->acquisitions = lock->contentions = lock->blocks = 0;
+  lock->wait_ticks = 0;
   sema_init (&lock->semaphore, 1);
 }
 
+/* Initializes LOCK as an adaptive lock.  A thread that finds an
+   adaptive lock held does not block right away.  If the holder
+   is running on another CPU, it spins for a while in the hope
+   that the holder releases the lock soon; if the holder is ready
+   but not running, it yields once to let the holder finish.
+   Only if the lock is still held after that does it block.
+
+   This suits locks that are held only for short critical
+   sections, where blocking and waking up cost more than the
+   wait itself. */
+void
+lock_init_adaptive (struct lock *lock)
+{
+  lock_init (lock);
+  lock->adaptive = true;
+}
+
+/* Names LOCK NAME and adds it to the locks that
+   lock_print_stats() considers.  NAME must remain valid as long
+   as LOCK exists, and LOCK must never be destroyed. */
+void
+lock_set_name (struct lock *lock, const char *name)
+{
+  enum intr_level old_level;
+
+  ASSERT (lock != NULL);
+  ASSERT (name != NULL);
+  ASSERT (lock->name == NULL);
+
+  lock->name = name;
+  old_level = intr_disable ();
+  list_push_back (&named_locks, &lock->stats_elem);
+  intr_set_level (old_level);
+}
+
+/* Prints contention statistics for the LOCK_STATS_TOP named
+   locks that were most often found already held, followed by
+   those of every named spin lock.  Spin locks are waited for
+   with interrupts off, so no wait time is kept for them. */
+void
+lock_print_stats (void)
+{
+  struct lock *top[LOCK_STATS_TOP];
+  struct list_elem *e;
+  size_t cnt = 0;
+  size_t i;
+
+  for (e = list_begin (&named_locks); e != list_end (&named_locks);
+       e = list_next (e))
+    {
+      struct lock *lock = list_entry (e, struct lock, stats_elem);
+
+      /* Insertion into TOP, most contended first. */
+      for (i = cnt; i > 0 && top[i - 1]->contentions < lock->contentions;
+           i--)
+        if (i < LOCK_STATS_TOP)
+          top[i] = top[i - 1];
+      if (i < LOCK_STATS_TOP)
+        {
+          top[i] = lock;
+          if (cnt < LOCK_STATS_TOP)
+            cnt++;
+        }
+    }
+
+  for (i = 0; i < cnt; i++)
+    printf ("Lock %s: %lld acquisitions, %lld contended, %lld blocked, "
+            "%"PRId64" ticks waiting\n",
+            top[i]->name, top[i]->acquisitions, top[i]->contentions,
+            top[i]->blocks, top[i]->wait_ticks);
+
+  for (e = list_begin (&named_spinlocks); e != list_end (&named_spinlocks);
+       e = list_next (e))
+    {
+      struct spinlock *lock = list_entry (e, struct spinlock, stats_elem);
+      printf ("Spin lock %s: %lld acquisitions, %lld contended\n",
+              lock->name, lock->acquisitions, lock->contentions);
+    }
+}
+
 /* Acquires LOCK, sleeping until it becomes available if
    necessary.  The lock must not already be held by the current
    thread.
@@ -188,16 +361,136 @@ lock_init (struct lock *lock)
    This function may sleep, so it must not be called within an
    interrupt handler.  This function may be called with
    interrupts disabled, but interrupts will be turned back on if
-   we need to sleep. */
+   we need to sleep.
+
+   While the current thread waits, it donates its priority to
+   the lock's holder, and onward along the chain of locks that
+   holder is itself waiting for, so that a lower-priority holder
+   cannot keep it waiting indefinitely. */
 void
 lock_acquire (struct lock *lock)
 {
+  struct thread *cur = thread_current ();
+  enum intr_level old_level;
+
   ASSERT (lock != NULL);
   ASSERT (!intr_context ());
   ASSERT (!lock_held_by_current_thread (lock));
 
-  sema_down (&lock->semaphore);
-  lock->holder = thread_current ();
+  old_level = intr_disable ();
+  lock->acquisitions++;
+  if (lock->holder == NULL)
+    sema_down (&lock->semaphore);
+  else
+    {
+      int64_t start = timer_ticks ();
+
+      lock->contentions++;
+      if (!thread_mlfqs)
+        {
+          cur->waiting_lock = lock;
+          donate_priority (lock);
+        }
+      /* Spinning turns interrupts on, so a caller that turned
+         them off itself blocks right away. */
+      if (!lock->adaptive || old_level == INTR_OFF || !lock_spin (lock))
+        {
+          /* LOCK may have changed hands while we spun. */
+          if (!thread_mlfqs)
+            donate_priority (lock);
+          lock->blocks++;
+          sema_down (&lock->semaphore);
+        }
+      cur->waiting_lock = NULL;
+      lock->wait_ticks += timer_ticks () - start;
+    }
+  lock_take (lock);
+  intr_set_level (old_level);
+}
+
+/* Tries to obtain adaptive LOCK, which is held by another
+   thread, without blocking.  Spins while the holder is running
+   on another CPU, or yields once if the holder is waiting to
+   run.  Returns true if LOCK's semaphore was downed, false if
+   the caller should block.  Interrupts must be off.  They are
+   turned on while spinning, since the holder needs them off, and
+   thus the interrupt lock, to release LOCK.
+
+   The caller has already donated its priority to the holder, so
+   a yield normally lets the holder run.  A holder that still
+   ranks below us, as under the MLFQS, would not be chosen, so in
+   that case the yield is skipped. */
+static bool
+lock_spin (struct lock *lock)
+{
+  struct thread *holder;
+  int spins;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  for (spins = 0; spins < LOCK_SPIN_MAX; spins++)
+    {
+      holder = lock->holder;
+      if (holder == NULL || holder->status != THREAD_RUNNING)
+        break;
+      intr_enable ();
+      asm volatile ("pause" : : : "memory");
+      intr_disable ();
+    }
+  if (sema_try_down (&lock->semaphore))
+    return true;
+
+  holder = lock->holder;
+  if (holder != NULL && holder->status == THREAD_READY
+      && holder->priority >= thread_current ()->priority)
+    {
+      thread_yield ();
+      return sema_try_down (&lock->semaphore);
+    }
+  return false;
+}
+
+/* Passes the current thread's priority to the holder of LOCK,
+   and from there along the chain of lock holders, stopping after
+   DONATION_DEPTH_MAX locks or once a holder already runs at that
+   priority.  Interrupts must be off. */
+static void
+donate_priority (struct lock *lock)
+{
+  int priority = thread_current ()->priority;
+  int depth;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  for (depth = 0; depth < DONATION_DEPTH_MAX; depth++)
+    {
+      if (lock == NULL || lock->holder == NULL
+          || lock->max_priority >= priority)
+        break;
+      lock->max_priority = priority;
+      thread_donate_priority (lock->holder, priority);
+      lock = lock->holder->waiting_lock;
+    }
+}
+
+/* Makes the current thread the holder of LOCK, whose semaphore
+   it has just downed, and takes on the priority of any threads
+   still waiting for LOCK.  Interrupts must be off. */
+static void
+lock_take (struct lock *lock)
+{
+  struct thread *cur = thread_current ();
+  struct list *waiters = &lock->semaphore.waiters;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  lock->holder = cur;
+  lock->max_priority = PRI_MIN;
+  if (!list_empty (waiters) && !thread_mlfqs)
+    lock->max_priority = list_entry (list_front (waiters),
+                                     struct thread, elem)->priority;
+  list_push_back (&cur->locks_held, &lock->elem);
+  thread_recompute_priority (cur);
 }
 
 /* Tries to acquires LOCK and returns true if successful or false
@@ -209,14 +502,20 @@ lock_acquire (struct lock *lock)
 bool
 lock_try_acquire (struct lock *lock)
 {
+  enum intr_level old_level;
   bool success;
 
   ASSERT (lock != NULL);
   ASSERT (!lock_held_by_current_thread (lock));
 
+  old_level = intr_disable ();
   success = sema_try_down (&lock->semaphore);
   if (success)
-    lock->holder = thread_current ();
+    {
+      lock->acquisitions++;
+      lock_take (lock);
+    }
+  intr_set_level (old_level);
   return success;
 }
 
@@ -224,15 +523,30 @@ lock_try_acquire (struct lock *lock)
 
    An interrupt handler cannot acquire a lock, so it does not
    make sense to try to release a lock within an interrupt
-   handler. */
+   handler.
+
+   Any priority donated through LOCK is given up, which may cause
+   the current thread to yield. */
 void
 lock_release (struct lock *lock) 
 {
+  struct thread *cur = thread_current ();
+  enum intr_level old_level;
+
   ASSERT (lock != NULL);
   ASSERT (lock_held_by_current_thread (lock));
 
+  /* Hand the lock on in the same atomic section that gives up
+     its donations, so that no thread can find LOCK without a
+     holder while we still own its semaphore, and then block
+     without donating to us. */
+  old_level = intr_disable ();
+  list_remove (&lock->elem);
   lock->holder = NULL;
+  lock->max_priority = PRI_MIN;
+  thread_recompute_priority (cur);
   sema_up (&lock->semaphore);
+  intr_set_level (old_level);
 }
 
 /* Returns true if the current thread holds LOCK, false
@@ -246,16 +560,181 @@ lock_held_by_current_thread (const struct lock *lock)
   return lock->holder == thread_current ();
 }
 
+/* Initializes RWLOCK.  A reader-writer lock may be held by any
+   number of readers at once, or by a single writer.
+
+   Writers take precedence: once a writer is waiting, new readers
+   queue up behind it instead of joining the readers already
+   inside, so that a steady stream of readers cannot starve
+   writers.  Queued readers and writers wait on WRITER_LOCK,
+   which wakes them in priority order and donates their priority
+   to the writer that holds it.  A writer waiting for readers to
+   leave donates its priority to them in turn, but only to the
+   first RWLOCK_READER_SLOTS of them, since that is all that is
+   recorded.
+
+   Readers use a fast path that avoids WRITER_LOCK entirely when
+   no writer holds it or waits for it, so that concurrent readers
+   do not serialize. */
+void
+rwlock_init (struct rwlock *rw)
+{
+  ASSERT (rw != NULL);
+
+  lock_init (&rw->writer_lock);
+  sema_init (&rw->drained, 0);
+  rw->readers = 0;
+  rw->writer_waiting = false;
+  memset (rw->reader_threads, 0, sizeof rw->reader_threads);
+}
+
+/* Acquires RW for reading, sleeping until no writer holds or
+   waits for it if necessary.  A thread may hold read locks on
+   any number of rwlocks at once, but must not already hold RW
+   itself: a nested read would deadlock against a waiting
+   writer.
+
+   This function may sleep, so it must not be called within an
+   interrupt handler. */
+void
+rwlock_read_acquire (struct rwlock *rw)
+{
+  struct thread *cur = thread_current ();
+  struct lock *wl = &rw->writer_lock;
+  enum intr_level old_level;
+  size_t i;
+
+  ASSERT (rw != NULL);
+  ASSERT (!intr_context ());
+  ASSERT (!lock_held_by_current_thread (wl));
+
+  old_level = intr_disable ();
+  if (wl->holder != NULL || !list_empty (&wl->semaphore.waiters))
+    {
+      /* Wait our turn behind the writers. */
+      lock_acquire (wl);
+      rw->readers++;
+      lock_release (wl);
+    }
+  else
+    rw->readers++;
+
+  for (i = 0; i < RWLOCK_READER_SLOTS; i++)
+    if (rw->reader_threads[i] == NULL)
+      {
+        rw->reader_threads[i] = cur;
+        break;
+      }
+  cur->read_cnt++;
+  intr_set_level (old_level);
+}
+
+/* Releases RW, which the current thread must hold for reading.
+   Any priority donated to the current thread as a reader is
+   given up once it holds no more read locks. */
+void
+rwlock_read_release (struct rwlock *rw)
+{
+  struct thread *cur = thread_current ();
+  enum intr_level old_level;
+  size_t i;
+
+  ASSERT (rw != NULL);
+  ASSERT (rw->readers > 0);
+  ASSERT (cur->read_cnt > 0);
+
+  old_level = intr_disable ();
+  for (i = 0; i < RWLOCK_READER_SLOTS; i++)
+    if (rw->reader_threads[i] == cur)
+      {
+        rw->reader_threads[i] = NULL;
+        break;
+      }
+  if (--cur->read_cnt == 0 && cur->read_donation != PRI_MIN)
+    {
+      cur->read_donation = PRI_MIN;
+      thread_recompute_priority (cur);
+    }
+  if (--rw->readers == 0 && rw->writer_waiting)
+    sema_up (&rw->drained);
+  intr_set_level (old_level);
+}
+
+/* Acquires RW for writing, sleeping until all other readers and
+   writers have left.  RW must not already be held by the current
+   thread.
+
+   This function may sleep, so it must not be called within an
+   interrupt handler. */
+void
+rwlock_write_acquire (struct rwlock *rw)
+{
+  struct thread *cur = thread_current ();
+  enum intr_level old_level;
+  size_t i;
+
+  ASSERT (rw != NULL);
+  ASSERT (!intr_context ());
+
+  lock_acquire (&rw->writer_lock);
+
+  old_level = intr_disable ();
+  while (rw->readers > 0)
+    {
+      if (!thread_mlfqs)
+        for (i = 0; i < RWLOCK_READER_SLOTS; i++)
+          {
+            struct thread *t = rw->reader_threads[i];
+            if (t != NULL && t->read_donation < cur->priority)
+              {
+                t->read_donation = cur->priority;
+                thread_donate_priority (t, cur->priority);
+              }
+          }
+      rw->writer_waiting = true;
+      sema_down (&rw->drained);
+    }
+  rw->writer_waiting = false;
+  intr_set_level (old_level);
+}
+
+/* Releases RW, which the current thread must hold for
+   writing. */
+void
+rwlock_write_release (struct rwlock *rw)
+{
+  ASSERT (rw != NULL);
+  ASSERT (rwlock_write_held_by_current_thread (rw));
+
+  lock_release (&rw->writer_lock);
+}
+
+/* Returns true if the current thread holds RW for writing, false
+   otherwise. */
+bool
+rwlock_write_held_by_current_thread (const struct rwlock *rw)
+{
+  ASSERT (rw != NULL);
+
+  return lock_held_by_current_thread (&rw->writer_lock)
+         && rw->readers == 0;
+}
+
 /* One semaphore in a list. */
 struct semaphore_elem 
   {
     struct list_elem elem;              /* List element. */
     struct semaphore semaphore;         /* This semaphore. */
+    struct thread *thread;              /* Thread waiting on it. */
   };
 
 /* Initializes condition variable COND.  A condition variable
    allows one piece of code to signal a condition and cooperating
-   code to receive the signal and act upon it. */
+   code to receive the signal and act upon it.
+
+   Like a semaphore's, COND's waiters are kept sorted by
+   priority.  A waiter's place is fixed when it starts waiting,
+   so a priority change during the wait is not reflected. */
 void
 cond_init (struct condition *cond)
 {
@@ -295,14 +774,16 @@ cond_wait (struct condition *cond, struct lock *lock)
   ASSERT (lock_held_by_current_thread (lock));
   
   sema_init (&waiter.semaphore, 0);
-  list_push_back (&cond->waiters, &waiter.elem);
+  waiter.thread = thread_current ();
+  insert_by_priority (&cond->waiters, &waiter.elem, cond_waiter_less);
   lock_release (lock);
   sema_down (&waiter.semaphore);
   lock_acquire (lock);
 }
 
 /* If any threads are waiting on COND (protected by LOCK), then
-   this function signals one of them to wake up from its wait.
+   this function signals the highest-priority one to wake up from
+   its wait.
    LOCK must be held before calling this function.
 
    An interrupt handler cannot acquire a lock, so it does not
@@ -336,3 +817,106 @@ cond_broadcast (struct condition *cond, struct lock *lock)
   while (!list_empty (&cond->waiters))
     cond_signal (cond, lock);
 }
+
+/* Returns true if the thread waiting on condition variable
+   waiter A has lower priority than the one waiting on B, false
+   otherwise. */
+static bool
+cond_waiter_less (const struct list_elem *a_, const struct list_elem *b_,
+                  void *aux UNUSED)
+{
+  const struct semaphore_elem *a = list_entry (a_, struct semaphore_elem,
+                                               elem);
+  const struct semaphore_elem *b = list_entry (b_, struct semaphore_elem,
+                                               elem);
+
+  return a->thread->priority < b->thread->priority;
+}
+
+/* Initializes spin lock LOCK as released. */
+void
+spinlock_init (struct spinlock *lock)
+{
+  ASSERT (lock != NULL);
+
+  lock->locked = 0;
+  lock->name = NULL;
+  lock->acquisitions = 0;
+  lock->contentions = 0;
+}
+
+/* Names spin lock LOCK NAME and adds it to the spin locks that
+   lock_print_stats() reports.  NAME must remain valid as long as
+   LOCK exists, and LOCK must never be destroyed. */
+void
+spinlock_set_name (struct spinlock *lock, const char *name)
+{
+  enum intr_level old_level;
+
+  ASSERT (lock != NULL);
+  ASSERT (name != NULL);
+  ASSERT (lock->name == NULL);
+
+  lock->name = name;
+  old_level = intr_disable ();
+  list_push_back (&named_spinlocks, &lock->stats_elem);
+  intr_set_level (old_level);
+}
+
+/* Acquires spin lock LOCK, busy-waiting until it is released if
+   another CPU holds it.  Interrupts must be off, so that the
+   holder cannot be preempted while other CPUs spin.
+
+   On a single CPU with interrupts off the lock can never be
+   contended, so this costs one locked exchange. */
+void
+spinlock_acquire (struct spinlock *lock)
+{
+  uint32_t held = 1;
+  bool contended = false;
+
+  ASSERT (lock != NULL);
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  /* XCHG with a memory operand is implicitly locked.  See
+     [IA32-v2b] "XCHG".  While the lock is held, spin on a plain
+     read, which does not take the cache line away from the
+     holder, and use PAUSE to tell the CPU that this is a spin
+     loop. */
+  for (;;)
+    {
+      asm volatile ("xchgl %0, %1" : "+r" (held), "+m" (lock->locked)
+                    : : "memory");
+      if (held == 0)
+        break;
+      contended = true;
+      while (lock->locked != 0)
+        asm volatile ("pause");
+      held = 1;
+    }
+
+  /* The counters are only updated with LOCK held. */
+  lock->acquisitions++;
+  if (contended)
+    lock->contentions++;
+}
+
+/* Releases spin lock LOCK, which must be held. */
+void
+spinlock_release (struct spinlock *lock)
+{
+  ASSERT (lock != NULL);
+  ASSERT (lock->locked != 0);
+
+  barrier ();
+  lock->locked = 0;
+}
+
+/* Returns true if some CPU holds spin lock LOCK. */
+bool
+spinlock_held (const struct spinlock *lock)
+{
+  ASSERT (lock != NULL);
+
+  return lock->locked != 0;
+}
@@ -3,6 +3,7 @@
 
 #include <list.h>
 #include <stdbool.h>
+#include <stdint.h>
 
 /* A counting semaphore. */
 struct semaphore 
@@ -17,19 +18,54 @@ bool sema_try_down (struct semaphore *);
 void sema_up (struct semaphore *);
 void sema_self_test (void);
 
+struct thread;
+void sema_reposition_waiter (struct thread *);
+
 /* Lock. */
 struct lock 
   {
-    struct thread *holder;      /* Thread holding lock (for debugging). */
+    struct thread *volatile holder; /* Thread holding lock. */
     struct semaphore semaphore; /* Binary semaphore controlling access. */
+    struct list_elem elem;      /* Element in holder's locks_held list. */
+    int max_priority;           /* Highest priority among waiters. */
+    bool adaptive;              /* Spin or yield before blocking? */
+
+    /* Contention statistics. */
+    const char *name;           /* Name, if listed by lock_print_stats(). */
+    struct list_elem stats_elem; /* Element in list of named locks. */
+    long long acquisitions;     /* # of times acquired. */
+    long long contentions;      /* # of times found already held. */
+    long long blocks;           /* # of contended acquisitions that slept. */
+    int64_t wait_ticks;         /* Timer ticks spent waiting. */
   };
 
 void lock_init (struct lock *);
+void lock_init_adaptive (struct lock *);
+void lock_set_name (struct lock *, const char *name);
+void lock_print_stats (void);
 void lock_acquire (struct lock *);
 bool lock_try_acquire (struct lock *);
 void lock_release (struct lock *);
 bool lock_held_by_current_thread (const struct lock *);
 
+/* Reader-writer lock. */
+#define RWLOCK_READER_SLOTS 8
+struct rwlock
+  {
+    struct lock writer_lock;    /* Held by the writer; queues waiters. */
+    struct semaphore drained;   /* Upped when the last reader leaves. */
+    int readers;                /* Number of active readers. */
+    bool writer_waiting;        /* Writer waiting for readers to leave? */
+    struct thread *reader_threads[RWLOCK_READER_SLOTS]; /* For donation. */
+  };
+
+void rwlock_init (struct rwlock *);
+void rwlock_read_acquire (struct rwlock *);
+void rwlock_read_release (struct rwlock *);
+void rwlock_write_acquire (struct rwlock *);
+void rwlock_write_release (struct rwlock *);
+bool rwlock_write_held_by_current_thread (const struct rwlock *);
+
 /* Condition variable. */
 struct condition 
   {
@@ -41,6 +77,27 @@ void cond_wait (struct condition *, struct lock *);
 void cond_signal (struct condition *, struct lock *);
 void cond_broadcast (struct condition *, struct lock *);
 
+/* Spin lock, for data that more than one CPU may touch.  A spin
+   lock may only be held with interrupts off, and only for a few
+   instructions, because waiters busy-wait instead of
+   sleeping. */
+struct spinlock
+  {
+    volatile uint32_t locked;   /* Nonzero while held. */
+
+    /* Contention statistics. */
+    const char *name;           /* Name, if listed by lock_print_stats(). */
+    struct list_elem stats_elem; /* Element in list of named spin locks. */
+    long long acquisitions;     /* # of times acquired. */
+    long long contentions;      /* # of times found already held. */
+  };
+
+void spinlock_init (struct spinlock *);
+void spinlock_set_name (struct spinlock *, const char *name);
+void spinlock_acquire (struct spinlock *);
+void spinlock_release (struct spinlock *);
+bool spinlock_held (const struct spinlock *);
+
 /* Optimization barrier.
 
    The compiler will not reorder operations across an
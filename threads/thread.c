@@ -2,15 +2,20 @@
 #include <debug.h>
 #include <stddef.h>
 #include <random.h>
+#include <round.h>
 #include <stdio.h>
 #include <string.h>
+#include "threads/cpu.h"
+#include "threads/defer.h"
 #include "threads/flags.h"
 #include "threads/interrupt.h"
 #include "threads/intr-stubs.h"
 #include "threads/palloc.h"
 #include "threads/switch.h"
 #include "threads/synch.h"
+#include "threads/trace.h"
 #include "threads/vaddr.h"
+#include "devices/lapic.h"
 #include "devices/timer.h"
 
 #ifdef USERPROG
@@ -22,23 +27,33 @@
    of thread.h for details. */
 #define THREAD_MAGIC 0xcd6abf4b
 
-/* List of processes in THREAD_READY state, that is, processes
-   that are ready to run but not actually running. */
-static struct list ready_list;
+/* Processes in THREAD_READY state, that is, processes that are
+   ready to run but not actually running, are kept in per-CPU run
+   queues.  See struct run_queue in cpu.h. */
 
 /* List of all processes.  Processes are added to this list
    when they are first scheduled and removed when they exit. */
 static struct list all_list;
 
-/* Idle thread. */
-static struct thread *idle_thread;
-
 /* Initial thread, the thread running init.c:main(). */
 static struct thread *initial_thread;
 
 /* Lock used by allocate_tid(). */
 static struct lock tid_lock;
 
+/* Cache of pages freed by dying threads, for reuse by
+   thread_create().  Recycling a page skips the page allocator's
+   lock and bitmap scan.  A cached page is kept zeroed except for
+   its `struct thread' and the part of its stack that the dying
+   thread touched; see alloc_thread_page() for how those are
+   cleared.  Accessed with interrupts off, since pages are added
+   from thread_schedule_tail(). */
+#define THREAD_CACHE_MAX 16     /* Maximum number of cached pages. */
+static struct thread *thread_cache[THREAD_CACHE_MAX];
+static size_t thread_cache_cnt;
+static long long thread_cache_hits;     /* # of pages reused. */
+static long long thread_cache_misses;   /* # of pages from palloc. */
+
 /* Stack frame for kernel_thread(). */
 struct kernel_thread_frame 
   {
@@ -47,38 +62,153 @@ struct kernel_thread_frame
     void *aux;                  /* Auxiliary data for function. */
   };
 
-/* Statistics. */
-static long long idle_ticks;    /* # of timer ticks spent idle. */
-static long long kernel_ticks;  /* # of timer ticks in kernel threads. */
-static long long user_ticks;    /* # of timer ticks in user programs. */
-
 /* Scheduling. */
 #define TIME_SLICE 4            /* # of timer ticks to give each thread. */
-static unsigned thread_ticks;   /* # of timer ticks since last yield. */
+
+/* Load balancing.  An idle CPU steals a thread from the busiest
+   other CPU whenever its own run queue runs dry, and every
+   BALANCE_INTERVAL ticks a busy CPU pulls one thread from the
+   busiest other CPU if that one has at least BALANCE_IMBALANCE
+   more runnable threads.  Threads that ran within the last
+   CACHE_HOT_TICKS ticks are left where they are, since their
+   working set is probably still in that CPU's cache, and so are
+   threads that changed CPU within that time; this keeps threads
+   from bouncing between CPUs on every balance pass. */
+#define BALANCE_INTERVAL 4      /* # of timer ticks between passes. */
+#define BALANCE_IMBALANCE 2     /* Minimum load difference to act on. */
+#define CACHE_HOT_TICKS 2       /* Ticks a thread stays cache-hot. */
 
 /* If false (default), use round-robin scheduler.
    If true, use multi-level feedback queue scheduler.
    Controlled by kernel command-line option "-o mlfqs". */
 bool thread_mlfqs;
 
+/* If false (default), use the round-robin or MLFQS scheduler.
+   If true, use the completely fair scheduler.
+   Controlled by kernel command-line option "-o cfs". */
+bool thread_cfs;
+
+/* Completely fair scheduler.  Each thread's vruntime is the CPU
+   time it has used, in nanoseconds, scaled by CFS_NICE_0_WEIGHT
+   over the weight for its nice value, and the ready thread with
+   the least vruntime runs next.  The running thread's time slice
+   is its weighted share of CFS_LATENCY ticks among the threads on
+   its CPU, but at least CFS_MIN_GRANULARITY ticks.  A waking
+   thread's vruntime is raised to at least half a latency period
+   below the run queue's min_vruntime, so that a long sleep earns
+   a brief head start rather than a monopoly.  A woken thread
+   preempts the running one only if it is behind by more than
+   CFS_WAKEUP_GRAN. */
+#define NS_PER_TICK (1000000000 / TIMER_FREQ)
+#define CFS_LATENCY 8           /* Target latency, in timer ticks. */
+#define CFS_MIN_GRANULARITY 1   /* Minimum time slice, in timer ticks. */
+#define CFS_WAKEUP_GRAN (NS_PER_TICK / 10)      /* In ns. */
+#define CFS_NICE_0_WEIGHT 1024
+
+/* CFS weight for each nice value from NICE_MIN to NICE_MAX.  Each
+   step changes the weight by about 25%, so a thread gets about
+   10% more CPU than one whose nice value is one higher. */
+static const int cfs_weights[NICE_MAX - NICE_MIN + 1] =
+  {
+    /* -20 */ 88761, 71755, 56483, 46273, 36291,
+    /* -15 */ 29154, 23254, 18705, 14949, 11916,
+    /* -10 */  9548,  7620,  6100,  4904,  3906,
+    /*  -5 */  3121,  2501,  1991,  1586,  1277,
+    /*   0 */  1024,   820,   655,   526,   423,
+    /*   5 */   335,   272,   215,   172,   137,
+    /*  10 */   110,    87,    70,    56,    45,
+    /*  15 */    36,    29,    23,    18,    15,
+    /*  20 */    12,
+  };
+
+/* Earliest-deadline-first real-time class.  A thread that calls
+   thread_set_deadline() gets up to BUDGET ticks of CPU time in
+   every PERIOD ticks, and runs ahead of every other thread while
+   it has budget left, with the earliest deadline first.  A
+   thread that uses up its budget is throttled until its next
+   period.  Admission control keeps the total utilization, the sum
+   of BUDGET / PERIOD over each CPU's EDF threads, at or below
+   EDF_UTIL_MAX, which is 100%; under that bound EDF meets every
+   deadline. */
+#define EDF_UTIL_MAX 1000000    /* 100% utilization, in ppm. */
+
+/* Multi-level feedback queue scheduler state. */
+#define MLFQS_PRI_INTERVAL 4    /* Ticks between priority updates. */
+#define MLFQS_DECAY_BATCH 8     /* Threads decayed per interrupts-off span. */
+static fixed_point load_avg;    /* System load average. */
+
+/* Threads whose recent_cpu will change at the next once-per-second
+   update, that is, those with nonzero recent_cpu or nice.  A
+   thread with both at zero keeps both at zero, and its priority
+   at PRI_MAX, until it runs or changes its nice value, so it can
+   be left out of the update entirely. */
+static struct list mlfqs_decay_list;
+
+/* Threads charged recent_cpu since the last priority update.
+   Their priorities are recomputed every MLFQS_PRI_INTERVAL
+   ticks, even if they have blocked or yielded since they ran.
+   No other thread's recent_cpu changes between once-per-second
+   updates. */
+static struct list mlfqs_charged_list;
+
+/* The once-per-second decay of recent_cpu takes time proportional
+   to the length of mlfqs_decay_list, so it runs as deferred work
+   instead of in the timer interrupt.  Each pass has a generation
+   number, so that a pass can turn interrupts back on between
+   batches and still decay each thread exactly once. */
+static struct deferred_work mlfqs_decay_work;
+static fixed_point mlfqs_decay;         /* Decay factor for this pass. */
+static unsigned mlfqs_decay_gen;        /* Generation of this pass. */
+static void mlfqs_decay_pass (void *aux);
+
 static void kernel_thread (thread_func *, void *aux);
 
 static void idle (void *aux UNUSED);
-static struct thread *running_thread (void);
+static intr_handler_func resched_ipi;
 static struct thread *next_thread_to_run (void);
 static void init_thread (struct thread *, const char *name, int priority);
 static bool is_thread (struct thread *) UNUSED;
+static struct thread *alloc_thread_page (void);
+static void free_thread_page (struct thread *);
+static bool is_idle_thread (const struct thread *);
+static bool mlfqs_exempt (const struct thread *);
 static void *alloc_frame (struct thread *, size_t size);
 static void schedule (void);
 void thread_schedule_tail (struct thread *prev);
 static tid_t allocate_tid (void);
+static void ready_queue_push (struct thread *);
+static void ready_queue_remove (struct thread *);
+static int ready_queue_highest (struct run_queue *);
+static int cpu_load (const struct cpu *);
+static struct cpu *busiest_cpu (const struct cpu *);
+static struct thread *steal_thread (struct cpu *thief, struct cpu *victim);
+static bool cache_hot (const struct thread *, int64_t now);
+static void balance_load (struct cpu *);
+static void change_priority (struct thread *, int priority);
+static void mlfqs_tick (struct thread *);
+static void mlfqs_update_priority (struct thread *);
+static void mlfqs_track (struct thread *);
+static void mlfqs_untrack (struct thread *);
+static bool uses_cfs (const struct thread *);
+static bool uses_edf (const struct thread *);
+static unsigned edf_utilization (const struct thread *);
+static void edf_pend (struct thread *);
+static void edf_release (struct cpu *);
+static int cfs_weight (const struct thread *);
+static void cfs_charge (struct thread *);
+static void cfs_update_min (struct run_queue *, const struct thread *cur);
+static unsigned time_slice (const struct thread *);
+static bool outranks (const struct thread *, const struct thread *cur);
+static bool queue_outranks (struct run_queue *, const struct thread *cur);
+static void print_cycles (void);
+static void print_thread_cycles (struct thread *, void *aux);
 
 /* Initializes the threading system by transforming the code
    that's currently running into a thread.  This can't work in
    general and it is possible in this case only because loader.S
    was careful to put the bottom of the stack at a page boundary.
 
-   Also initializes the run queue and the tid lock.
+   Also initializes the boot CPU's run queue and the tid lock.
 
    After calling this function, be sure to initialize the page
    allocator before trying to create any threads with
@@ -91,17 +221,44 @@ thread_init (void)
 {
   ASSERT (intr_get_level () == INTR_OFF);
 
-  lock_init (&tid_lock);
-  list_init (&ready_list);
+  lock_init_adaptive (&tid_lock);
+  lock_set_name (&tid_lock, "tid_lock");
   list_init (&all_list);
+  list_init (&mlfqs_decay_list);
+  list_init (&mlfqs_charged_list);
+  deferred_work_init (&mlfqs_decay_work, mlfqs_decay_pass, NULL);
 
   /* Set up a thread structure for the running thread. */
   initial_thread = running_thread ();
   init_thread (initial_thread, "main", PRI_DEFAULT);
+  initial_thread->cpu = &cpus[0];
   initial_thread->status = THREAD_RUNNING;
+
+  /* Only now can intr_context() find the CPU. */
+  cpu_init ();
+  cpus[0].running = initial_thread;
   initial_thread->tid = allocate_tid ();
 }
 
+/* Sets up the idle thread of application processor C, which
+   runs it first, and returns the top of its stack, or returns a
+   null pointer if memory is short.  Called on the boot
+   processor by cpu_start_aps(). */
+void *
+thread_init_ap (struct cpu *c) 
+{
+  struct thread *t = alloc_thread_page ();
+
+  if (t == NULL)
+    return NULL;
+  init_thread (t, "idle", PRI_MIN);
+  t->cpu = c;
+  t->status = THREAD_RUNNING;
+  t->tid = allocate_tid ();
+  c->idle_thread = c->running = t;
+  return t->stack;
+}
+
 /* Starts preemptive thread scheduling by enabling interrupts.
    Also creates the idle thread. */
 void
@@ -111,33 +268,70 @@ thread_start (void)
   struct semaphore idle_started;
   sema_init (&idle_started, 0);
   thread_create ("idle", PRI_MIN, idle, &idle_started);
+  intr_register_ipi (IPI_RESCHEDULE, resched_ipi, "Reschedule IPI");
 
   /* Start preemptive thread scheduling. */
   intr_enable ();
 
-  /* Wait for the idle thread to initialize idle_thread. */
+  /* Wait for the idle thread to register itself with its CPU. */
   sema_down (&idle_started);
 }
 
+/* Starts scheduling on an application processor, which must be
+   running the idle thread set up by thread_init_ap(), with
+   interrupts off. */
+void
+thread_start_ap (void) 
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+  ASSERT (thread_current () == cpu_current ()->idle_thread);
+
+  idle (NULL);
+  NOT_REACHED ();
+}
+
 /* Called by the timer interrupt handler at each timer tick.
    Thus, this function runs in an external interrupt context. */
 void
 thread_tick (void) 
 {
   struct thread *t = thread_current ();
+  struct cpu *c = t->cpu;
 
   /* Update statistics. */
-  if (t == idle_thread)
-    idle_ticks++;
+  if (t == c->idle_thread)
+    c->idle_ticks++;
 #ifdef USERPROG
   else if (t->pagedir != NULL)
-    user_ticks++;
+    c->user_ticks++;
 #endif
   else
-    kernel_ticks++;
+    c->kernel_ticks++;
+
+  if (thread_mlfqs)
+    mlfqs_tick (t);
+  else if (thread_cfs && uses_cfs (t))
+    {
+      spinlock_acquire (&c->rq.lock);
+      cfs_charge (t);
+      cfs_update_min (&c->rq, t);
+      spinlock_release (&c->rq.lock);
+    }
+
+  /* Enforce EDF budgets and start new EDF periods. */
+  if (uses_edf (t) && !t->edf_throttled && --t->edf_left <= 0)
+    {
+      t->edf_throttled = true;
+      intr_yield_on_return ();
+    }
+  edf_release (c);
+
+  /* Even out the load with the other CPUs. */
+  if (cpu_cnt > 1 && timer_ticks () % BALANCE_INTERVAL == 0)
+    balance_load (c);
 
   /* Enforce preemption. */
-  if (++thread_ticks >= TIME_SLICE)
+  if (++c->thread_ticks >= time_slice (t))
     intr_yield_on_return ();
 }
 
@@ -145,8 +339,88 @@ thread_tick (void)
 void
 thread_print_stats (void) 
 {
+  long long idle_ticks = 0, kernel_ticks = 0, user_ticks = 0;
+  unsigned i;
+
+  for (i = 0; i < cpu_cnt; i++)
+    {
+      idle_ticks += cpus[i].idle_ticks;
+      kernel_ticks += cpus[i].kernel_ticks;
+      user_ticks += cpus[i].user_ticks;
+    }
   printf ("Thread: %lld idle ticks, %lld kernel ticks, %lld user ticks\n",
           idle_ticks, kernel_ticks, user_ticks);
+  printf ("Thread page cache: %lld hits, %lld misses\n",
+          thread_cache_hits, thread_cache_misses);
+  print_cycles ();
+}
+
+/* Prints per-CPU scheduling statistics. */
+void
+thread_print_cpu_stats (void) 
+{
+  unsigned i;
+
+  for (i = 0; i < cpu_cnt; i++)
+    printf ("CPU %u: %lld idle ticks, %lld steals, %lld migrations\n",
+            cpus[i].id, cpus[i].idle_ticks, cpus[i].steals,
+            cpus[i].migrations);
+}
+
+/* Stores the number of CPU cycles that the running thread has
+   used so far into CYCLES, indexed by enum cpu_mode. */
+void
+thread_get_cycles (uint64_t cycles[CPU_MODE_CNT]) 
+{
+  struct thread *t = thread_current ();
+  enum intr_level old_level;
+  int mode;
+
+  old_level = intr_disable ();
+  cpu_account (cpu_current ()->mode);
+  for (mode = 0; mode < CPU_MODE_CNT; mode++)
+    cycles[mode] = t->cycles[mode];
+  intr_set_level (old_level);
+}
+
+/* Prints the CPU cycles used by all threads since boot, and by
+   each thread that still exists. */
+static void
+print_cycles (void) 
+{
+  uint64_t idle = 0, cycles[CPU_MODE_CNT] = { 0, 0, 0 };
+  enum intr_level old_level;
+  unsigned i;
+  int mode;
+
+  old_level = intr_disable ();
+  cpu_account (cpu_current ()->mode);
+  intr_set_level (old_level);
+
+  for (i = 0; i < cpu_cnt; i++)
+    {
+      idle += cpus[i].idle_cycles;
+      for (mode = 0; mode < CPU_MODE_CNT; mode++)
+        cycles[mode] += cpus[i].cycles[mode];
+    }
+  printf ("Thread: %llu idle cycles, %llu kernel cycles, "
+          "%llu user cycles, %llu interrupt cycles\n",
+          idle, cycles[CPU_MODE_KERNEL], cycles[CPU_MODE_USER],
+          cycles[CPU_MODE_INTR]);
+
+  old_level = intr_disable ();
+  thread_foreach (print_thread_cycles, NULL);
+  intr_set_level (old_level);
+}
+
+/* Prints the CPU cycles used by thread T.  Used by
+   print_cycles() via thread_foreach(). */
+static void
+print_thread_cycles (struct thread *t, void *aux UNUSED) 
+{
+  printf ("  %5d %-16s %12llu kernel, %12llu user, %12llu interrupt\n",
+          t->tid, t->name, t->cycles[CPU_MODE_KERNEL],
+          t->cycles[CPU_MODE_USER], t->cycles[CPU_MODE_INTR]);
 }
 
 /* Creates a new kernel thread named NAME with the given initial
@@ -161,12 +435,23 @@ thread_print_stats (void)
    scheduled.  Use a semaphore or some other form of
    synchronization if you need to ensure ordering.
 
-   The code provided sets the new thread's `priority' member to
-   PRIORITY, but no actual priority scheduling is implemented.
-   Priority scheduling is the goal of Problem 1-3. */
+   If the new thread has a higher priority than the running
+   thread, the running thread yields to it immediately.  Under
+   the MLFQS, PRIORITY is ignored: the new thread inherits the
+   running thread's nice and recent_cpu values and its priority
+   is computed from them. */
 tid_t
 thread_create (const char *name, int priority,
                thread_func *function, void *aux) 
+{
+  return thread_create_on (cpu_current (), name, priority, function, aux);
+}
+
+/* Like thread_create(), but queues the new thread on CPU C,
+   which need not be online yet. */
+tid_t
+thread_create_on (struct cpu *c, const char *name, int priority,
+                  thread_func *function, void *aux) 
 {
   struct thread *t;
   struct kernel_thread_frame *kf;
@@ -179,17 +464,30 @@ thread_create (const char *name, int priority,
   ASSERT (function != NULL);
 
   /* Allocate thread. */
-  t = palloc_get_page (PAL_ZERO);
+  t = alloc_thread_page ();
   if (t == NULL)
     return TID_ERROR;
 
   /* Initialize thread. */
   init_thread (t, name, priority);
+  t->cpu = c;
+  t->vruntime = t->cpu->rq.min_vruntime;
   tid = t->tid = allocate_tid ();
 
   /* Initialize parent */
   pid = t->pid = thread_current()->tid;
 
+  /* The idle thread always keeps priority PRI_MIN. */
+  if (thread_mlfqs && function != idle)
+    {
+      t->nice = thread_current ()->nice;
+      t->recent_cpu = thread_current ()->recent_cpu;
+      mlfqs_update_priority (t);
+      old_level = intr_disable ();
+      mlfqs_track (t);
+      intr_set_level (old_level);
+    }
+
   /* Prepare thread for first run by initializing its stack.
      Do this atomically so intermediate values for the 'stack' 
      member cannot be observed. */
@@ -214,6 +512,7 @@ thread_create (const char *name, int priority,
 
   /* Add to run queue. */
   thread_unblock (t);
+  thread_yield_to_higher ();
 
   return tid;
 }
@@ -231,6 +530,7 @@ thread_block (void)
   ASSERT (intr_get_level () == INTR_OFF);
 
   thread_current ()->status = THREAD_BLOCKED;
+  trace_event (TRACE_BLOCK, thread_current (), 0);
   schedule ();
 }
 
@@ -241,7 +541,10 @@ thread_block (void)
    This function does not preempt the running thread.  This can
    be important: if the caller had disabled interrupts itself,
    it may expect that it can atomically unblock a thread and
-   update other data. */
+   update other data.  If T outranks the running thread, though,
+   the running thread yields as soon as it can: when the current
+   external interrupt handler returns, or else when interrupts
+   are turned back on. */
 void
 thread_unblock (struct thread *t) 
 {
@@ -251,8 +554,29 @@ thread_unblock (struct thread *t)
 
   old_level = intr_disable ();
   ASSERT (t->status == THREAD_BLOCKED);
-  list_push_back (&ready_list, &t->elem);
+  trace_event (TRACE_UNBLOCK, t, t->priority);
+  if (uses_cfs (t))
+    {
+      int64_t floor = (t->cpu->rq.min_vruntime
+                       - CFS_LATENCY * NS_PER_TICK / 2);
+      if (t->vruntime < floor)
+        t->vruntime = floor;
+    }
+  ready_queue_push (t);
   t->status = THREAD_READY;
+  if (t->cpu != cpu_current ())
+    {
+      /* A CPU that never ran a thread is not online. */
+      if (t->cpu->running != NULL && outranks (t, t->cpu->running))
+        cpu_kick (t->cpu);
+    }
+  else if (outranks (t, running_thread ()))
+    {
+      if (intr_context ())
+        intr_yield_on_return ();
+      else
+        cpu_current ()->yield_pending = true;
+    }
   intr_set_level (old_level);
 }
 
@@ -304,7 +628,9 @@ thread_exit (void)
      and schedule another process.  That process will destroy us
      when it calls thread_schedule_tail(). */
   intr_disable ();
+  thread_current ()->cpu->edf_util -= edf_utilization (thread_current ());
   list_remove (&thread_current()->allelem);
+  mlfqs_untrack (thread_current ());
   thread_current ()->status = THREAD_DYING;
   schedule ();
   NOT_REACHED ();
@@ -321,13 +647,47 @@ thread_yield (void)
   ASSERT (!intr_context ());
 
   old_level = intr_disable ();
-  if (cur != idle_thread) 
-    list_push_back (&ready_list, &cur->elem);
+  trace_event (TRACE_YIELD, cur, cur->priority);
+  if (!is_idle_thread (cur)) 
+    ready_queue_push (cur);
   cur->status = THREAD_READY;
   schedule ();
   intr_set_level (old_level);
+}
+
+/* Yields the CPU if some ready thread outranks the running
+   thread.  Within an external interrupt handler the yield is
+   deferred until the handler returns, and with interrupts off
+   it is deferred until intr_enable() turns them back on, so
+   that the caller's atomic section is not cut short. */
+void
+thread_yield_to_higher (void)
+{
+  enum intr_level old_level = intr_disable ();
+  bool outranked = queue_outranks (&cpu_current ()->rq, thread_current ());
 
-  // printf("Time is %d\n", timer_ticks());
+  if (outranked)
+    {
+      if (intr_context ())
+        intr_yield_on_return ();
+      else if (old_level == INTR_OFF)
+        cpu_current ()->yield_pending = true;
+    }
+  intr_set_level (old_level);
+
+  if (outranked && old_level == INTR_ON)
+    thread_yield ();
+}
+
+/* Yields the CPU if thread_unblock() readied a higher-priority
+   thread on this CPU since the last thread switch.  Called when
+   interrupts are turned back on and on return from an internal
+   interrupt. */
+void
+thread_yield_pending (void)
+{
+  if (cpu_current ()->yield_pending && !intr_context ())
+    thread_yield ();
 }
 
 /* Invoke function 'func' on all threads, passing along 'aux'.
@@ -347,26 +707,125 @@ thread_foreach (thread_action_func *func, void *aux)
     }
 }
 
+/* Invoke function 'func' on all ready threads, CPU by CPU and
+   in the order they would be scheduled, passing along 'aux'.
+   Throttled EDF threads are not included.  This function must be
+   called with interrupts off. */
 void
 thread_ready_foreach (thread_action_func *func, void *aux)
 {
   struct list_elem *e;
+  struct rb_elem *r;
+  unsigned i;
+  int pri;
 
   ASSERT (intr_get_level () == INTR_OFF);
 
-  for (e = list_begin (&ready_list); e != list_end (&ready_list);
-       e = list_next (e))
+  for (i = 0; i < cpu_cnt; i++)
     {
-      struct thread *t = list_entry (e, struct thread, allelem);
-      func (t, aux);
+      struct run_queue *rq = &cpus[i].rq;
+
+      spinlock_acquire (&rq->lock);
+      for (r = rb_first (&rq->edf_tree); r != NULL; r = rb_next (r))
+        func (rb_entry (r, struct thread, edf_elem), aux);
+      for (pri = PRI_MAX; pri >= PRI_MIN; pri--)
+        for (e = list_begin (&rq->queues[pri]);
+             e != list_end (&rq->queues[pri]); e = list_next (e))
+          {
+            struct thread *t = list_entry (e, struct thread, elem);
+            func (t, aux);
+          }
+      for (r = rb_first (&rq->cfs_tree); r != NULL; r = rb_next (r))
+        func (rb_entry (r, struct thread, cfs_elem), aux);
+      spinlock_release (&rq->lock);
     }
 }
 
-/* Sets the current thread's priority to NEW_PRIORITY. */
+/* Sets the current thread's base priority to NEW_PRIORITY.  The
+   thread keeps running at any higher priority donated to it
+   through the locks it holds.  Yields if the running thread no
+   longer has the highest priority.  Has no effect under the
+   MLFQS, which computes priorities itself. */
 void
 thread_set_priority (int new_priority) 
 {
-  thread_current ()->priority = new_priority;
+  struct thread *cur = thread_current ();
+  enum intr_level old_level;
+
+  ASSERT (PRI_MIN <= new_priority && new_priority <= PRI_MAX);
+
+  if (thread_mlfqs)
+    return;
+
+  old_level = intr_disable ();
+  cur->base_priority = new_priority;
+  thread_recompute_priority (cur);
+  intr_set_level (old_level);
+
+  thread_yield_to_higher ();
+}
+
+/* Turns the running thread into a per-CPU kernel worker, such
+   as the deferred-work thread.  A worker runs at PRI_MAX under
+   either scheduler, takes no part in MLFQS accounting, and is
+   never moved to another CPU by the load balancer. */
+void
+thread_make_worker (void) 
+{
+  struct thread *cur = thread_current ();
+  enum intr_level old_level = intr_disable ();
+
+  cur->worker = true;
+  cur->base_priority = PRI_MAX;
+  mlfqs_untrack (cur);
+  change_priority (cur, PRI_MAX);
+  intr_set_level (old_level);
+}
+
+/* Raises T's effective priority to PRIORITY, if it is lower,
+   because a thread of that priority is waiting for a lock T
+   holds.  Interrupts must be off. */
+void
+thread_donate_priority (struct thread *t, int priority)
+{
+  ASSERT (is_thread (t));
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  if (priority > t->priority)
+    change_priority (t, priority);
+}
+
+/* Recomputes T's cached effective priority: the highest of its
+   base priority, the highest priority of any thread waiting for
+   a lock T holds, and any priority donated to T as a reader of
+   an rwlock.  Called only when T's base priority or the
+   set of locks it holds changes, so that the scheduler can use
+   the cached value directly.  Interrupts must be off.
+
+   Does nothing under the MLFQS, which does not donate. */
+void
+thread_recompute_priority (struct thread *t)
+{
+  struct list_elem *e;
+  int priority;
+
+  ASSERT (is_thread (t));
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  if (thread_mlfqs)
+    return;
+
+  priority = t->base_priority;
+  if (t->read_donation > priority)
+    priority = t->read_donation;
+  for (e = list_begin (&t->locks_held); e != list_end (&t->locks_held);
+       e = list_next (e))
+    {
+      struct lock *lock = list_entry (e, struct lock, elem);
+      if (lock->max_priority > priority)
+        priority = lock->max_priority;
+    }
+  change_priority (t, priority);
 }
 
 /* Returns the current thread's priority. */
@@ -376,52 +835,529 @@ thread_get_priority (void)
   return thread_current ()->priority;
 }
 
-/* Sets the current thread's nice value to NICE. */
+/* Makes the running thread an EDF real-time thread that may run
+   for BUDGET timer ticks in every PERIOD ticks, starting now, or
+   returns it to normal scheduling if PERIOD is 0.  Returns false,
+   without changing anything, if admitting the thread would raise
+   its CPU's EDF utilization above 100%.
+
+   An EDF thread should call thread_wait_period() when it has
+   finished each period's work. */
+bool
+thread_set_deadline (int64_t period, int64_t budget)
+{
+  struct thread *cur = thread_current ();
+  struct cpu *c;
+  enum intr_level old_level;
+  unsigned util = 0;
+  bool admitted;
+
+  ASSERT (period >= 0);
+  if (period > 0)
+    {
+      ASSERT (budget > 0 && budget <= period);
+      util = DIV_ROUND_UP (budget * EDF_UTIL_MAX, period);
+    }
+
+  old_level = intr_disable ();
+  c = cur->cpu;
+  admitted = c->edf_util - edf_utilization (cur) + util <= EDF_UTIL_MAX;
+  if (admitted)
+    {
+      c->edf_util = c->edf_util - edf_utilization (cur) + util;
+      cur->edf_period = period;
+      cur->edf_budget = budget;
+      cur->edf_deadline = timer_ticks () + period;
+      cur->edf_left = budget;
+      cur->edf_throttled = false;
+      if (period == 0 && cur->vruntime < c->rq.min_vruntime)
+        cur->vruntime = c->rq.min_vruntime;
+    }
+  intr_set_level (old_level);
+
+  if (admitted)
+    thread_yield_to_higher ();
+  return admitted;
+}
+
+/* Blocks the running EDF thread until its next period starts.
+   If the current period's deadline has already passed, counts a
+   missed deadline and starts the next period at once. */
 void
-thread_set_nice (int nice UNUSED) 
+thread_wait_period (void)
 {
-  /* Not yet implemented. */
+  struct thread *cur = thread_current ();
+  enum intr_level old_level;
+
+  ASSERT (!intr_context ());
+  ASSERT (uses_edf (cur));
+
+  old_level = intr_disable ();
+  if (timer_ticks () >= cur->edf_deadline)
+    {
+      cur->edf_misses++;
+      cur->edf_deadline = timer_ticks () + cur->edf_period;
+      cur->edf_left = cur->edf_budget;
+    }
+  else
+    {
+      /* Finishing on the tick that used up the budget is on
+         time. */
+      cur->edf_throttled = false;
+      edf_pend (cur);
+      thread_block ();
+    }
+  intr_set_level (old_level);
+}
+
+/* Returns the number of deadlines the running thread has
+   missed, either by finishing a period's work late or by
+   running out of budget before finishing it. */
+unsigned
+thread_deadline_misses (void)
+{
+  return thread_current ()->edf_misses;
+}
+
+/* Sets the current thread's nice value to NICE, recomputes its
+   priority, and yields if it no longer has the highest
+   priority. */
+void
+thread_set_nice (int nice) 
+{
+  struct thread *cur = thread_current ();
+  enum intr_level old_level;
+
+  ASSERT (NICE_MIN <= nice && nice <= NICE_MAX);
+
+  old_level = intr_disable ();
+  cur->nice = nice;
+  if (thread_mlfqs)
+    {
+      mlfqs_update_priority (cur);
+      mlfqs_track (cur);
+    }
+  intr_set_level (old_level);
+
+  thread_yield_to_higher ();
 }
 
 /* Returns the current thread's nice value. */
 int
 thread_get_nice (void) 
 {
-  /* Not yet implemented. */
-  return 0;
+  return thread_current ()->nice;
 }
 
 /* Returns 100 times the system load average. */
 int
 thread_get_load_avg (void) 
 {
-  /* Not yet implemented. */
-  return 0;
+  enum intr_level old_level = intr_disable ();
+  int load = fp_to_int_nearest (fp_mul_int (load_avg, 100));
+  intr_set_level (old_level);
+  return load;
 }
 
 /* Returns 100 times the current thread's recent_cpu value. */
 int
 thread_get_recent_cpu (void) 
 {
-  /* Not yet implemented. */
-  return 0;
+  enum intr_level old_level = intr_disable ();
+  int recent = fp_to_int_nearest (fp_mul_int (thread_current ()->recent_cpu,
+                                              100));
+  intr_set_level (old_level);
+  return recent;
 }
-
+
+/* Per-tick MLFQS bookkeeping for the running thread T, called
+   from the timer interrupt.
+
+   Only the running thread's recent_cpu changes from tick to
+   tick, so every MLFQS_PRI_INTERVAL ticks only the threads that
+   ran since the last update, those on mlfqs_charged_list, need
+   their priorities recomputed.  Once per second the load
+   average is updated and every thread on mlfqs_decay_list has
+   its recent_cpu decayed and its priority recomputed, by
+   mlfqs_decay_pass(); no other thread's values change. */
+static void
+mlfqs_tick (struct thread *t)
+{
+  int64_t now = timer_ticks ();
+
+  ASSERT (intr_context ());
+
+  if (!mlfqs_exempt (t))
+    {
+      t->recent_cpu = fp_add_int (t->recent_cpu, 1);
+      mlfqs_track (t);
+      if (!t->mlfqs_charged)
+        {
+          list_push_back (&mlfqs_charged_list, &t->charged_elem);
+          t->mlfqs_charged = true;
+        }
+    }
+
+  /* The boot processor takes the timer interrupt and passes each
+     tick on to the other CPUs, so it makes the updates that
+     concern every CPU once per tick, before the others see the
+     tick. */
+  if (t->cpu != &cpus[0])
+    {
+      if (now % MLFQS_PRI_INTERVAL == 0)
+        thread_yield_to_higher ();
+      return;
+    }
+
+  if (now % MLFQS_PRI_INTERVAL == 0)
+    while (!list_empty (&mlfqs_charged_list))
+      {
+        struct thread *c = list_entry (list_pop_front (&mlfqs_charged_list),
+                                       struct thread, charged_elem);
+        c->mlfqs_charged = false;
+        mlfqs_update_priority (c);
+      }
+
+  if (now % TIMER_FREQ == 0)
+    {
+      int ready_threads = 0;
+      unsigned i;
+
+      /* Count threads that are running or ready to run, leaving
+         out the idle threads and per-CPU workers.  The deferred
+         work thread in particular is often ready right now,
+         because this tick's sleepers were just handed to it. */
+      for (i = 0; i < cpu_cnt; i++)
+        ready_threads += (cpus[i].rq.load_cnt
+                          + !mlfqs_exempt (cpus[i].running));
+
+      load_avg = fp_add (fp_div_int (fp_mul_int (load_avg, 59), 60),
+                         fp_div_int (fp_from_int (ready_threads), 60));
+      mlfqs_decay = fp_div (fp_mul_int (load_avg, 2),
+                            fp_add_int (fp_mul_int (load_avg, 2), 1));
+      mlfqs_decay_gen++;
+      defer_schedule (&mlfqs_decay_work);
+    }
+  else if (now % MLFQS_PRI_INTERVAL == 0)
+    thread_yield_to_higher ();
+}
+
+/* Decays the recent_cpu of every thread on mlfqs_decay_list by
+   mlfqs_decay and recomputes its priority.  Runs as deferred
+   work, MLFQS_DECAY_BATCH threads at a time with interrupts
+   off.
+
+   Each decayed thread moves to the back of the list and is
+   stamped with the pass's generation, so the pass is over when
+   the front of the list carries the current generation.  A
+   thread that joins the list meanwhile is stamped on entry by
+   mlfqs_track(), since it was not on the list when the second
+   ended. */
+static void
+mlfqs_decay_pass (void *aux UNUSED) 
+{
+  bool done = false;
+
+  while (!done)
+    {
+      enum intr_level old_level = intr_disable ();
+      int i;
+
+      for (i = 0; i < MLFQS_DECAY_BATCH && !done; i++)
+        {
+          struct thread *d;
+
+          if (list_empty (&mlfqs_decay_list))
+            {
+              done = true;
+              break;
+            }
+          d = list_entry (list_front (&mlfqs_decay_list),
+                          struct thread, decay_elem);
+          if (d->decay_gen == mlfqs_decay_gen)
+            {
+              done = true;
+              break;
+            }
+
+          list_pop_front (&mlfqs_decay_list);
+          d->decay_gen = mlfqs_decay_gen;
+          d->recent_cpu = fp_add_int (fp_mul (mlfqs_decay, d->recent_cpu),
+                                      d->nice);
+          mlfqs_update_priority (d);
+          if (d->recent_cpu == 0 && d->nice == 0)
+            d->mlfqs_decaying = false;
+          else
+            list_push_back (&mlfqs_decay_list, &d->decay_elem);
+        }
+      intr_set_level (old_level);
+    }
+  thread_yield_to_higher ();
+}
+
+/* Recomputes T's priority from its recent_cpu and nice values:
+   PRI_MAX - recent_cpu / 4 - nice * 2, clamped to the valid
+   range. */
+static void
+mlfqs_update_priority (struct thread *t)
+{
+  int priority;
+
+  if (mlfqs_exempt (t))
+    return;
+
+  priority = fp_to_int_zero (fp_sub (fp_from_int (PRI_MAX - t->nice * 2),
+                                     fp_div_int (t->recent_cpu, 4)));
+  if (priority < PRI_MIN)
+    priority = PRI_MIN;
+  else if (priority > PRI_MAX)
+    priority = PRI_MAX;
+  change_priority (t, priority);
+}
+
+/* Adds T to mlfqs_decay_list if its recent_cpu or nice value is
+   nonzero and it is not already there.  Interrupts must be
+   off. */
+static void
+mlfqs_track (struct thread *t)
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  if (!t->mlfqs_decaying && (t->recent_cpu != 0 || t->nice != 0))
+    {
+      list_push_back (&mlfqs_decay_list, &t->decay_elem);
+      t->mlfqs_decaying = true;
+      t->decay_gen = mlfqs_decay_gen;
+    }
+}
+
+/* Removes T from the MLFQS lists it is on, because it is exiting
+   or leaving MLFQS accounting.  Interrupts must be off. */
+static void
+mlfqs_untrack (struct thread *t)
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  if (t->mlfqs_decaying)
+    {
+      list_remove (&t->decay_elem);
+      t->mlfqs_decaying = false;
+    }
+  if (t->mlfqs_charged)
+    {
+      list_remove (&t->charged_elem);
+      t->mlfqs_charged = false;
+    }
+}
+
+/* Returns true if T is scheduled by the CFS scheduler, which
+   handles every thread but the idle thread and per-CPU workers
+   when it is enabled. */
+static bool
+uses_cfs (const struct thread *t)
+{
+  return thread_cfs && !t->worker && !is_idle_thread (t) && !uses_edf (t);
+}
+
+/* Returns true if T is an EDF real-time thread. */
+static bool
+uses_edf (const struct thread *t)
+{
+  return t->edf_period != 0;
+}
+
+/* Returns T's share of its CPU as an EDF thread, in parts per
+   million, or 0 if T is not an EDF thread. */
+static unsigned
+edf_utilization (const struct thread *t)
+{
+  if (!uses_edf (t))
+    return 0;
+  return DIV_ROUND_UP (t->edf_budget * EDF_UTIL_MAX, t->edf_period);
+}
+
+/* Adds EDF thread T, which is out of budget or has finished its
+   work, to its CPU's list of threads waiting for their next
+   period, which starts at T's deadline.  Interrupts must be
+   off. */
+static void
+edf_pend (struct thread *t)
+{
+  struct list *pending = &t->cpu->edf_pending;
+  struct list_elem *e;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  for (e = list_begin (pending); e != list_end (pending); e = list_next (e))
+    if (list_entry (e, struct thread, elem)->edf_deadline > t->edf_deadline)
+      break;
+  list_insert (e, &t->elem);
+}
+
+/* Starts a new period for each EDF thread on C whose deadline has
+   arrived: refills its budget, moves its deadline one period on,
+   and makes it runnable again.  Called from the timer interrupt
+   on every tick. */
+static void
+edf_release (struct cpu *c)
+{
+  int64_t now = timer_ticks ();
+
+  while (!list_empty (&c->edf_pending))
+    {
+      struct thread *t = list_entry (list_front (&c->edf_pending),
+                                     struct thread, elem);
+      if (t->edf_deadline > now)
+        break;
+      list_pop_front (&c->edf_pending);
+
+      /* A throttled thread had not finished by its deadline. */
+      if (t->edf_throttled)
+        t->edf_misses++;
+      t->edf_throttled = false;
+      t->edf_deadline += t->edf_period;
+      t->edf_left = t->edf_budget;
+
+      if (t->status == THREAD_BLOCKED)
+        thread_unblock (t);
+      else
+        {
+          ready_queue_push (t);
+          if (outranks (t, thread_current ()))
+            intr_yield_on_return ();
+        }
+    }
+}
+
+/* Returns T's CFS weight, which follows its nice value. */
+static int
+cfs_weight (const struct thread *t)
+{
+  return cfs_weights[t->nice - NICE_MIN];
+}
+
+/* Charges running thread T for the CPU time since its vruntime
+   was last updated.  T must not be in a CFS tree, since this
+   changes its key. */
+static void
+cfs_charge (struct thread *t)
+{
+  int64_t now = timer_now_ns ();
+  int64_t delta = now - t->exec_start;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  t->exec_start = now;
+  if (uses_cfs (t) && delta > 0)
+    t->vruntime += delta * CFS_NICE_0_WEIGHT / cfs_weight (t);
+}
+
+/* Advances RQ's min_vruntime to the least vruntime of CUR, if it
+   is a CFS thread, and the threads in RQ's CFS tree.
+   min_vruntime never moves backward, so that it can serve as a
+   reference point for threads that join the tree. */
+static void
+cfs_update_min (struct run_queue *rq, const struct thread *cur)
+{
+  bool valid = false;
+  int64_t min = 0;
+
+  if (uses_cfs (cur))
+    {
+      min = cur->vruntime;
+      valid = true;
+    }
+  if (!rb_empty (&rq->cfs_tree))
+    {
+      const struct thread *first = rb_entry (rb_first (&rq->cfs_tree),
+                                             struct thread, cfs_elem);
+      if (!valid || first->vruntime < min)
+        min = first->vruntime;
+      valid = true;
+    }
+  if (valid && min > rq->min_vruntime)
+    rq->min_vruntime = min;
+}
+
+/* Returns the number of timer ticks that running thread T may
+   run before it is preempted. */
+static unsigned
+time_slice (const struct thread *t)
+{
+  unsigned long weight, total;
+  unsigned slice;
+
+  if (!uses_cfs (t))
+    return TIME_SLICE;
+
+  weight = cfs_weight (t);
+  total = t->cpu->rq.cfs_weight + weight;
+  slice = CFS_LATENCY * weight / total;
+  return slice > CFS_MIN_GRANULARITY ? slice : CFS_MIN_GRANULARITY;
+}
+
+/* Returns true if ready thread T should preempt running thread
+   CUR.  Every thread outranks the idle thread, which may be
+   zeroing pages.  EDF threads outrank all others, and among
+   themselves the earlier deadline wins.  Under CFS, per-CPU
+   workers outrank CFS threads, which are ordered among
+   themselves by vruntime; otherwise threads are ranked by
+   priority. */
+static bool
+outranks (const struct thread *t, const struct thread *cur)
+{
+  if (is_idle_thread (cur))
+    return true;
+  if (uses_edf (t) || uses_edf (cur))
+    return (uses_edf (t)
+            && (!uses_edf (cur) || t->edf_deadline < cur->edf_deadline));
+  if (!thread_cfs)
+    return t->priority > cur->priority;
+  if (uses_cfs (t) != uses_cfs (cur))
+    return !uses_cfs (t);
+  if (!uses_cfs (t))
+    return t->priority > cur->priority;
+  return t->vruntime + CFS_WAKEUP_GRAN < cur->vruntime;
+}
+
+/* Returns true if the thread that next_thread_to_run() would
+   pick from RQ outranks running thread CUR.  Interrupts must be
+   off. */
+static bool
+queue_outranks (struct run_queue *rq, const struct thread *cur)
+{
+  if (!rb_empty (&rq->edf_tree))
+    return outranks (rb_entry (rb_first (&rq->edf_tree), struct thread,
+                               edf_elem), cur);
+  if (rq->mask != 0)
+    {
+      struct list *queue = &rq->queues[ready_queue_highest (rq)];
+      return outranks (list_entry (list_front (queue), struct thread, elem),
+                       cur);
+    }
+  if (!rb_empty (&rq->cfs_tree))
+    return outranks (rb_entry (rb_first (&rq->cfs_tree), struct thread,
+                               cfs_elem), cur);
+  return false;
+}
+
 /* Idle thread.  Executes when no other thread is ready to run.
 
    The idle thread is initially put on the ready list by
    thread_start().  It will be scheduled once initially, at which
-   point it initializes idle_thread, "up"s the semaphore passed
+   point it registers itself as its CPU's idle_thread, "up"s the
+   semaphore passed
    to it to enable thread_start() to continue, and immediately
    blocks.  After that, the idle thread never appears in the
-   ready list.  It is returned by next_thread_to_run() as a
-   special case when the ready list is empty. */
+   run queues.  It is returned by next_thread_to_run() as a
+   special case when the run queues are empty. */
 static void
 idle (void *idle_started_ UNUSED) 
 {
   struct semaphore *idle_started = idle_started_;
-  idle_thread = thread_current ();
-  sema_up (idle_started);
+  cpu_current ()->idle_thread = thread_current ();
+  if (idle_started != NULL)
+    sema_up (idle_started);
 
   for (;;) 
     {
@@ -429,22 +1365,37 @@ idle (void *idle_started_ UNUSED)
       intr_disable ();
       thread_block ();
 
-      /* Re-enable interrupts and wait for the next one.
-
-         The `sti' instruction disables interrupts until the
-         completion of the next instruction, so these two
-         instructions are executed atomically.  This atomicity is
-         important; otherwise, an interrupt could be handled
-         between re-enabling interrupts and waiting for the next
-         one to occur, wasting as much as one clock tick worth of
-         time.
-
-         See [IA32-v2a] "HLT", [IA32-v2b] "STI", and [IA32-v3a]
-         7.11.1 "HLT Instruction". */
-      asm volatile ("sti; hlt" : : : "memory");
+      /* Zero free pages ahead of PAL_ZERO requests.  Any thread
+         that becomes ready meanwhile preempts us. */
+      intr_enable ();
+      while (palloc_zero_idle ())
+        continue;
+      intr_disable ();
+      if (cpu_current ()->rq.cnt > 0)
+        continue;
+
+      /* Nothing else can run until an interrupt arrives, so let
+         the timer skip ticks on which no thread wakes up.  EDF
+         periods start from the tick, so keep it running while any
+         EDF thread is waiting for one. */
+      if (list_empty (&cpu_current ()->edf_pending))
+        timer_enter_tickless ();
+
+      /* Re-enable interrupts and wait for the next one. */
+      intr_halt ();
     }
 }
 
+/* Reschedule IPI handler.  Another CPU readied a thread on this
+   CPU's run queue that outranked the thread running here when it
+   looked. */
+static void
+resched_ipi (struct intr_frame *f UNUSED) 
+{
+  if (queue_outranks (&cpu_current ()->rq, thread_current ()))
+    intr_yield_on_return ();
+}
+
 /* Function used as the basis for a kernel thread. */
 static void
 kernel_thread (thread_func *function, void *aux) 
@@ -456,7 +1407,9 @@ kernel_thread (thread_func *function, void *aux)
   thread_exit ();       /* If function() returns, kill the thread. */
 }
 
-/* Returns the running thread. */
+/* Returns the thread whose stack we are on.  Unlike
+   thread_current(), this works in the middle of a thread switch,
+   when that thread is no longer THREAD_RUNNING. */
 struct thread *
 running_thread (void) 
 {
@@ -477,11 +1430,75 @@ is_thread (struct thread *t)
   return t != NULL && t->magic == THREAD_MAGIC;
 }
 
+/* Returns true if T is the idle thread of some CPU. */
+static bool
+is_idle_thread (const struct thread *t)
+{
+  return t->cpu != NULL && t == t->cpu->idle_thread;
+}
+
+/* Returns true if the MLFQS leaves T's priority alone. */
+static bool
+mlfqs_exempt (const struct thread *t)
+{
+  return is_idle_thread (t) || t->worker;
+}
+
+/* Returns a zeroed page for a new thread, preferably from the
+   thread page cache, or a null pointer if no memory is
+   available. */
+static struct thread *
+alloc_thread_page (void) 
+{
+  enum intr_level old_level;
+  struct thread *t = NULL;
+  uint32_t *p, *end;
+
+  old_level = intr_disable ();
+  if (thread_cache_cnt > 0)
+    {
+      t = thread_cache[--thread_cache_cnt];
+      thread_cache_hits++;
+    }
+  else
+    thread_cache_misses++;
+  intr_set_level (old_level);
+
+  if (t == NULL)
+    return palloc_get_page (PAL_ZERO);
+
+  /* The previous owner's stack grew down from the top of the
+     page, and everything below its deepest point is still zero.
+     Skip that untouched part and clear only the used stack.
+     The `struct thread' itself is cleared by init_thread(). */
+  p = (uint32_t *) (t + 1);
+  end = (uint32_t *) ((uint8_t *) t + PGSIZE);
+  while (p < end && *p == 0)
+    p++;
+  memset (p, 0, (uint8_t *) end - (uint8_t *) p);
+  return t;
+}
+
+/* Releases the page of dying thread T, keeping it in the thread
+   page cache if there is room.  Interrupts must be off. */
+static void
+free_thread_page (struct thread *t) 
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  if (thread_cache_cnt < THREAD_CACHE_MAX)
+    thread_cache[thread_cache_cnt++] = t;
+  else
+    palloc_free_page (t);
+}
+
 /* Does basic initialization of T as a blocked thread named
    NAME. */
 static void
 init_thread (struct thread *t, const char *name, int priority)
 {
+  enum intr_level old_level;
+
   ASSERT (t != NULL);
   ASSERT (PRI_MIN <= priority && priority <= PRI_MAX);
   ASSERT (name != NULL);
@@ -490,9 +1507,16 @@ init_thread (struct thread *t, const char *name, int priority)
   t->status = THREAD_BLOCKED;
   strlcpy (t->name, name, sizeof t->name);
   t->stack = (uint8_t *) t + PGSIZE;
-  t->priority = priority;
+  t->priority = t->base_priority = priority;
+  t->read_donation = PRI_MIN;
+  list_init (&t->locks_held);
+  t->nice = NICE_DEFAULT;
+  t->recent_cpu = 0;
   t->magic = THREAD_MAGIC;
+
+  old_level = intr_disable ();
   list_push_back (&all_list, &t->allelem);
+  intr_set_level (old_level);
 }
 
 /* Allocates a SIZE-byte frame at the top of thread T's stack and
@@ -508,18 +1532,331 @@ alloc_frame (struct thread *t, size_t size)
   return t->stack;
 }
 
-/* Chooses and returns the next thread to be scheduled.  Should
-   return a thread from the run queue, unless the run queue is
-   empty.  (If the running thread can continue running, then it
-   will be in the run queue.)  If the run queue is empty, return
-   idle_thread. */
+/* Adds T to the tail of the run queue for its priority on T's
+   CPU, or under CFS, to its CPU's CFS tree.  T may be the running
+   thread, about to yield. */
+static void
+ready_queue_push (struct thread *t)
+{
+  struct run_queue *rq = &t->cpu->rq;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+  ASSERT (PRI_MIN <= t->priority && t->priority <= PRI_MAX);
+
+  if (t->edf_throttled)
+    {
+      /* Not runnable again until its next period. */
+      edf_pend (t);
+      return;
+    }
+
+  spinlock_acquire (&rq->lock);
+  if (uses_edf (t))
+    rb_insert (&rq->edf_tree, &t->edf_elem);
+  else if (uses_cfs (t))
+    {
+      if (t->status == THREAD_RUNNING)
+        cfs_charge (t);
+      rb_insert (&rq->cfs_tree, &t->cfs_elem);
+      rq->cfs_weight += cfs_weight (t);
+    }
+  else
+    {
+      list_push_back (&rq->queues[t->priority], &t->elem);
+      rq->mask |= (uint64_t) 1 << t->priority;
+    }
+  rq->cnt++;
+  rq->load_cnt += !mlfqs_exempt (t);
+  spinlock_release (&rq->lock);
+}
+
+/* Removes ready thread T from its run queue. */
+static void
+ready_queue_remove (struct thread *t)
+{
+  struct run_queue *rq = &t->cpu->rq;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+  ASSERT (t->status == THREAD_READY);
+
+  if (t->edf_throttled)
+    {
+      list_remove (&t->elem);
+      return;
+    }
+
+  spinlock_acquire (&rq->lock);
+  if (uses_edf (t))
+    rb_remove (&rq->edf_tree, &t->edf_elem);
+  else if (uses_cfs (t))
+    {
+      rb_remove (&rq->cfs_tree, &t->cfs_elem);
+      rq->cfs_weight -= cfs_weight (t);
+    }
+  else
+    {
+      list_remove (&t->elem);
+      if (list_empty (&rq->queues[t->priority]))
+        rq->mask &= ~((uint64_t) 1 << t->priority);
+    }
+  rq->cnt--;
+  rq->load_cnt -= !mlfqs_exempt (t);
+  spinlock_release (&rq->lock);
+}
+
+/* Sets T's priority to PRIORITY.  If T is ready, it moves to the
+   tail of the run queue for its new priority.  If T is blocked
+   on a semaphore, it moves to the matching place in that
+   semaphore's wait list. */
+static void
+change_priority (struct thread *t, int priority)
+{
+  enum intr_level old_level;
+
+  ASSERT (PRI_MIN <= priority && priority <= PRI_MAX);
+
+  old_level = intr_disable ();
+  if (t->priority != priority)
+    {
+      if (t->status == THREAD_READY)
+        {
+          ready_queue_remove (t);
+          t->priority = priority;
+          ready_queue_push (t);
+        }
+      else
+        {
+          t->priority = priority;
+          if (t->status == THREAD_BLOCKED && t->waiting_sema != NULL)
+            sema_reposition_waiter (t);
+        }
+    }
+  intr_set_level (old_level);
+}
+
+/* Returns the highest priority that has a nonempty queue in RQ.
+   At least one queue in RQ must be nonempty. */
+static int
+ready_queue_highest (struct run_queue *rq)
+{
+  uint64_t mask = rq->mask;
+  uint32_t hi = mask >> 32;
+  uint32_t lo = mask;
+
+  ASSERT (mask != 0);
+
+  /* Scan the upper and lower halves separately, so that the
+     compiler emits a plain 32-bit BSR for each. */
+  return hi != 0 ? 63 - __builtin_clz (hi) : 31 - __builtin_clz (lo);
+}
+
+/* Chooses and returns the next thread to be scheduled on this
+   CPU.  Should return the EDF thread with the earliest deadline,
+   or else the first thread from the highest-priority nonempty
+   queue in this CPU's run queue, or if every queue is empty, the
+   CFS thread with the least vruntime.  (If the running
+   thread can continue running, then it will be in a run queue.)
+   If there is no ready thread at all, return this CPU's idle
+   thread. */
 static struct thread *
 next_thread_to_run (void) 
 {
-  if (list_empty (&ready_list))
-    return idle_thread;
+  struct cpu *c = cpu_current ();
+  struct run_queue *rq = &c->rq;
+  struct thread *t;
+  struct list *queue;
+  int pri;
+
+  spinlock_acquire (&rq->lock);
+  if (!rb_empty (&rq->edf_tree))
+    {
+      t = rb_entry (rb_first (&rq->edf_tree), struct thread, edf_elem);
+      rb_remove (&rq->edf_tree, &t->edf_elem);
+      rq->cnt--;
+      rq->load_cnt -= !mlfqs_exempt (t);
+    }
+  else if (rq->mask != 0)
+    {
+      pri = ready_queue_highest (rq);
+      queue = &rq->queues[pri];
+      t = list_entry (list_pop_front (queue), struct thread, elem);
+      if (list_empty (queue))
+        rq->mask &= ~((uint64_t) 1 << pri);
+      rq->cnt--;
+      rq->load_cnt -= !mlfqs_exempt (t);
+    }
+  else if (!rb_empty (&rq->cfs_tree))
+    {
+      t = rb_entry (rb_first (&rq->cfs_tree), struct thread, cfs_elem);
+      rb_remove (&rq->cfs_tree, &t->cfs_elem);
+      rq->cfs_weight -= cfs_weight (t);
+      rq->cnt--;
+      rq->load_cnt -= !mlfqs_exempt (t);
+      cfs_update_min (rq, t);
+    }
   else
-    return list_entry (list_pop_front (&ready_list), struct thread, elem);
+    t = NULL;
+  spinlock_release (&rq->lock);
+
+  if (t == NULL && cpu_cnt > 1)
+    {
+      /* Nothing to do here.  Try to take work from a peer before
+         going idle. */
+      struct cpu *victim = busiest_cpu (c);
+      if (victim != NULL && (t = steal_thread (c, victim)) != NULL)
+        {
+          c->steals++;
+          spinlock_acquire (&rq->lock);
+          cfs_update_min (rq, t);
+          spinlock_release (&rq->lock);
+        }
+    }
+  return t != NULL ? t : c->idle_thread;
+}
+
+/* Returns the number of threads that are ready or running on C,
+   not counting its idle thread.  The answer may be stale by the
+   time it is used, which is fine for balancing decisions.
+   Interrupts must be off, so that C is not switching threads. */
+static int
+cpu_load (const struct cpu *c)
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  return c->rq.cnt + !is_idle_thread (c->running);
+}
+
+/* Returns the CPU other than SELF with the most ready threads, or
+   a null pointer if no other CPU has any. */
+static struct cpu *
+busiest_cpu (const struct cpu *self)
+{
+  struct cpu *busiest = NULL;
+  unsigned i;
+
+  for (i = 0; i < cpu_cnt; i++)
+    {
+      struct cpu *c = &cpus[i];
+      if (c != self && c->rq.cnt > 0
+          && (busiest == NULL || c->rq.cnt > busiest->rq.cnt))
+        busiest = c;
+    }
+  return busiest;
+}
+
+/* Removes a cache-cold thread from VICTIM's run queue, moves it
+   to THIEF, and returns it, or returns a null pointer if VICTIM
+   has no thread that may migrate.  Threads are taken from the
+   tail of the highest-priority nonempty queue, or else from the
+   high-vruntime end of the CFS tree, since those have waited the
+   least and are the least likely to run soon on VICTIM.  EDF
+   threads never migrate, because admission control is per CPU.
+   The caller decides whether to run the thread or queue it. */
+static struct thread *
+steal_thread (struct cpu *thief, struct cpu *victim)
+{
+  struct run_queue *rq = &victim->rq;
+  struct thread *t = NULL;
+  int64_t now = timer_ticks ();
+  int pri;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+  ASSERT (thief != victim);
+
+  spinlock_acquire (&rq->lock);
+  for (pri = PRI_MAX; pri >= PRI_MIN && t == NULL; pri--)
+    {
+      struct list_elem *e;
+
+      if ((rq->mask & ((uint64_t) 1 << pri)) == 0)
+        continue;
+      for (e = list_rbegin (&rq->queues[pri]);
+           e != list_rend (&rq->queues[pri]); e = list_prev (e))
+        {
+          struct thread *candidate = list_entry (e, struct thread, elem);
+          if (!candidate->worker && !cache_hot (candidate, now))
+            {
+              t = candidate;
+              break;
+            }
+        }
+    }
+  if (t == NULL)
+    {
+      struct rb_elem *e;
+
+      for (e = rb_last (&rq->cfs_tree); e != NULL; e = rb_prev (e))
+        {
+          struct thread *candidate = rb_entry (e, struct thread, cfs_elem);
+          if (!cache_hot (candidate, now))
+            {
+              t = candidate;
+              break;
+            }
+        }
+    }
+  if (t != NULL)
+    {
+      if (uses_cfs (t))
+        {
+          /* Keep T's lead or lag relative to its peers. */
+          rb_remove (&rq->cfs_tree, &t->cfs_elem);
+          rq->cfs_weight -= cfs_weight (t);
+          t->vruntime += thief->rq.min_vruntime - rq->min_vruntime;
+        }
+      else
+        {
+          list_remove (&t->elem);
+          if (list_empty (&rq->queues[t->priority]))
+            rq->mask &= ~((uint64_t) 1 << t->priority);
+        }
+      rq->cnt--;
+      rq->load_cnt -= !mlfqs_exempt (t);
+      t->cpu = thief;
+      t->last_migrated = now;
+      thief->migrations++;
+    }
+  spinlock_release (&rq->lock);
+  return t;
+}
+
+/* Returns true if T ran, or moved to its CPU, within the last
+   CACHE_HOT_TICKS ticks before NOW. */
+static bool
+cache_hot (const struct thread *t, int64_t now)
+{
+  return (now - t->last_ran < CACHE_HOT_TICKS
+          || now - t->last_migrated < CACHE_HOT_TICKS);
+}
+
+/* Moves a thread that may migrate from VICTIM's run queue to
+   THIEF's, as the periodic balancing pass does, and returns it,
+   or returns a null pointer if VICTIM has no such thread.
+   Interrupts must be off. */
+struct thread *
+thread_pull (struct cpu *thief, struct cpu *victim)
+{
+  struct thread *t = steal_thread (thief, victim);
+
+  if (t != NULL)
+    ready_queue_push (t);
+  return t;
+}
+
+/* Periodic balancing pass for C, run from the timer interrupt.
+   Pulls one thread from the busiest other CPU onto C's run queue
+   if the two are sufficiently out of balance. */
+static void
+balance_load (struct cpu *c)
+{
+  struct cpu *victim = busiest_cpu (c);
+  struct thread *t;
+
+  if (victim != NULL
+      && cpu_load (victim) - cpu_load (c) >= BALANCE_IMBALANCE
+      && (t = thread_pull (c, victim)) != NULL
+      && outranks (t, thread_current ()))
+    intr_yield_on_return ();
 }
 
 /* Completes a thread switch by activating the new thread's page
@@ -547,9 +1884,16 @@ thread_schedule_tail (struct thread *prev)
 
   /* Mark us as running. */
   cur->status = THREAD_RUNNING;
+  cur->cpu->running = cur;
 
   /* Start new time slice. */
-  thread_ticks = 0;
+  cur->cpu->thread_ticks = 0;
+  if (thread_cfs)
+    cur->exec_start = timer_now_ns ();
+
+  /* Note when PREV stopped running, for cache affinity. */
+  if (prev != NULL)
+    prev->last_ran = timer_ticks ();
 
 #ifdef USERPROG
   /* Activate the new address space. */
@@ -564,7 +1908,7 @@ thread_schedule_tail (struct thread *prev)
   if (prev != NULL && prev->status == THREAD_DYING && prev != initial_thread) 
     {
       ASSERT (prev != cur);
-      palloc_free_page (prev);
+      free_thread_page (prev);
     }
 }
 
@@ -586,8 +1930,15 @@ schedule (void)
   ASSERT (cur->status != THREAD_RUNNING);
   ASSERT (is_thread (next));
 
+  cur->cpu->yield_pending = false;
+  if (thread_cfs && cur->status != THREAD_READY)
+    cfs_charge (cur);
   if (cur != next)
-prev = switch_threads (cur, next);
+    {
+      trace_event (TRACE_SWITCH, cur, next->tid);
+      cpu_account (CPU_MODE_KERNEL);
+      prev = switch_threads (cur, next);
+    }
 
   thread_schedule_tail (prev);
 }
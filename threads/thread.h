@@ -3,7 +3,13 @@
 
 #include <debug.h>
 #include <list.h>
+#include <rbtree.h>
 #include <stdint.h>
+#include "threads/fixed-point.h"
+
+struct cpu;
+struct lock;
+struct semaphore;
 
 /* States in a thread's life cycle. */
 enum thread_status
@@ -14,6 +20,15 @@ enum thread_status
     THREAD_DYING        /* About to be destroyed. */
   };
 
+/* Kinds of work that a thread's CPU time is charged to. */
+enum cpu_mode
+  {
+    CPU_MODE_KERNEL,    /* Kernel code run on the thread's behalf. */
+    CPU_MODE_USER,      /* User code. */
+    CPU_MODE_INTR,      /* External interrupt handlers. */
+    CPU_MODE_CNT        /* Number of modes. */
+  };
+
 /* Thread identifier type.
    You can redefine this to whatever type you like. */
 typedef int tid_t;
@@ -23,6 +38,12 @@ typedef int tid_t;
 #define PRI_MIN 0                       /* Lowest priority. */
 #define PRI_DEFAULT 31                  /* Default priority. */
 #define PRI_MAX 63                      /* Highest priority. */
+#define PRI_CNT (PRI_MAX - PRI_MIN + 1) /* Number of priorities. */
+
+/* Thread nice values, used by the MLFQS. */
+#define NICE_MIN -20                    /* Nicest to other threads. */
+#define NICE_DEFAULT 0                  /* Default nice value. */
+#define NICE_MAX 20                     /* Least nice to other threads. */
 
 /* A kernel thread or user process.
 
@@ -76,10 +97,11 @@ typedef int tid_t;
    value, triggering the assertion. */
 /* The `elem' member has a dual purpose.  It can be an element in
    the run queue (thread.c), or it can be an element in a
-   semaphore wait list (synch.c).  It can be used these two ways
-   only because they are mutually exclusive: only a thread in the
-   ready state is on the run queue, whereas only a thread in the
-   blocked state is on a semaphore wait list. */
+   semaphore wait list (synch.c) or the sleep queue (timer.c).
+   It can be used these ways only because they are mutually
+   exclusive: only a thread in the ready state is on the run
+   queue, whereas only a thread in the blocked state is on a
+   semaphore wait list or the sleep queue. */
 struct thread
   {
     /* Owned by thread.c. */
@@ -87,12 +109,54 @@ struct thread
     enum thread_status status;          /* Thread state. */
     char name[16];                      /* Name (for debugging purposes). */
     uint8_t *stack;                     /* Saved stack pointer. */
-    int priority;                       /* Priority. */
+    int priority;                       /* Effective priority. */
     struct list_elem allelem;           /* List element for all threads list. */
-
-    /* Shared between thread.c and synch.c. */
+    struct cpu *cpu;                    /* CPU running or queuing this thread. */
+    int64_t last_ran;                   /* Tick at which it last ran. */
+    int64_t last_migrated;              /* Tick at which it changed CPU. */
+    bool worker;                        /* Per-CPU kernel worker thread? */
+    uint64_t cycles[CPU_MODE_CNT];      /* CPU cycles used, by mode. */
+
+    /* Priority donation, shared between thread.c and synch.c. */
+    int base_priority;                  /* Priority before donations. */
+    struct list locks_held;             /* Locks held, for donations. */
+    struct lock *waiting_lock;          /* Lock being waited for, if any. */
+    struct semaphore *waiting_sema;     /* Semaphore blocked on, if any. */
+    int read_cnt;                       /* Read holds on rwlocks. */
+    int read_donation;                  /* Priority donated via rwlocks. */
+
+    /* Owned by thread.c, used only by the MLFQS and CFS. */
+    int nice;                           /* Nice value. */
+
+    /* Owned by thread.c, used only by the MLFQS. */
+    fixed_point recent_cpu;             /* Recent CPU usage. */
+    bool mlfqs_decaying;                /* In mlfqs_decay_list? */
+    struct list_elem decay_elem;        /* List element for mlfqs_decay_list. */
+    unsigned decay_gen;                 /* Last decay pass applied. */
+    bool mlfqs_charged;                 /* In mlfqs_charged_list? */
+    struct list_elem charged_elem;      /* List element for
+                                           mlfqs_charged_list. */
+
+    /* Owned by thread.c, used only by the CFS scheduler. */
+    struct rb_elem cfs_elem;            /* Element in run queue's cfs_tree. */
+    int64_t vruntime;                   /* Weighted run time, in ns. */
+    int64_t exec_start;                 /* When vruntime was last updated. */
+
+    /* Owned by thread.c, used only by EDF real-time threads. */
+    int64_t edf_period;                 /* Period in ticks, 0 if not EDF. */
+    int64_t edf_budget;                 /* Run time allowed per period. */
+    int64_t edf_deadline;               /* End of the current period. */
+    int64_t edf_left;                   /* Budget left in this period. */
+    bool edf_throttled;                 /* Out of budget until deadline? */
+    unsigned edf_misses;                /* Number of missed deadlines. */
+    struct rb_elem edf_elem;            /* Element in run queue's edf_tree. */
+
+    /* Shared between thread.c, synch.c, and timer.c. */
     struct list_elem elem;              /* List element. */
 
+    /* Owned by devices/timer.c. */
+    int64_t wakeup_tick;                /* Tick to wake up at, if asleep. */
+
 #ifdef USERPROG
     /* Owned by userprog/process.c. */
     uint32_t *pagedir;                  /* Page directory. */
@@ -109,24 +173,39 @@ struct thread
    Controlled by kernel command-line option "-o mlfqs". */
 extern bool thread_mlfqs;
 
+/* If true, use the completely fair scheduler instead.
+   Controlled by kernel command-line option "-o cfs". */
+extern bool thread_cfs;
+
 void thread_init (void);
+void *thread_init_ap (struct cpu *);
 void thread_start (void);
+void thread_start_ap (void) NO_RETURN;
 
 void thread_tick (void);
 void thread_print_stats (void);
+void thread_print_cpu_stats (void);
+void thread_get_cycles (uint64_t cycles[CPU_MODE_CNT]);
 
 typedef void thread_func (void *aux);
 tid_t thread_create (const char *name, int priority, thread_func *, void *);
+tid_t thread_create_on (struct cpu *, const char *name, int priority,
+                       thread_func *, void *);
 
 void thread_block (void);
 void thread_unblock (struct thread *);
 
 struct thread *thread_current (void);
+struct thread *running_thread (void);
 tid_t thread_tid (void);
 const char *thread_name (void);
 
 void thread_exit (void) NO_RETURN;
 void thread_yield (void);
+void thread_yield_to_higher (void);
+void thread_yield_pending (void);
+void thread_make_worker (void);
+struct thread *thread_pull (struct cpu *thief, struct cpu *victim);
 
 /* Performs some operation on thread t, given auxiliary data AUX. */
 typedef void thread_action_func (struct thread *t, void *aux);
@@ -135,6 +214,12 @@ void thread_ready_foreach (thread_action_func *, void *);
 
 int thread_get_priority (void);
 void thread_set_priority (int);
+void thread_donate_priority (struct thread *, int priority);
+void thread_recompute_priority (struct thread *);
+
+bool thread_set_deadline (int64_t period, int64_t budget);
+void thread_wait_period (void);
+unsigned thread_deadline_misses (void);
 
 int thread_get_nice (void);
 void thread_set_nice (int);
@@ -0,0 +1,99 @@
+#include "threads/trace.h"
+#include <debug.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "threads/cpu.h"
+#include "threads/interrupt.h"
+
+/* Scheduler event tracing.
+
+   Each CPU records events into its own ring buffer, so recording
+   takes no lock: only the owning CPU writes to a buffer, with
+   interrupts off.  When a buffer fills up, the oldest events are
+   overwritten.  Each event is stamped with the time-stamp
+   counter, so that the delay between, say, a thread being
+   unblocked and being switched to can be measured in cycles.
+
+   trace_dump() prints the buffers to the console, which is
+   normally the serial port, for offline analysis. */
+
+/* Number of events kept per CPU.  Must be a power of 2. */
+#define TRACE_EVENT_CNT 1024
+
+/* A traced event. */
+struct trace_entry
+  {
+    uint64_t tsc;               /* Time-stamp counter. */
+    tid_t tid;                  /* Thread the event is about. */
+    int arg;                    /* Event-specific argument. */
+    enum trace_type type;       /* Type of event. */
+  };
+
+/* A per-CPU ring buffer of events. */
+struct trace_ring
+  {
+    struct trace_entry entries[TRACE_EVENT_CNT];
+    uint32_t head;              /* Total # of events recorded. */
+  };
+
+bool trace_enabled;
+
+static struct trace_ring rings[CPU_MAX];
+
+/* Event names, for trace_dump(). */
+static const char *type_names[TRACE_TYPE_CNT] =
+  {
+    [TRACE_SWITCH] = "switch",
+    [TRACE_BLOCK] = "block",
+    [TRACE_UNBLOCK] = "unblock",
+    [TRACE_YIELD] = "yield",
+    [TRACE_SLEEP] = "sleep",
+    [TRACE_WAKE] = "wake",
+  };
+
+/* Records an event of the given TYPE for thread T, with
+   event-specific argument ARG, in the current CPU's buffer.
+   Called through trace_event(). */
+void
+trace_record (enum trace_type type, const struct thread *t, int arg) 
+{
+  enum intr_level old_level = intr_disable ();
+  struct trace_ring *ring = &rings[cpu_current ()->id];
+  struct trace_entry *e = &ring->entries[ring->head % TRACE_EVENT_CNT];
+
+  e->tsc = rdtsc ();
+  e->tid = t->tid;
+  e->arg = arg;
+  e->type = type;
+  ring->head++;
+  intr_set_level (old_level);
+}
+
+/* Prints the contents of every CPU's trace buffer to the
+   console, oldest event first.  Tracing is suspended while the
+   buffers are printed, so that the dump does not trace
+   itself. */
+void
+trace_dump (void) 
+{
+  bool was_enabled = trace_enabled;
+  unsigned i;
+
+  trace_enabled = false;
+  printf ("Dumping scheduler trace...\n");
+  for (i = 0; i < cpu_cnt; i++)
+    {
+      struct trace_ring *ring = &rings[i];
+      uint32_t head = ring->head;
+      uint32_t n = head < TRACE_EVENT_CNT ? 0 : head - TRACE_EVENT_CNT;
+
+      for (; n != head; n++)
+        {
+          struct trace_entry *e = &ring->entries[n % TRACE_EVENT_CNT];
+          printf ("trace: cpu %u tsc %llu %s tid %d arg %d\n",
+                  i, e->tsc, type_names[e->type], e->tid, e->arg);
+        }
+    }
+  printf ("End of scheduler trace.\n");
+  trace_enabled = was_enabled;
+}
@@ -0,0 +1,36 @@
+#ifndef THREADS_TRACE_H
+#define THREADS_TRACE_H
+
+#include <stdbool.h>
+#include "threads/thread.h"
+
+/* Scheduler events that can be traced. */
+enum trace_type
+  {
+    TRACE_SWITCH,               /* Context switch; ARG is the next tid. */
+    TRACE_BLOCK,                /* Thread blocked. */
+    TRACE_UNBLOCK,              /* Thread made ready; ARG is its priority. */
+    TRACE_YIELD,                /* Thread yielded the CPU. */
+    TRACE_SLEEP,                /* Thread went to sleep; ARG is ticks. */
+    TRACE_WAKE,                 /* Sleeping thread woken. */
+    TRACE_TYPE_CNT
+  };
+
+/* Whether tracing is on.  Controlled by kernel command-line
+   option "-trace". */
+extern bool trace_enabled;
+
+void trace_record (enum trace_type, const struct thread *, int arg);
+void trace_dump (void);
+
+/* Records an event of the given TYPE for thread T, if tracing is
+   enabled.  When it is not, this costs one well-predicted
+   branch. */
+static inline void
+trace_event (enum trace_type type, const struct thread *t, int arg)
+{
+  if (__builtin_expect (trace_enabled, 0))
+    trace_record (type, t, arg);
+}
+
+#endif /* threads/trace.h */
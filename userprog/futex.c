@@ -0,0 +1,206 @@
+#include "userprog/futex.h"
+#include <debug.h>
+#include <hash.h>
+#include <list.h>
+#include <stdint.h>
+#include "threads/malloc.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#include "userprog/pagedir.h"
+
+/* Fast user-space mutexes.
+
+   A futex is just an aligned int in user memory.  User code
+   manipulates it with atomic instructions and enters the kernel
+   only when it has to wait, with futex_wait(), or when it may
+   have to wake a waiter, with futex_wake().  An uncontended
+   mutex built on a futex never enters the kernel at all.
+
+   Waiters are kept in a hash table keyed by the kernel virtual
+   address of the futex word.  The kernel maps all of physical
+   memory, so that address names the physical frame and offset,
+   and processes that share a frame also share its futexes.  Each
+   table entry holds the list of threads waiting on one address,
+   and is freed when its last waiter is woken. */
+
+/* Threads waiting on one futex address. */
+struct futex_queue
+  {
+    struct hash_elem elem;      /* Element in futexes. */
+    const int *kaddr;           /* Kernel address of futex word. */
+    struct list waiters;        /* Waiting futex_waiters. */
+  };
+
+/* A thread waiting on a futex. */
+struct futex_waiter
+  {
+    struct list_elem elem;      /* Element in futex_queue's waiters. */
+    struct thread *thread;      /* The waiting thread. */
+    struct semaphore sema;      /* Upped to wake the thread. */
+  };
+
+/* Futex queues, keyed by kernel address. */
+static struct hash futexes;
+
+/* Protects futexes and the queues in it. */
+static struct lock futex_lock;
+
+static hash_hash_func futex_hash;
+static hash_less_func futex_less;
+static const int *translate (const int *uaddr);
+static struct futex_queue *find_queue (const int *kaddr);
+static bool waiter_less (const struct list_elem *, const struct list_elem *,
+                         void *aux);
+
+/* Initializes the futex table. */
+void
+futex_init (void) 
+{
+  if (!hash_init (&futexes, futex_hash, futex_less, NULL))
+    PANIC ("could not allocate futex table");
+  lock_init (&futex_lock);
+}
+
+/* If the int at user address UADDR still equals EXPECTED, blocks
+   until another thread calls futex_wake() on the same futex.
+   The comparison and the decision to block are atomic with
+   respect to futex_wake(), so a wakeup cannot be lost.  Returns
+   0 after being woken, or -1 if the value differed or UADDR is
+   not a valid, aligned, mapped user address. */
+int
+futex_wait (const int *uaddr, int expected) 
+{
+  const int *kaddr = translate (uaddr);
+  struct futex_queue *q;
+  struct futex_waiter w;
+
+  if (kaddr == NULL)
+    return -1;
+
+  lock_acquire (&futex_lock);
+  if (*kaddr != expected)
+    {
+      lock_release (&futex_lock);
+      return -1;
+    }
+
+  q = find_queue (kaddr);
+  if (q == NULL)
+    {
+      q = malloc (sizeof *q);
+      if (q == NULL)
+        {
+          lock_release (&futex_lock);
+          return -1;
+        }
+      q->kaddr = kaddr;
+      list_init (&q->waiters);
+      hash_insert (&futexes, &q->elem);
+    }
+
+  w.thread = thread_current ();
+  sema_init (&w.sema, 0);
+  list_insert_ordered (&q->waiters, &w.elem, waiter_less, NULL);
+  lock_release (&futex_lock);
+
+  sema_down (&w.sema);
+  return 0;
+}
+
+/* Wakes up to CNT threads waiting on the futex at user address
+   UADDR, highest priority first.  Returns the number of threads
+   woken, or -1 if UADDR is not a valid, aligned, mapped user
+   address. */
+int
+futex_wake (const int *uaddr, int cnt) 
+{
+  const int *kaddr = translate (uaddr);
+  struct futex_queue *q;
+  int woken = 0;
+
+  if (kaddr == NULL)
+    return -1;
+
+  lock_acquire (&futex_lock);
+  q = find_queue (kaddr);
+  if (q != NULL)
+    {
+      while (woken < cnt && !list_empty (&q->waiters))
+        {
+          struct futex_waiter *w = list_entry (list_pop_front (&q->waiters),
+                                               struct futex_waiter, elem);
+          sema_up (&w->sema);
+          woken++;
+        }
+      if (list_empty (&q->waiters))
+        {
+          hash_delete (&futexes, &q->elem);
+          free (q);
+        }
+    }
+  lock_release (&futex_lock);
+  return woken;
+}
+
+/* Returns the kernel address of the int at user address UADDR in
+   the current process, or a null pointer if UADDR is misaligned
+   or not mapped. */
+static const int *
+translate (const int *uaddr) 
+{
+  uint32_t *pd = thread_current ()->pagedir;
+  uint8_t *kpage;
+
+  if (pd == NULL || !is_user_vaddr (uaddr)
+      || (uintptr_t) uaddr % sizeof *uaddr != 0)
+    return NULL;
+  kpage = pagedir_get_page (pd, pg_round_down (uaddr));
+  if (kpage == NULL)
+    return NULL;
+  return (const int *) (kpage + pg_ofs (uaddr));
+}
+
+/* Returns the queue for kernel address KADDR, or a null pointer
+   if no thread is waiting there.  futex_lock must be held. */
+static struct futex_queue *
+find_queue (const int *kaddr) 
+{
+  struct futex_queue key;
+  struct hash_elem *e;
+
+  ASSERT (lock_held_by_current_thread (&futex_lock));
+
+  key.kaddr = kaddr;
+  e = hash_find (&futexes, &key.elem);
+  return e != NULL ? hash_entry (e, struct futex_queue, elem) : NULL;
+}
+
+/* Returns a hash value for futex queue E. */
+static unsigned
+futex_hash (const struct hash_elem *e, void *aux UNUSED) 
+{
+  const struct futex_queue *q = hash_entry (e, struct futex_queue, elem);
+  return hash_bytes (&q->kaddr, sizeof q->kaddr);
+}
+
+/* Returns true if futex queue A precedes futex queue B. */
+static bool
+futex_less (const struct hash_elem *a_, const struct hash_elem *b_,
+            void *aux UNUSED) 
+{
+  const struct futex_queue *a = hash_entry (a_, struct futex_queue, elem);
+  const struct futex_queue *b = hash_entry (b_, struct futex_queue, elem);
+  return a->kaddr < b->kaddr;
+}
+
+/* Returns true if waiter A should be woken before waiter B, that
+   is, if it has higher priority. */
+static bool
+waiter_less (const struct list_elem *a_, const struct list_elem *b_,
+             void *aux UNUSED) 
+{
+  const struct futex_waiter *a = list_entry (a_, struct futex_waiter, elem);
+  const struct futex_waiter *b = list_entry (b_, struct futex_waiter, elem);
+  return a->thread->priority > b->thread->priority;
+}
@@ -1,6 +1,7 @@
 #include "userprog/gdt.h"
 #include <debug.h>
 #include "userprog/tss.h"
+#include "threads/cpu.h"
 #include "threads/palloc.h"
 #include "threads/vaddr.h"
 
@@ -31,26 +32,33 @@ static uint64_t make_tss_desc (void *laddr);
 static uint64_t make_gdtr_operand (uint16_t limit, void *base);
 
 /* Sets up a proper GDT.  The bootstrap loader's GDT didn't
-   include user-mode selectors or a TSS, but we need both now. */
+   include user-mode selectors or a TSS, but we need both now.
+   Each CPU calls this after tss_init(), to add its own TSS to the
+   shared GDT and load it. */
 void
 gdt_init (void)
 {
+  unsigned id = cpu_current ()->id;
+  int sel_tss = SEL_TSS + id * sizeof *gdt;
   uint64_t gdtr_operand;
 
   /* Initialize GDT. */
-  gdt[SEL_NULL / sizeof *gdt] = 0;
-  gdt[SEL_KCSEG / sizeof *gdt] = make_code_desc (0);
-  gdt[SEL_KDSEG / sizeof *gdt] = make_data_desc (0);
-  gdt[SEL_UCSEG / sizeof *gdt] = make_code_desc (3);
-  gdt[SEL_UDSEG / sizeof *gdt] = make_data_desc (3);
-  gdt[SEL_TSS / sizeof *gdt] = make_tss_desc (tss_get ());
+  if (id == 0)
+    {
+      gdt[SEL_NULL / sizeof *gdt] = 0;
+      gdt[SEL_KCSEG / sizeof *gdt] = make_code_desc (0);
+      gdt[SEL_KDSEG / sizeof *gdt] = make_data_desc (0);
+      gdt[SEL_UCSEG / sizeof *gdt] = make_code_desc (3);
+      gdt[SEL_UDSEG / sizeof *gdt] = make_data_desc (3);
+    }
+  gdt[sel_tss / sizeof *gdt] = make_tss_desc (tss_get ());
 
   /* Load GDTR, TR.  See [IA32-v3a] 2.4.1 "Global Descriptor
      Table Register (GDTR)", 2.4.4 "Task Register (TR)", and
      6.2.4 "Task Register".  */
   gdtr_operand = make_gdtr_operand (sizeof gdt - 1, gdt);
   asm volatile ("lgdt %0" : : "m" (gdtr_operand));
-  asm volatile ("ltr %w0" : : "q" (SEL_TSS));
+  asm volatile ("ltr %w0" : : "q" (sel_tss));
 }
 
 /* System segment or code/data segment? */
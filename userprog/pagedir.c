@@ -6,6 +6,9 @@
 #include "threads/pte.h"
 #include "threads/palloc.h"
 
+/* Number of times a page directory has been loaded into CR3. */
+static long long load_cnt;
+
 static uint32_t *active_pd (void);
 static void invalidate_pagedir (uint32_t *);
 
@@ -156,6 +159,16 @@ pagedir_clear_page (uint32_t *pd, void *upage)
     }
 }
 
+/* Returns true if the PTE for virtual page VPAGE in PD is
+   present and writable.
+   Returns false if PD contains no PTE for VPAGE. */
+bool
+pagedir_is_writable (uint32_t *pd, const void *vpage) 
+{
+  uint32_t *pte = lookup_page (pd, vpage, false);
+  return pte != NULL && (*pte & (PTE_P | PTE_W)) == (PTE_P | PTE_W);
+}
+
 /* Returns true if the PTE for virtual page VPAGE in PD is dirty,
    that is, if the page has been modified since the PTE was
    installed.
@@ -228,6 +241,25 @@ pagedir_activate (uint32_t *pd)
      to/from Control Registers" and [IA32-v3a] 3.7.5 "Base
      Address of the Page Directory". */
   asm volatile ("movl %0, %%cr3" : : "r" (vtop (pd)) : "memory");
+  load_cnt++;
+}
+
+/* Returns the number of times pagedir_activate() has loaded a
+   page directory, each of which flushed the TLB. */
+long long
+pagedir_load_cnt (void) 
+{
+  return load_cnt;
+}
+
+/* Returns true if PD, or the kernel-only page directory if PD
+   is null, is the CPU's active page directory. */
+bool
+pagedir_is_active (uint32_t *pd) 
+{
+  if (pd == NULL)
+    pd = init_page_dir;
+  return active_pd () == pd;
 }
 
 /* Returns the currently active page directory. */
@@ -124,12 +124,18 @@ process_activate (void)
 {
   struct thread *t = thread_current ();
 
-  /* Activate thread's page tables. */
-  pagedir_activate (t->pagedir);
+  /* Activate thread's page tables.  Loading CR3 flushes the
+     TLB, so skip it if they are already active, as they are
+     when switching between kernel threads or between threads
+     that share an address space. */
+  if (!pagedir_is_active (t->pagedir))
+    pagedir_activate (t->pagedir);
 
   /* Set thread's kernel stack for use in processing
-     interrupts. */
-  tss_update ();
+     interrupts from user mode.  Kernel threads never run in
+     user mode, so they can leave it alone. */
+  if (t->pagedir != NULL)
+    tss_update ();
 }
 
 /* We load ELF binaries.  The following definitions are taken
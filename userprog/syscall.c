@@ -3,18 +3,119 @@
 #include <syscall-nr.h>
 #include "threads/interrupt.h"
 #include "threads/thread.h"
+#include "threads/vaddr.h"
+#include "userprog/futex.h"
+#include "userprog/pagedir.h"
 
 static void syscall_handler (struct intr_frame *);
+static bool get_user_word (const uint32_t *uaddr, uint32_t *value);
+static bool put_user_bytes (void *udst, const void *src, size_t size);
+static uint32_t get_arg (struct intr_frame *, int idx);
+static bool sys_cpu_usage (void *usage);
 
 void
 syscall_init (void) 
 {
   intr_register_int (0x30, 3, INTR_ON, syscall_handler, "syscall");
+  futex_init ();
 }
 
 static void
-syscall_handler (struct intr_frame *f UNUSED) 
+syscall_handler (struct intr_frame *f) 
 {
-  printf ("system call!\n");
-  thread_exit ();
+  switch (get_arg (f, 0))
+    {
+    case SYS_FUTEX_WAIT:
+      f->eax = futex_wait ((const int *) get_arg (f, 1), get_arg (f, 2));
+      break;
+
+    case SYS_FUTEX_WAKE:
+      f->eax = futex_wake ((const int *) get_arg (f, 1), get_arg (f, 2));
+      break;
+
+    case SYS_CPU_USAGE:
+      f->eax = sys_cpu_usage ((void *) get_arg (f, 1));
+      break;
+
+    default:
+      printf ("system call!\n");
+      thread_exit ();
+    }
+}
+
+/* Copies the CPU cycles used by the running thread into the
+   user `struct cpu_usage' at USAGE, which holds one 64-bit
+   count per enum cpu_mode, in that order.  Returns true if
+   successful, false if USAGE is not writable. */
+static bool
+sys_cpu_usage (void *usage) 
+{
+  uint64_t cycles[CPU_MODE_CNT];
+
+  thread_get_cycles (cycles);
+  return put_user_bytes (usage, cycles, sizeof cycles);
+}
+
+/* Returns word IDX on the user stack of the system call in F:
+   word 0 is the system call number, followed by its arguments.
+   Terminates the process if the word cannot be read. */
+static uint32_t
+get_arg (struct intr_frame *f, int idx) 
+{
+  uint32_t value;
+
+  if (!get_user_word ((const uint32_t *) f->esp + idx, &value))
+    thread_exit ();
+  return value;
+}
+
+/* Reads the word at user address UADDR into *VALUE.  Returns true
+   if successful, false if UADDR is not a mapped user address. */
+static bool
+get_user_word (const uint32_t *uaddr, uint32_t *value) 
+{
+  uint32_t *pd = thread_current ()->pagedir;
+  const uint8_t *p = (const uint8_t *) uaddr;
+  uint8_t *bytes = (uint8_t *) value;
+  size_t i;
+
+  /* Read byte by byte, since the word may straddle a page
+     boundary. */
+  for (i = 0; i < sizeof *value; i++)
+    {
+      const uint8_t *kaddr;
+
+      if (!is_user_vaddr (p + i))
+        return false;
+      kaddr = pagedir_get_page (pd, p + i);
+      if (kaddr == NULL)
+        return false;
+      bytes[i] = *kaddr;
+    }
+  return true;
+}
+
+/* Copies SIZE bytes from SRC to user address UDST.  Returns true
+   if successful, false if some byte of UDST is not a mapped,
+   writable user address. */
+static bool
+put_user_bytes (void *udst, const void *src, size_t size) 
+{
+  uint32_t *pd = thread_current ()->pagedir;
+  uint8_t *p = udst;
+  const uint8_t *bytes = src;
+  size_t i;
+
+  for (i = 0; i < size; i++)
+    {
+      uint8_t *kaddr;
+
+      if (!is_user_vaddr (p + i) || !pagedir_is_writable (pd, p + i))
+        return false;
+      kaddr = pagedir_get_page (pd, p + i);
+      if (kaddr == NULL)
+        return false;
+      *kaddr = bytes[i];
+    }
+  return true;
 }
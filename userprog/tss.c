@@ -2,6 +2,7 @@
 #include <debug.h>
 #include <stddef.h>
 #include "userprog/gdt.h"
+#include "threads/cpu.h"
 #include "threads/thread.h"
 #include "threads/palloc.h"
 #include "threads/vaddr.h"
@@ -72,28 +73,35 @@ struct tss
     uint16_t trace, bitmap;
   };
 
-/* Kernel TSS. */
+/* Kernel TSS of each CPU, indexed by CPU number.  They share a
+   page, which the boot processor allocates, so that application
+   processors need not allocate memory while starting up. */
 static struct tss *tss;
 
-/* Initializes the kernel TSS. */
+/* Initializes the kernel TSS of the CPU we are running on. */
 void
 tss_init (void) 
 {
+  struct tss *t;
+
+  if (tss == NULL)
+    tss = palloc_get_page (PAL_ASSERT | PAL_ZERO);
+
   /* Our TSS is never used in a call gate or task gate, so only a
      few fields of it are ever referenced, and those are the only
      ones we initialize. */
-  tss = palloc_get_page (PAL_ASSERT | PAL_ZERO);
-  tss->ss0 = SEL_KDSEG;
-  tss->bitmap = 0xdfff;
+  t = &tss[cpu_current ()->id];
+  t->ss0 = SEL_KDSEG;
+  t->bitmap = 0xdfff;
   tss_update ();
 }
 
-/* Returns the kernel TSS. */
+/* Returns the kernel TSS of the CPU we are running on. */
 struct tss *
 tss_get (void) 
 {
   ASSERT (tss != NULL);
-  return tss;
+  return &tss[cpu_current ()->id];
 }
 
 /* Sets the ring 0 stack pointer in the TSS to point to the end
@@ -101,6 +109,5 @@ tss_get (void)
 void
 tss_update (void) 
 {
-  ASSERT (tss != NULL);
-  tss->esp0 = (uint8_t *) thread_current () + PGSIZE;
+  tss_get ()->esp0 = (uint8_t *) thread_current () + PGSIZE;
 }